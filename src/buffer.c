@@ -2,8 +2,9 @@
  * buffer.c - 追加バッファ機能
  * 
  * 効率的な文字列構築のための追加バッファ機能を提供：
- * - 動的メモリ管理
+ * - 動的メモリ管理（容量を倍々に拡張）
  * - 文字列の追加
+ * - 容量を保ったままの再利用
  * - メモリの解放
  * 
  * 画面描画時に大量の文字列を効率的に構築するために使用
@@ -11,21 +12,48 @@
 
 #include "kiloe.h"
 
+/* 最初に確保する容量 */
+#define ABUF_MIN_CAP 256
+
+/**
+ * 追加バッファにlenバイトを追加できる容量を確保
+ * 容量は倍々に拡張するので、追加を繰り返しても再割り当ては対数回で済む
+ * メモリ不足の場合は-1を返す
+ */
+int abReserve(struct abuf *ab, int len) {
+    if (ab->len + len <= ab->cap) return 0;
+
+    int cap = ab->cap ? ab->cap : ABUF_MIN_CAP;
+    while (cap < ab->len + len) cap *= 2;
+
+    char *new = realloc(ab->b, cap);
+    if (new == NULL) return -1;
+    ab->b = new;
+    ab->cap = cap;
+    return 0;
+}
+
 /**
  * 追加バッファに文字列を追加
  * 必要に応じてバッファサイズを拡張
  */
 void abAppend(struct abuf *ab, const char *s, int len) {
-    // 新しいサイズでメモリを再割り当て
-    char *new = realloc(ab->b, ab->len + len);
-    if (new == NULL) return;  // メモリ不足の場合は何もしない
+    if (len <= 0) return;
+    if (abReserve(ab, len) == -1) return;  // メモリ不足の場合は何もしない
     
     // 新しい文字列を末尾に追加
-    memcpy(&new[ab->len], s, len);
-    ab->b = new;
+    memcpy(&ab->b[ab->len], s, len);
     ab->len += len;
 }
 
+/**
+ * 追加バッファを空にする
+ * 確保済みのメモリは解放せず次の描画で再利用する
+ */
+void abReset(struct abuf *ab) {
+    ab->len = 0;
+}
+
 /**
  * 追加バッファのメモリを解放
  */
@@ -33,4 +61,5 @@ void abFree(struct abuf *ab) {
     free(ab->b);
     ab->b = NULL;
     ab->len = 0;
-}
\ No newline at end of file
+    ab->cap = 0;
+}
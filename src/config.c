@@ -15,6 +15,12 @@ void initDefaultConfig() {
     Config.tab_stop = 8;
     Config.quit_times = 3;
     Config.show_line_numbers = 0;
+    Config.lazy_load = 1;
+    Config.scroll_region = 1;
+    Config.undo_limit = 4096;
+    Config.journal = 1;
+    Config.journal_ops = 64;
+    Config.journal_delay = 1000;
     
     // 表示設定
     strcpy(Config.welcome_message, "Kilo editor -- version 0.0.1");
@@ -84,6 +90,18 @@ int loadConfig(const char *filename) {
             Config.quit_times = atoi(value);
         } else if (strcmp(key, "show_line_numbers") == 0) {
             Config.show_line_numbers = parseBool(value);
+        } else if (strcmp(key, "lazy_load") == 0) {
+            Config.lazy_load = parseBool(value);
+        } else if (strcmp(key, "scroll_region") == 0) {
+            Config.scroll_region = parseBool(value);
+        } else if (strcmp(key, "undo_limit") == 0) {
+            Config.undo_limit = atoi(value);
+        } else if (strcmp(key, "journal") == 0) {
+            Config.journal = parseBool(value);
+        } else if (strcmp(key, "journal_ops") == 0) {
+            Config.journal_ops = atoi(value);
+        } else if (strcmp(key, "journal_delay") == 0) {
+            Config.journal_delay = atoi(value);
         } else if (strcmp(key, "welcome_message") == 0) {
             strncpy(Config.welcome_message, value, sizeof(Config.welcome_message) - 1);
             Config.welcome_message[sizeof(Config.welcome_message) - 1] = '\0';
@@ -4,6 +4,7 @@
  * テキストエディタの基本編集操作を提供：
  * - 文字の挿入
  * - 改行の挿入
+ * - 複数行の文字列の挿入（貼り付け）
  * - 文字の削除（UTF-8対応）
  * 
  * UTF-8マルチバイト文字を適切に処理し、文字境界を考慮した削除を行う
@@ -16,13 +17,15 @@
  * 必要に応じて新しい行を作成
  */
 void editorInsertChar(int c) {
-    // ファイル末尾（最終行の次）にいる場合は新しい行を作成
+    // ファイル末尾（最終行の次）にいる場合は新しい行を作成（取り消し用には文字と改行の挿入）
+    char ins[2] = {c, '\n'};
+    editorUndoRecord(E.cy, E.cx, ins, E.cy == E.numrows ? 2 : 1, NULL, 0);
     if (E.cy == E.numrows) {
         editorInsertRow(E.numrows, "", 0);
     }
     
     // 現在行のカーソル位置に文字を挿入
-    editorRowInsertChar(&E.row[E.cy], E.cx, c);
+    editorRowInsertChar(editorRowAt(E.cy), E.cx, c);
     // カーソルを1つ右に移動
     E.cx++;
 }
@@ -32,20 +35,20 @@ void editorInsertChar(int c) {
  * 行の分割処理も含む
  */
 void editorInsertNewLine() {
+    editorUndoRecord(E.cy, E.cx, "\n", 1, NULL, 0);
     if (E.cx == 0) {
         // 行頭の場合：現在行の前に空行を挿入
         editorInsertRow(E.cy, "", 0);
     } else {
         // 行の途中の場合：現在行を分割
-        erow *row = &E.row[E.cy];
+        erow *row = editorRowAt(E.cy);
         
         // カーソル位置以降の文字で新しい行を作成
-        editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
+        editorInsertRow(E.cy + 1, &editorRowText(row)[E.cx], row->size - E.cx);
         
         // 現在行をカーソル位置で切断
-        row = &E.row[E.cy];  // reallocで位置が変わる可能性があるので再取得
-        row->size = E.cx;
-        row->chars[row->size] = '\0';
+        row = editorRowAt(E.cy);  // チャンク内で位置が変わる可能性があるので再取得
+        editorRowTruncate(row, E.cx);
         editorUpdateRow(row);
     }
     
@@ -54,6 +57,72 @@ void editorInsertNewLine() {
     E.cx = 0;
 }
 
+/**
+ * 貼り付ける文字列を取り消し用に記録
+ * 改行（LF・CR・CRLF）はeditorInsertRowsと同じく1つの改行として記録する
+ */
+static void undoRecordText(const char *s, size_t len) {
+    int at_end = E.cy == E.numrows;
+    char *text = malloc(len + 1);
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '\r') {
+            if (i + 1 < len && s[i + 1] == '\n') i++;
+            text[n++] = '\n';
+        } else {
+            text[n++] = s[i];
+        }
+    }
+    // ファイル末尾では新しい行も作るので、その行の改行も挿入したものとする
+    if (at_end) text[n++] = '\n';
+    editorUndoRecord(E.cy, E.cx, text, n, NULL, 0);
+    free(text);
+}
+
+/**
+ * カーソル位置に複数行の文字列をまとめて挿入（貼り付け用）
+ * 1文字ずつの挿入と違い、行の確保・表示データの更新は各行1回で済む
+ * 先頭の行は現在行に直接挿入し、2行目以降だけをeditorInsertRowsで1回に挿入する
+ * カーソルは挿入した文字列の直後に移動
+ */
+void editorInsertText(const char *s, size_t len) {
+    if (len == 0) return;
+    undoRecordText(s, len);
+    if (E.cy == E.numrows) {
+        editorInsertRow(E.numrows, "", 0);
+    }
+
+    erow *row = editorRowAt(E.cy);
+    const char *end = s + len;
+    const char *eol = s;
+    while (eol < end && *eol != '\n' && *eol != '\r') eol++;
+    if (eol == end) {
+        // 改行を含まなければ現在行に挿入するだけ
+        editorRowInsertString(row, E.cx, s, len);
+        E.cx += len;
+        return;
+    }
+
+    // カーソル位置以降を取り出し、現在行を先頭の行で置き換える
+    size_t taillen = row->size - E.cx;
+    char *tail = malloc(taillen + 1);
+    memcpy(tail, &editorRowText(row)[E.cx], taillen);
+    editorRowTruncate(row, E.cx);
+    editorRowAppendString(row, (char *)s, eol - s);
+
+    // 改行（CRLFは1つの改行）の後ろを行に分けて現在行の後ろに挿入
+    if (*eol == '\r' && eol + 1 < end && eol[1] == '\n') eol++;
+    const char *rest = eol + 1;
+    int n = editorInsertRows(E.cy + 1, rest, end - rest);
+
+    // 最後の行の末尾に元の行の残りを付け直す
+    E.cy += n;
+    row = editorRowAt(E.cy);
+    E.cx = row->size;
+    editorRowAppendString(row, tail, taillen);
+    free(tail);
+}
+
 /**
  * カーソル直前の文字を削除（バックスペース）
  * UTF-8マルチバイト文字を適切に処理
@@ -64,29 +133,29 @@ void editorDelChar() {
     // ファイル先頭（最初の行の行頭）にいる場合は何もしない
     if (E.cx == 0 && E.cy == 0) return;
 
-    erow *row = &E.row[E.cy];
+    erow *row = editorRowAt(E.cy);
     
     if (E.cx > 0) {
         // 行の途中の場合：文字を削除
         
-        // UTF-8文字の開始位置を取得
-        int prev_pos = move_to_prev_char(row->chars, E.cx);
-        int delete_bytes = E.cx - prev_pos;
+        // UTF-8文字の開始位置を取得（ギャップはE.cxに移るので、削除する文字は連続している）
+        int prev_pos = editorRowPrevChar(row, E.cx);
+        editorUndoRecord(E.cy, prev_pos, NULL, 0, &row->chars[prev_pos], E.cx - prev_pos);
         
-        // マルチバイト文字の全バイトを削除
-        for (int i = 0; i < delete_bytes; i++) {
-            editorRowDelChar(row, prev_pos);
-        }
+        // マルチバイト文字の全バイトをまとめて削除
+        editorRowDelRange(row, prev_pos, E.cx);
         
         // カーソルを削除した文字の開始位置に移動
         E.cx = prev_pos;
     } else {
         // 行頭の場合：現在行を前の行に結合
         
+        erow *prev = editorRowAt(E.cy - 1);
+        editorUndoRecord(E.cy - 1, prev->size, NULL, 0, "\n", 1);
         // 前の行の末尾にカーソルを移動
-        E.cx = E.row[E.cy - 1].size;
+        E.cx = prev->size;
         // 現在行の内容を前の行に追加
-        editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
+        editorRowAppendString(prev, editorRowText(row), row->size);
         // 現在行を削除
         editorDelRow(E.cy);
         // カーソルを前の行に移動
@@ -2,42 +2,81 @@
  * file.c - ファイル入出力機能
  * 
  * ファイルの読み込み・保存機能を提供：
- * - テキストファイルの読み込み
- * - エディタ内容のファイル保存
+ * - テキストファイルの読み込み（mmapによる遅延読み込みを含む）
+ * - エディタ内容のファイル保存（一時ファイルへの書き込みとrenameによる原子的な置き換え）
+ * - 保存スレッドによるバックグラウンド保存（行を複製しないスナップショットから書き込む）
+ * - 保存していない編集のジャーナルからの復元
  * - ファイル名の管理
  */
 
 #include "kiloe.h"
 
+#define SAVE_IOV_MAX 1024   /* 1回のwritevで渡すiovecの数（IOV_MAX以下） */
+
 /**
- * 編集中のテキストを1つの文字列に変換
- * 各行を改行文字で区切った文字列を作成
+ * ファイルをmmapして行の区切りだけを先に作成
+ * 改行位置はscanLineEndsで一括抽出し（CRは展開時に除去）、
+ * ROW_CHUNK_MAX行ごとに未展開チャンクを作り、行の中身は表示・編集時に展開する
+ * 通常ファイル以外や空ファイルの場合は-1を返す
  */
-char *editorRowsToString(int *buflen) {
-    int totlen = 0;
-    int j;
-    
-    // 全行の合計文字数を計算（改行文字分も含む）
-    for (j = 0; j < E.numrows; j++) {
-        totlen += E.row[j].size + 1;
+static int editorOpenMapped(char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return -1;
     }
-    *buflen = totlen;
 
-    // バッファを確保して各行をコピー
-    char *buf = malloc(totlen);
-    char *p = buf;
-    for (j = 0; j < E.numrows; j++) {
-        memcpy(p, E.row[j].chars, E.row[j].size);
-        p += E.row[j].size;
-        *p = '\n';
-        p++;
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    // fdは保存時に未変更の範囲をカーネル内でコピーするために開いたままにする
+    // （保存はrenameで置き換えるので、元のファイルの内容は閉じるまで変わらない）
+    E.map = map;
+    E.mapsize = st.st_size;
+    E.mapfd = fd;
+
+    // 改行位置をまとめて抽出し、チャンク単位の行インデックスを作成
+    size_t size = st.st_size;
+    size_t ends[SCAN_BATCH];
+    size_t base = 0;   // 走査を再開する位置
+    size_t start = 0;  // 作成中のチャンクの先頭位置
+    int lines = 0;
+    for (;;) {
+        size_t n = scanLineEnds(map + base, size - base, ends, SCAN_BATCH);
+        for (size_t k = 0; k < n; k++) {
+            size_t next = base + ends[k] + 1;
+            if (++lines == ROW_CHUNK_MAX) {
+                ropeAppendLazy(map + start, next - start, lines);
+                E.numrows += lines;
+                start = next;
+                lines = 0;
+            }
+        }
+        if (n < SCAN_BATCH) {
+            // 改行で終わらない最終行
+            if (n > 0) base += ends[n - 1] + 1;
+            if (base < size) lines++;
+            break;
+        }
+        base += ends[n - 1] + 1;
+    }
+    if (lines > 0) {
+        ropeAppendLazy(map + start, size - start, lines);
+        E.numrows += lines;
     }
 
-    return buf;
+    return 0;
 }
 
 /**
  * ファイルを読み込んで編集バッファにセット
+ * 異常終了して保存されなかった編集のジャーナルが残っていれば復元する
  */
 void editorOpen(char *filename) {
     free(E.filename);
@@ -46,6 +85,14 @@ void editorOpen(char *filename) {
     // ファイル拡張子からシンタックスハイライトを選択
     editorSelectSyntaxHighlight();
 
+    // 遅延読み込み（マッピングは1つだけ保持するので空バッファの時のみ）
+    if (Config.lazy_load && E.map == NULL && E.numrows == 0 &&
+        editorOpenMapped(filename) == 0) {
+        E.dirty = 0;
+        editorJournalRecover();
+        return;
+    }
+
     FILE *fp = fopen(filename, "r");
     if (!fp) die("fopen");
 
@@ -65,10 +112,434 @@ void editorOpen(char *filename) {
     free(line);
     fclose(fp);
     E.dirty = 0;  // 読み込み直後は変更なし
+    editorJournalRecover();
+}
+
+/* 保存スナップショットの要素の種類 */
+enum saveSpanKind {
+    SAVE_ROW,           /* 展開済みの行（ギャップの前後を書き込み、改行を付ける） */
+    SAVE_COPY,          /* 元のファイルからそのままコピーできる範囲 */
+    SAVE_LINES          /* 行末のCRを除いて書き込む未展開チャンク */
+};
+
+/* 保存スナップショットの要素（行の内容やファイルマッピングは複製せずに参照する） */
+struct saveSpan {
+    const char *p;      /* 行の文字列、または未展開チャンクの元データ */
+    size_t len;         /* 行のバイト数（ギャップを除く）、または元データのバイト数 */
+    int gap;            /* SAVE_ROW: ギャップの位置（-1ならギャップなし） */
+    int gaplen;         /* SAVE_ROW: ギャップの長さ */
+    int kind;
+    int n;              /* SAVE_LINES: 行数 */
+};
+
+/* 保存する内容のスナップショット */
+struct saveSnapshot {
+    struct saveSpan *spans;
+    int nspans;
+    int cap;
+    const char *map;    /* 参照しているファイルマッピングとその元のファイル */
+    int mapfd;
+};
+
+/* バックグラウンド保存の状態（保存スレッドの実行中はメインスレッドから書き換えない） */
+static pthread_t saveThread;
+static int saveRunning = 0;             /* スレッドを起動済みで未回収 */
+static int saveDone = 0;                /* 書き込みを終えた（__atomicで読み書き） */
+static struct saveSnapshot saveSnap;
+static char *savePath = NULL;
+static unsigned long saveState = 0;     /* スナップショット時点のテキストの状態（editorUndoMark） */
+static int saveResult = 0;              /* 失敗ならerrno、成功なら0 */
+static size_t saveWritten = 0;
+static struct timespec saveStart, saveEnd;
+static unsigned int saveGen = 0;        /* 保存中のスナップショットの世代（editorSnapshotBeginで取得） */
+
+/* 保存時にwritevへまとめて渡すiovec（行の内容をコピーせずに参照する）と、元のファイルからコピーする範囲 */
+struct saveWriter {
+    int fd;
+    struct iovec iov[SAVE_IOV_MAX];
+    int n;
+    const char *cpsrc;  /* コピー待ちの範囲（ファイルマッピング内） */
+    size_t cplen;
+    int copy;           /* copy_file_rangeを使えるかどうか */
+    const char *map;    /* コピー元のファイルマッピングとファイル */
+    int mapfd;
+    size_t written;     /* 書き込んだバイト数 */
+};
+
+/**
+ * 溜めたiovecをwritevで全て書き込む
+ * 一部しか書けなかった場合やシグナルで中断された場合は残りから書き直す
+ * 
+ * @return: 成功なら0、失敗なら-1（errnoに理由）
+ */
+static int saveWritev(struct saveWriter *w) {
+    struct iovec *iov = w->iov;
+    int n = w->n;
+    while (n > 0) {
+        ssize_t done = writev(w->fd, iov, n);
+        if (done == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        w->written += done;
+        while (n > 0 && (size_t)done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (char *)iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    w->n = 0;
+    return 0;
+}
+
+static int savePush(struct saveWriter *w, const char *p, size_t len);
+
+/**
+ * コピー待ちの範囲を元のファイルからcopy_file_rangeでカーネル内コピー
+ * 対応していない場合（古いカーネルやファイルシステムの組み合わせ）は、
+ * 以降の保存ではマッピングの内容をwritevで書き込む
+ */
+static int saveCopyRange(struct saveWriter *w) {
+    loff_t off = w->cpsrc - w->map;
+    size_t left = w->cplen;
+    w->cplen = 0;
+    while (left > 0) {
+        ssize_t done = copy_file_range(w->mapfd, &off, w->fd, NULL, left, 0);
+        if (done == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP || errno == EINVAL) {
+                w->copy = 0;
+                return savePush(w, w->map + off, left);
+            }
+            return -1;
+        }
+        if (done == 0) {
+            // 元のファイルが外部で切り詰められた
+            errno = EIO;
+            return -1;
+        }
+        w->written += done;
+        left -= done;
+    }
+    return 0;
+}
+
+/**
+ * 書き込み待ちのiovecとコピー待ちの範囲を全て書き出す
+ * （どちらか一方だけが溜まっているので順序は入れ替わらない）
+ */
+static int saveFlush(struct saveWriter *w) {
+    if (w->n > 0 && saveWritev(w) == -1) return -1;
+    if (w->cplen > 0 && saveCopyRange(w) == -1) return -1;
+    return 0;
+}
+
+/**
+ * lenバイトの領域を書き込み待ちに追加（iovecが埋まったら書き出す）
+ */
+static int savePush(struct saveWriter *w, const char *p, size_t len) {
+    if (len == 0) return 0;
+    if (w->cplen > 0 && saveCopyRange(w) == -1) return -1;
+    if (w->n == SAVE_IOV_MAX && saveWritev(w) == -1) return -1;
+    w->iov[w->n].iov_base = (void *)p;
+    w->iov[w->n].iov_len = len;
+    w->n++;
+    return 0;
+}
+
+/**
+ * ファイルマッピング内の未変更の範囲を元のファイルからのコピー待ちに追加
+ * 直前の範囲と連続していれば1つにまとめる
+ */
+static int saveCopy(struct saveWriter *w, const char *src, size_t len) {
+    if (!w->copy) return savePush(w, src, len);
+    if (w->cplen > 0 && w->cpsrc + w->cplen == src) {
+        w->cplen += len;
+        return 0;
+    }
+    if (saveFlush(w) == -1) return -1;
+    w->cpsrc = src;
+    w->cplen = len;
+    return 0;
+}
+
+/**
+ * スナップショットに要素を追加
+ */
+static struct saveSpan *saveSpanAdd(struct saveSnapshot *s, int kind, const char *p, size_t len) {
+    if (s->nspans == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 256;
+        s->spans = realloc(s->spans, sizeof(struct saveSpan) * s->cap);
+    }
+    struct saveSpan *span = &s->spans[s->nspans++];
+    span->p = p;
+    span->len = len;
+    span->gap = -1;
+    span->gaplen = 0;
+    span->kind = kind;
+    span->n = 0;
+    return span;
+}
+
+/**
+ * 現在の全行のスナップショットを作成
+ * 行の文字列やファイルマッピングは参照するだけで、費用は展開済みの行数と未展開チャンク数に比例する
+ * 未展開のチャンクは開いてから一度も変更されていない範囲なので、CRを含まず改行で終わっていれば
+ * 元のファイルからコピーする範囲とする（連続するチャンクは1つにまとめる）
+ * genが0でなければ参照した行にその世代を記録し、保存中に書き換える行はrowDetachで切り離させる
+ */
+static void saveSnapshotTake(struct saveSnapshot *s, unsigned int gen) {
+    memset(s, 0, sizeof(*s));
+    s->map = E.map;
+    s->mapfd = E.map ? E.mapfd : -1;
+
+    int start;
+    for (struct rowChunk *c = ropeChunkAt(0, &start); c; c = ropeChunkAt(start + c->n, &start)) {
+        if (!c->rows) {
+            if (c->src[c->srclen - 1] == '\n' && !memchr(c->src, '\r', c->srclen)) {
+                struct saveSpan *prev = s->nspans ? &s->spans[s->nspans - 1] : NULL;
+                if (prev && prev->kind == SAVE_COPY && prev->p + prev->len == c->src) {
+                    prev->len += c->srclen;
+                } else {
+                    saveSpanAdd(s, SAVE_COPY, c->src, c->srclen);
+                }
+            } else {
+                saveSpanAdd(s, SAVE_LINES, c->src, c->srclen)->n = c->n;
+            }
+            continue;
+        }
+        for (int j = 0; j < c->n; j++) {
+            erow *row = &c->rows[j];
+            struct saveSpan *span = saveSpanAdd(s, SAVE_ROW, row->chars, row->size);
+            if (row->gap >= 0) {
+                span->gap = row->gap;
+                span->gaplen = row->cap - 1 - row->size;
+            }
+            if (gen) row->snap_gen = gen;
+        }
+    }
+}
+
+/**
+ * スナップショットを破棄（参照していた行やマッピングには触れない）
+ */
+static void saveSnapshotFree(struct saveSnapshot *s) {
+    free(s->spans);
+    memset(s, 0, sizeof(*s));
+}
+
+/**
+ * スナップショットの内容を改行区切りでfdに書き込む
+ * 行の内容は直接writevで渡し（ギャップの前後は別の領域）、ファイル全体の複製は作らない
+ * 元のファイルからコピーできる範囲はカーネル内でコピーし、
+ * それ以外の未展開チャンクは読み込み時と同じく行末のCRを除いた各行を渡す
+ * 
+ * @return: 成功なら0、失敗なら-1（errnoに理由）。writtenに書き込んだバイト数を設定
+ */
+static int saveSpans(int fd, const struct saveSnapshot *s, size_t *written) {
+    static const char newline = '\n';
+    struct saveWriter w;
+    w.fd = fd;
+    w.n = 0;
+    w.cplen = 0;
+    w.copy = s->map != NULL;
+    w.map = s->map;
+    w.mapfd = s->mapfd;
+    w.written = 0;
+
+    for (int i = 0; i < s->nspans; i++) {
+        const struct saveSpan *span = &s->spans[i];
+        if (span->kind == SAVE_COPY) {
+            if (saveCopy(&w, span->p, span->len) == -1) return -1;
+        } else if (span->kind == SAVE_LINES) {
+            const char *p = span->p;
+            const char *end = span->p + span->len;
+            for (int j = 0; j < span->n; j++) {
+                const char *nl = memchr(p, '\n', end - p);
+                const char *eol = nl ? nl : end;
+                size_t len = eol - p;
+                while (len > 0 && (p[len - 1] == '\n' || p[len - 1] == '\r')) len--;
+                if (savePush(&w, p, len) == -1 || savePush(&w, &newline, 1) == -1) return -1;
+                p = nl ? nl + 1 : end;
+            }
+        } else {
+            if (span->gap >= 0) {
+                if (savePush(&w, span->p, span->gap) == -1 ||
+                    savePush(&w, span->p + span->gap + span->gaplen, span->len - span->gap) == -1) return -1;
+            } else if (savePush(&w, span->p, span->len) == -1) {
+                return -1;
+            }
+            if (savePush(&w, &newline, 1) == -1) return -1;
+        }
+    }
+    int ret = saveFlush(&w);
+    *written = w.written;
+    return ret;
+}
+
+/**
+ * pathを含むディレクトリをfsync（renameによる置き換えを永続化するため）
+ */
+static int syncDir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    free(dir);
+    if (fd == -1) return -1;
+    int ret = fsync(fd);
+    // fsyncできないファイルシステムでのディレクトリは無視する
+    if (ret == -1 && (errno == EINVAL || errno == EBADF)) ret = 0;
+    close(fd);
+    return ret;
+}
+
+/**
+ * ファイルをスナップショットの内容で原子的に置き換える
+ * 同じディレクトリの一時ファイルに書き込んでfsyncし、renameで置き換えてからディレクトリもfsyncする
+ * 途中で失敗しても元のファイルは残り、一時ファイルは削除する
+ * 既存ファイルのパーミッションと所有者は引き継ぎ、シンボリックリンクはリンク先を置き換える
+ * 新しいファイルのパーミッションは起動時のumaskに従う
+ * 
+ * @return: 成功なら0、失敗なら-1（errnoに理由）。writtenに書き込んだバイト数を設定
+ */
+static int saveWriteFile(const char *filename, const struct saveSnapshot *snap, size_t *written) {
+    struct stat st;
+    char *target = NULL;
+    if (lstat(filename, &st) == 0 && S_ISLNK(st.st_mode)) target = realpath(filename, NULL);
+    const char *path = target ? target : filename;
+    int exists = stat(path, &st) == 0;
+
+    // 一時ファイルは同じディレクトリの「.名前.XXXXXX」（renameが同じファイルシステム内で済むように）
+    const char *slash = strrchr(path, '/');
+    int dirlen = slash ? slash - path + 1 : 0;
+    size_t tmpsize = strlen(path) + 9;
+    char *tmp = malloc(tmpsize);
+    if (!tmp) {
+        free(target);
+        errno = ENOMEM;
+        return -1;
+    }
+    snprintf(tmp, tmpsize, "%.*s.%s.XXXXXX", dirlen, path, path + dirlen);
+
+    int fd = mkstemp(tmp);
+    if (fd == -1) {
+        int saved = errno;
+        free(tmp);
+        free(target);
+        errno = saved;
+        return -1;
+    }
+    // mkstempの0600のまま置き換えるとパーミッションが変わってしまうので、設定できなければ失敗とする
+    // 新しいファイルはopen(..., 0666)で作った場合と同じくumaskを適用する
+    int ok = fchmod(fd, exists ? st.st_mode & 07777 : 0666 & ~E.umask) == 0;
+    // 所有者を変えられない場合（他のユーザーのファイルなど）はそのままにする
+    if (ok && exists && fchown(fd, st.st_uid, st.st_gid) == -1) errno = 0;
+
+    ok = ok && saveSpans(fd, snap, written) == 0 && fsync(fd) == 0;
+    int saved = errno;
+    if (close(fd) == -1 && ok) {
+        ok = 0;
+        saved = errno;
+    }
+    if (ok && rename(tmp, path) == -1) {
+        ok = 0;
+        saved = errno;
+    }
+    if (!ok) {
+        unlink(tmp);
+        free(tmp);
+        free(target);
+        errno = saved;
+        return -1;
+    }
+    int ret = syncDir(path);
+    free(tmp);
+    free(target);
+    return ret;
+}
+
+/**
+ * ファイルを編集中の内容で原子的に置き換える（書き込みが終わるまで戻らない）
+ * 
+ * @return: 成功なら0、失敗なら-1（errnoに理由）。writtenに書き込んだバイト数を設定
+ */
+int editorWriteFile(const char *filename, size_t *written) {
+    struct saveSnapshot snap;
+    saveSnapshotTake(&snap, 0);
+    int ret = saveWriteFile(filename, &snap, written);
+    int saved = errno;
+    saveSnapshotFree(&snap);
+    errno = saved;
+    return ret;
+}
+
+/**
+ * 保存スレッド本体
+ * スナップショットを書き込み、結果を記録してメインスレッドの入力待ちを起こす
+ */
+static void *saveMain(void *arg) {
+    (void)arg;
+    saveResult = saveWriteFile(savePath, &saveSnap, &saveWritten) == -1 ? errno : 0;
+    clock_gettime(CLOCK_MONOTONIC, &saveEnd);
+    __atomic_store_n(&saveDone, 1, __ATOMIC_RELEASE);
+    editorWakeup();
+    return NULL;
+}
+
+/**
+ * 書き終えた保存の後始末と結果の表示
+ * 成功した場合は、テキストがスナップショット時点と同じ状態なら変更なしとする
+ * （保存中に編集して取り消した場合も含む。違う状態ならE.dirtyは編集で増えているので残す）
+ */
+static void saveFinish() {
+    editorSnapshotEnd(saveGen);
+    saveSnapshotFree(&saveSnap);
+    free(savePath);
+    savePath = NULL;
+
+    if (saveResult) {
+        editorSetStatusMessage("Can't save! I/O error: %s", strerror(saveResult));
+        return;
+    }
+    if (editorUndoState() == saveState) E.dirty = 0;
+    editorSetStatusMessage("%zu bytes written to disk in %.1f ms", saveWritten,
+                           (saveEnd.tv_sec - saveStart.tv_sec) * 1e3 +
+                           (saveEnd.tv_nsec - saveStart.tv_nsec) / 1e6);
+    // 保存した内容に含まれる操作はジャーナルから除く
+    editorJournalRebase();
+}
+
+/**
+ * バックグラウンド保存が終わっていれば結果を受け取る（終わっていなければ何もしない）
+ * 画面の更新ごとに呼ばれる
+ */
+void editorSaveCollect() {
+    if (!saveRunning || !__atomic_load_n(&saveDone, __ATOMIC_ACQUIRE)) return;
+    pthread_join(saveThread, NULL);
+    saveRunning = 0;
+    saveFinish();
+}
+
+/**
+ * バックグラウンド保存が終わるまで待って結果を受け取る
+ * 終了時やファイルマッピングを解放する前など、保存を完了させる必要がある場合に使う
+ */
+void editorSaveWait() {
+    if (!saveRunning) return;
+    pthread_join(saveThread, NULL);
+    saveRunning = 0;
+    saveFinish();
 }
 
 /**
  * エディタ内容をファイルに保存
+ * 全行のスナップショットを取って保存スレッドで書き込み、その間も編集を続けられる
+ * 保存中に書き換えた行は書き換える時点で複製し、スナップショットは保存開始時の内容のまま書き込む
+ * 完了や失敗はステータスメッセージで知らせる（前回の保存が終わっていなければ待つ）
  */
 void editorSave() {
     if (E.filename == NULL) {
@@ -81,23 +552,22 @@ void editorSave() {
         editorSelectSyntaxHighlight();
     }
 
-    int len;
-    char *buf = editorRowsToString(&len);
-    int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
+    editorSaveWait();
+    clock_gettime(CLOCK_MONOTONIC, &saveStart);
 
-    if (fd != -1) {
-        if (ftruncate(fd, len) != -1) {
-            if (write(fd, buf, len) != -1) {
-                close(fd);
-                free(buf);
-                E.dirty = 0;
-                editorSetStatusMessage("%d bytes written to disk", len);
-                return;
-            }
-        }
-        close(fd);
+    saveGen = editorSnapshotBegin();
+    saveSnapshotTake(&saveSnap, saveGen);
+    savePath = strdup(E.filename);
+    saveState = editorUndoMark();
+    editorJournalMark();
+    saveDone = 0;
+    editorWakeupInit();
+    if (pthread_create(&saveThread, NULL, saveMain, NULL) != 0) {
+        // スレッドを作れない場合はその場で書き込む
+        saveMain(NULL);
+        saveFinish();
+        return;
     }
-
-    free(buf);
-    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
-}
\ No newline at end of file
+    saveRunning = 1;
+    editorSetStatusMessage("Saving...");
+}
@@ -51,9 +51,21 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
                 if (callback) callback(buf, c);
                 return buf;
             }
-        } else if (c == ARROW_UP || c == ARROW_DOWN || c == ARROW_LEFT || c == ARROW_RIGHT) {
-            // 矢印キーをコールバックに送信（検索機能で使用）
-            if (callback) callback(buf, c);
+        } else if (c == PASTE_START) {
+            // 貼り付けは最初の行だけを入力に追加
+            int len;
+            char *text = editorReadPaste(&len);
+            for (int i = 0; i < len && text[i] != '\r' && text[i] != '\n'; i++) {
+                if (buflen == bufsize - 1) {
+                    bufsize *= 2;
+                    buf = realloc(buf, bufsize);
+                }
+                buf[buflen++] = text[i];
+            }
+            buf[buflen] = '\0';
+            free(text);
+        } else if (c == ARROW_UP || c == ARROW_DOWN || c == ARROW_LEFT || c == ARROW_RIGHT || c == WAKEUP) {
+            // 矢印キーと起床通知は下でコールバックに送信（検索機能で使用）
         } else if (!iscntrl(c) || (unsigned char)c >= 0x80) {
             // 通常文字またはUTF-8文字の入力
             if (buflen == bufsize - 1) {
@@ -75,24 +87,24 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
  * UTF-8文字境界を考慮した適切な移動
  */
 void editorMoveCursor(int key) {
-    erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+    erow *row = editorRowAt(E.cy);
 
     switch(key) {
         case ARROW_LEFT:
             if (E.cx != 0) {
                 // UTF-8文字境界を考慮して前の文字へ移動
-                E.cx = move_to_prev_char(row->chars, E.cx);
+                E.cx = editorRowPrevChar(row, E.cx);
             } else if (E.cy > 0) {
                 // 行頭で左矢印：前行の行末へ移動
                 E.cy--;
-                E.cx = E.row[E.cy].size;
+                E.cx = editorRowAt(E.cy)->size;
             }
             break;
             
         case ARROW_RIGHT:
             if (row && E.cx < row->size) {
                 // UTF-8文字境界を考慮して次の文字へ移動
-                E.cx = move_to_next_char(row->chars, E.cx, row->size);
+                E.cx = editorRowNextChar(row, E.cx);
             } else if (row && E.cx == row->size) {
                 // 行末で右矢印：次行の行頭へ移動
                 E.cy++;
@@ -105,7 +117,7 @@ void editorMoveCursor(int key) {
             // 上下移動時は現在の表示位置(rx)を保持
             int target_rx = E.rx;
             if (E.cy < E.numrows) {
-                target_rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+                target_rx = editorRowCxToRx(editorRowAt(E.cy), E.cx);
             }
             
             // 行を移動
@@ -116,7 +128,7 @@ void editorMoveCursor(int key) {
             }
             
             // 新しい行で同じ表示位置に最も近いバイト位置を計算
-            row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+            row = editorRowAt(E.cy);
             if (row) {
                 E.cx = editorRowRxToCx(row, target_rx);
             } else {
@@ -127,7 +139,7 @@ void editorMoveCursor(int key) {
     }
     
     // カーソル位置が行の範囲内に収まるよう調整
-    row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+    row = editorRowAt(E.cy);
     int rowlen = row ? row->size : 0;
     if (E.cx > rowlen) {
         E.cx = rowlen;
@@ -151,13 +163,16 @@ void editorProcessKeypress() {
             break;
 
         case CTRL_KEY('q'):
-            // Ctrl+Q：終了
+            // Ctrl+Q：終了（保存中なら書き終えてから変更の有無を確認する）
+            editorSaveWait();
             if (E.dirty && quit_times > 0) {
                 editorSetStatusMessage("WARNING!!! File has unsaved changes. "
                     "Press Ctrl-Q %d more times to quit.", quit_times);
                 quit_times--;
                 return;
             }
+            // 保存したか変更を破棄したのでジャーナルは不要
+            editorJournalClose(1);
             // 画面クリアして終了
             write(STDOUT_FILENO, "\x1b[2J", 4);
             write(STDOUT_FILENO, "\x1b[H", 3);
@@ -177,7 +192,7 @@ void editorProcessKeypress() {
         case END:
             // End：行末に移動
             if (E.cy < E.numrows) {
-                E.cx = E.row[E.cy].size;
+                E.cx = editorRowAt(E.cy)->size;
             }
             break;
         
@@ -186,6 +201,16 @@ void editorProcessKeypress() {
             editorFind();
             break;
 
+        case CTRL_KEY('z'):
+            // Ctrl+Z：元に戻す
+            if (!editorUndo()) editorSetStatusMessage("Nothing to undo");
+            break;
+
+        case CTRL_KEY('y'):
+            // Ctrl+Y：やり直し
+            if (!editorRedo()) editorSetStatusMessage("Nothing to redo");
+            break;
+
         case BACKSPACE:
         case CTRL_KEY('h'):
         case DELETE:
@@ -221,9 +246,24 @@ void editorProcessKeypress() {
             editorMoveCursor(c);
             break;
 
+        case PASTE_START:
+            {
+                // 貼り付け：内容をまとめて挿入
+                int len;
+                char *text = editorReadPaste(&len);
+                editorInsertText(text, len);
+                free(text);
+            }
+            break;
+
         case CTRL_KEY('l'):
+            // 画面リフレッシュ：次のフレームで全体を描き直す
+            editorScreenInvalidate();
+            break;
+
         case ESC:
-            // 画面リフレッシュ・ESC（何もしない）
+        case WAKEUP:
+            // ESC・起床通知（何もしない）
             break;
 
         default:
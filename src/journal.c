@@ -0,0 +1,679 @@
+/**
+ * journal.c - 障害復旧用のジャーナル
+ *
+ * 保存していない編集を、編集中のファイルと同じディレクトリの「.名前.kiloe-journal」に追記する：
+ * - 編集操作は（位置、挿入したバイト列、削除したバイト列）のレコードとして記録する
+ * - 連続した文字の入力・削除は書き込む前に1つのレコードにまとめる
+ * - 書き込みとfdatasyncはジャーナルスレッドが、一定数の操作がたまるか入力が止まった時にまとめて行う
+ *   （メインスレッドはメモリ上のバッファに追記するだけなので、キー入力ごとの遅延は増えない）
+ * - ファイルを開く時にジャーナルが残っていれば、書き換わる行の範囲だけを1つのテキストに取り出し、
+ *   全レコードを順に適用してから行として1回で戻す（編集ごとに行を作り直さない）
+ * - 保存に成功したら、保存開始後の操作だけを残して作り直す（なければ削除する）
+ *
+ * ヘッダには元のファイルのサイズと更新時刻を記録し、ファイルが変わっていれば復元しない
+ * 各レコードにはハッシュを付け、書き込み途中で壊れた末尾は捨てる
+ */
+
+#include "kiloe.h"
+
+#define JOURNAL_MAGIC "KILOEJ1"     /* ヘッダの識別子（NUL終端を含めて8バイト） */
+#define JOURNAL_SUFFIX "kiloe-journal"
+#define JOURNAL_MERGE_MAX 1024      /* 1つのレコードにまとめる最大バイト数 */
+
+/* ジャーナルのヘッダ */
+struct journalHeader {
+    char magic[8];                  /* JOURNAL_MAGIC */
+    long long size;                 /* 元のファイルのサイズ */
+    long long mtime_sec;            /* 元のファイルの更新時刻 */
+    long long mtime_nsec;
+    int pid;                        /* 書き込んでいるプロセス */
+    unsigned int check;             /* ここまでのハッシュ */
+};
+
+/* 操作レコード（直後に挿入したバイト列、削除したバイト列の順に続く） */
+struct journalRecord {
+    unsigned int check;             /* check以降のヘッダとバイト列のハッシュ */
+    int row;                        /* 操作位置 */
+    int col;
+    unsigned int inslen;            /* 挿入したバイト数 */
+    unsigned int dellen;            /* 削除したバイト数 */
+};
+
+/* 復元中のテキスト（置き換える範囲の行を「行＋改行」で連結し、編集位置にギャップを置いたもの） */
+struct journalText {
+    char *b;
+    size_t cap;
+    size_t gap;                     /* ギャップの先頭 */
+    size_t gapend;                  /* ギャップの終わり（以降は後半の文字） */
+    int row, col;                   /* ギャップの位置（範囲の先頭からの行, バイト位置） */
+};
+
+static char *journalPath = NULL;
+static int journalFd = -1;
+static off_t journalWritten = 0;    /* ファイルに書き込み済みの長さ */
+static size_t journalFlushing = 0;  /* ジャーナルスレッドが書き込み中の長さ */
+static off_t journalMarkOffset = 0; /* 保存開始時点のジャーナルの長さ */
+static int journalDisabled = 0;     /* 他のプロセスのジャーナルや書き込みの失敗のため記録しない */
+
+/* メインスレッドとジャーナルスレッドで共有する状態（journalLockで保護） */
+static pthread_mutex_t journalLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t journalCond;
+static int journalCondReady = 0;
+static pthread_t journalThread;
+static int journalRunning = 0;
+static int journalStopping = 0;
+static struct abuf journalPending = ABUF_INIT;  /* まだ書き込んでいないレコード */
+static int journalLast = -1;        /* journalPending内の最後のレコードの位置（まとめられなければ-1） */
+static int journalOps = 0;          /* journalPendingに記録した操作数 */
+static struct timespec journalLastOp;
+static int journalOpsLimit;         /* 記録時点のConfig.journal_ops */
+static int journalDelay;            /* 記録時点のConfig.journal_delay */
+static int journalError = 0;        /* 書き込みに失敗した場合のerrno */
+
+/**
+ * FNV-1aハッシュ
+ */
+static unsigned int journalHash(const void *p, size_t len) {
+    const unsigned char *s = p;
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * 編集中のファイルに対するジャーナルのパス（呼び出し側で解放）
+ */
+static char *journalPathFor(const char *filename) {
+    const char *slash = strrchr(filename, '/');
+    int dirlen = slash ? slash - filename + 1 : 0;
+    char *path = malloc(strlen(filename) + sizeof(JOURNAL_SUFFIX) + 2);
+    sprintf(path, "%.*s.%s." JOURNAL_SUFFIX, dirlen, filename, filename + dirlen);
+    return path;
+}
+
+/**
+ * 編集中のファイルの現在の状態でヘッダを作成
+ * ファイルがまだなければサイズと更新時刻は-1とする
+ */
+static void journalHeaderInit(struct journalHeader *h) {
+    struct stat st;
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, JOURNAL_MAGIC, sizeof(h->magic));
+    if (stat(E.filename, &st) == 0) {
+        h->size = st.st_size;
+        h->mtime_sec = st.st_mtim.tv_sec;
+        h->mtime_nsec = st.st_mtim.tv_nsec;
+    } else {
+        h->size = h->mtime_sec = h->mtime_nsec = -1;
+    }
+    h->pid = getpid();
+    h->check = journalHash(h, offsetof(struct journalHeader, check));
+}
+
+/**
+ * 位置offからlenバイトを書き込んでfdatasync
+ *
+ * @return: 成功なら0、失敗ならerrno
+ */
+static int journalWriteAt(int fd, const char *p, size_t len, off_t off) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, off);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        p += n;
+        len -= n;
+        off += n;
+    }
+    return fdatasync(fd) == -1 ? errno : 0;
+}
+
+/**
+ * ジャーナルスレッド本体
+ * 操作がConfig.journal_ops件たまるか、Config.journal_delayミリ秒入力が止まるまで待ち、
+ * たまったレコードをまとめて書き込んでfdatasyncする（停止を指示されたら残りを書き込んで終わる）
+ */
+static void *journalMain(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&journalLock);
+    for (;;) {
+        while (!journalStopping && journalPending.len == 0) {
+            pthread_cond_wait(&journalCond, &journalLock);
+        }
+        while (!journalStopping && journalOps < journalOpsLimit) {
+            // 最後の操作から待つので、入力が続く間は期限が延びる
+            struct timespec until = journalLastOp, now;
+            until.tv_sec += journalDelay / 1000;
+            until.tv_nsec += (long)(journalDelay % 1000) * 1000000;
+            if (until.tv_nsec >= 1000000000) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (now.tv_sec > until.tv_sec ||
+                (now.tv_sec == until.tv_sec && now.tv_nsec >= until.tv_nsec)) break;
+            pthread_cond_timedwait(&journalCond, &journalLock, &until);
+        }
+        if (journalPending.len == 0) break;
+
+        // バッファを受け取って書き込む間も、メインスレッドは新しいバッファに追記できる
+        struct abuf out = journalPending;
+        journalPending = (struct abuf)ABUF_INIT;
+        journalOps = 0;
+        journalLast = -1;
+        journalFlushing = out.len;
+        off_t off = journalWritten;
+        pthread_mutex_unlock(&journalLock);
+
+        int err = journalWriteAt(journalFd, out.b, out.len, off);
+        off += out.len;
+        abFree(&out);
+
+        pthread_mutex_lock(&journalLock);
+        journalFlushing = 0;
+        if (err) {
+            journalError = err;
+            break;
+        }
+        journalWritten = off;
+    }
+    pthread_mutex_unlock(&journalLock);
+    return NULL;
+}
+
+/**
+ * ジャーナルスレッドを停止（記録済みのレコードは書き込んでから止まる）
+ */
+static void journalStopThread() {
+    if (!journalRunning) return;
+    pthread_mutex_lock(&journalLock);
+    journalStopping = 1;
+    pthread_cond_broadcast(&journalCond);
+    pthread_mutex_unlock(&journalLock);
+    pthread_join(journalThread, NULL);
+    journalRunning = 0;
+    journalStopping = 0;
+}
+
+/**
+ * ジャーナルスレッドを起動
+ * 待ち時間はシステム時刻の変更に影響されないようにCLOCK_MONOTONICで測る
+ */
+static int journalStartThread() {
+    if (!journalCondReady) {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&journalCond, &attr);
+        pthread_condattr_destroy(&attr);
+        journalCondReady = 1;
+    }
+    if (pthread_create(&journalThread, NULL, journalMain, NULL) != 0) return -1;
+    journalRunning = 1;
+    return 0;
+}
+
+/**
+ * ジャーナルを閉じて状態を初期化
+ */
+static void journalReset() {
+    if (journalFd != -1) close(journalFd);
+    journalFd = -1;
+    free(journalPath);
+    journalPath = NULL;
+    journalWritten = 0;
+    journalFlushing = 0;
+    journalMarkOffset = 0;
+    abFree(&journalPending);
+    journalLast = -1;
+    journalOps = 0;
+    journalError = 0;
+}
+
+/**
+ * 書き込みに失敗したジャーナルを閉じ、このセッションでは記録しない
+ * （書き込めた分までは有効なジャーナルとして残す）
+ */
+static void journalFail(int err) {
+    journalStopThread();
+    journalReset();
+    journalDisabled = 1;
+    editorSetStatusMessage("Journal disabled! I/O error: %s", strerror(err));
+}
+
+/**
+ * ジャーナルを作成し、ヘッダを書き込み待ちのバッファに入れる
+ */
+static int journalCreate() {
+    journalPath = journalPathFor(E.filename);
+    journalFd = open(journalPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (journalFd == -1) {
+        journalFail(errno);
+        return -1;
+    }
+    struct journalHeader h;
+    journalHeaderInit(&h);
+    if (abReserve(&journalPending, sizeof(h)) == -1) {
+        journalFail(ENOMEM);
+        return -1;
+    }
+    abAppend(&journalPending, (const char *)&h, sizeof(h));
+    return 0;
+}
+
+/**
+ * レコードのハッシュ（ヘッダのcheck以降とバイト列から計算）
+ */
+static unsigned int journalRecordHash(const struct journalRecord *r, const char *bytes) {
+    return journalHash(&r->row, sizeof(*r) - sizeof(r->check)) ^
+           journalHash(bytes, r->inslen + r->dellen);
+}
+
+/**
+ * 最後のレコードに今回の操作をまとめる（まとめられなければ0を返す）
+ * まとめ方はeditorUndoRecordと同じく、続けて入力した文字と、バックスペース・Deleteの連続
+ */
+static int journalMerge(int row, int col, const char *ins, size_t inslen, const char *del, size_t dellen) {
+    if (journalLast == -1) return 0;
+    struct journalRecord r;
+    memcpy(&r, journalPending.b + journalLast, sizeof(r));
+    if (r.row != row || r.inslen + r.dellen + inslen + dellen > JOURNAL_MERGE_MAX) return 0;
+    if ((inslen && memchr(ins, '\n', inslen)) || (dellen && memchr(del, '\n', dellen))) return 0;
+
+    if (r.dellen == 0 && dellen == 0 && col == r.col + (int)r.inslen) {
+        // 確保できなければまとめずに返し、新しいレコードの確保で失敗として扱う
+        if (abReserve(&journalPending, inslen) == -1) return 0;
+        abAppend(&journalPending, ins, inslen);
+        r.inslen += inslen;
+    } else if (r.inslen == 0 && inslen == 0 && (col + (int)dellen == r.col || col == r.col)) {
+        if (abReserve(&journalPending, dellen) == -1) return 0;
+        char *bytes = journalPending.b + journalLast + sizeof(r);
+        if (col == r.col) {
+            // Delete：削除した文字は後ろに続く
+            memcpy(bytes + r.dellen, del, dellen);
+        } else {
+            // バックスペース：削除した文字は前に付く
+            memmove(bytes + dellen, bytes, r.dellen);
+            memcpy(bytes, del, dellen);
+            r.col = col;
+        }
+        journalPending.len += dellen;
+        r.dellen += dellen;
+    } else {
+        return 0;
+    }
+    r.check = journalRecordHash(&r, journalPending.b + journalLast + sizeof(r));
+    memcpy(journalPending.b + journalLast, &r, sizeof(r));
+    return 1;
+}
+
+/**
+ * 編集操作をジャーナルに記録
+ * 位置(row, col)でdellenバイトのdelを削除し、inslenバイトのinsを挿入した操作として追記する
+ * 書き込みはジャーナルスレッドに任せ、ここではバッファに追記するだけ
+ */
+void editorJournalRecord(int row, int col, const char *ins, size_t inslen, const char *del, size_t dellen) {
+    if (!Config.journal || E.filename == NULL || journalDisabled) return;
+    if (journalFd == -1 && journalCreate() == -1) return;
+    if (!journalRunning && journalStartThread() == -1) {
+        journalFail(errno);
+        return;
+    }
+
+    pthread_mutex_lock(&journalLock);
+    int err = journalError;
+    if (!err && !journalMerge(row, col, ins, inslen, del, dellen)) {
+        // 一部だけ追記したレコードを残さないよう、先にレコード全体の領域を確保する
+        struct journalRecord r = {0, row, col, inslen, dellen};
+        if (abReserve(&journalPending, sizeof(r) + inslen + dellen) == -1) {
+            err = ENOMEM;
+        } else {
+            journalLast = journalPending.len;
+            abAppend(&journalPending, (const char *)&r, sizeof(r));
+            abAppend(&journalPending, ins, inslen);
+            abAppend(&journalPending, del, dellen);
+            r.check = journalRecordHash(&r, journalPending.b + journalLast + sizeof(r));
+            memcpy(journalPending.b + journalLast, &r, sizeof(r));
+        }
+    }
+    if (!err) {
+        clock_gettime(CLOCK_MONOTONIC, &journalLastOp);
+        journalOpsLimit = Config.journal_ops;
+        journalDelay = Config.journal_delay;
+        // スレッドを起こすのはバッファが空でなくなった時と、操作数が上限に達した時だけ
+        if (++journalOps == 1 || journalOps >= journalOpsLimit) pthread_cond_broadcast(&journalCond);
+    }
+    pthread_mutex_unlock(&journalLock);
+    if (err) journalFail(err);
+}
+
+/**
+ * バイト列に含まれる改行の数
+ */
+static int journalCountLines(const char *s, size_t len) {
+    int n = 0;
+    for (const char *p = s; (p = memchr(p, '\n', s + len - p)); p++) n++;
+    return n;
+}
+
+/**
+ * 先頭から壊れていないレコードをたどり、復元で書き換わる行の範囲を求める
+ * 最初のfirst行と最後のtail行はどのレコードでも変わらない
+ * 
+ * @return: 適用を試みるレコードの終わりの位置
+ */
+static size_t journalScan(const char *map, size_t size, int *first, int *tail) {
+    int numrows = E.numrows;
+    *first = *tail = numrows;
+    size_t off = sizeof(struct journalHeader);
+    while (off + sizeof(struct journalRecord) <= size) {
+        struct journalRecord r;
+        memcpy(&r, map + off, sizeof(r));
+        const char *bytes = map + off + sizeof(r);
+        if (size - off - sizeof(r) < (size_t)r.inslen + r.dellen ||
+            r.check != journalRecordHash(&r, bytes)) break;
+        if (r.row < 0 || r.row > numrows || r.col < 0) break;
+
+        // 操作した行と、削除した改行でつながる行より後ろは変わらない
+        int dellines = journalCountLines(bytes + r.inslen, r.dellen);
+        int after = numrows - r.row - dellines - 1;
+        if (r.row < *first) *first = r.row;
+        if (after < *tail) *tail = after < 0 ? 0 : after;
+        numrows += journalCountLines(bytes, r.inslen) - dellines;
+        off += sizeof(r) + r.inslen + r.dellen;
+    }
+    return off;
+}
+
+/**
+ * 行firstから行lastの手前までをギャップを先頭に置いたテキストとして取り出す
+ * 
+ * @return: 成功なら0、メモリ不足なら-1
+ */
+static int journalTextLoad(struct journalText *t, int first, int last) {
+    size_t len = 0;
+    erow *row = first < last ? editorRowAt(first) : NULL;
+    for (int i = first; i < last; i++) {
+        len += row->size + 1;
+        if (i + 1 < last) row = editorRowNext(row);
+    }
+    t->cap = len + len / 8 + 4096;
+    t->b = malloc(t->cap);
+    if (!t->b) return -1;
+    t->gap = t->row = t->col = 0;
+    t->gapend = t->cap - len;
+
+    char *p = t->b + t->gapend;
+    row = first < last ? editorRowAt(first) : NULL;
+    for (int i = first; i < last; i++) {
+        memcpy(p, editorRowText(row), row->size);
+        p += row->size;
+        *p++ = '\n';
+        if (i + 1 < last) row = editorRowNext(row);
+    }
+    return 0;
+}
+
+/**
+ * ギャップを位置(row, col)に移す（動かした文字の数に比例する時間で済む）
+ * 
+ * @return: 位置がテキストの外なら-1
+ */
+static int journalTextSeek(struct journalText *t, int row, int col) {
+    if (row < t->row || (row == t->row && col < t->col)) {
+        // 後ろに戻る場合は目的の行の先頭まで戻す
+        size_t p = t->gap;
+        int r = t->row;
+        while (p > 0) {
+            if (t->b[p - 1] == '\n' && r-- == row) break;
+            p--;
+        }
+        size_t n = t->gap - p;
+        memmove(t->b + t->gapend - n, t->b + p, n);
+        t->gap = p;
+        t->gapend -= n;
+        t->row = row;
+        t->col = 0;
+    }
+
+    size_t p = t->gapend;
+    int c = t->col;
+    for (int r = t->row; r < row; r++) {
+        const char *nl = memchr(t->b + p, '\n', t->cap - p);
+        if (!nl) return -1;
+        p = nl - t->b + 1;
+        c = 0;
+    }
+    size_t n = col - c;
+    if (t->cap - p < n || memchr(t->b + p, '\n', n)) return -1;
+    p += n;
+
+    n = p - t->gapend;
+    memmove(t->b + t->gap, t->b + t->gapend, n);
+    t->gap += n;
+    t->gapend = p;
+    t->row = row;
+    t->col = col;
+    return 0;
+}
+
+/**
+ * 位置(row, col)でdellenバイトを削除してからinsを挿入
+ * テキストは常に改行で終わるように保つ（そうならない操作は適用しない）
+ * 
+ * @return: 適用できない操作なら-1（テキストは変えない）、適用した場合は0
+ */
+static int journalTextApply(struct journalText *t, int row, int col, const char *ins, size_t inslen, size_t dellen) {
+    if (journalTextSeek(t, row, col) == -1) return -1;
+    if (t->cap - t->gapend < dellen) return -1;
+    // 末尾まで削除する場合は、挿入する文字列か残った行の終わりが改行であること
+    if (t->gapend + dellen == t->cap && (inslen ? ins[inslen - 1] != '\n' : t->col != 0)) return -1;
+
+    if (t->gapend + dellen - t->gap < inslen) {
+        // 倍々に拡張し、ギャップより後ろの文字を新しい末尾に移す
+        size_t cap = t->cap * 2 + inslen;
+        char *b = realloc(t->b, cap);
+        if (!b) return -1;
+        size_t n = t->cap - t->gapend;
+        memmove(b + cap - n, b + t->gapend, n);
+        t->b = b;
+        t->gapend = cap - n;
+        t->cap = cap;
+    }
+    t->gapend += dellen;
+    memcpy(t->b + t->gap, ins, inslen);
+    t->gap += inslen;
+
+    const char *nl = inslen ? memrchr(ins, '\n', inslen) : NULL;
+    if (nl) {
+        t->row += journalCountLines(ins, inslen);
+        t->col = ins + inslen - nl - 1;
+    } else {
+        t->col += inslen;
+    }
+    return 0;
+}
+
+/**
+ * 編集中のファイルのジャーナルが残っていれば復元する（ファイルを読み込んだ直後に呼ぶ）
+ * ジャーナルをmmapし、壊れていないレコードを書き換わる範囲のテキストに順に適用してから行に戻す
+ * （範囲外の行は遅延読み込みのまま展開しない）
+ * 以降の編集は同じジャーナルに続けて記録する
+ * 他のプロセスが使用中のジャーナルや、ファイルが書き換えられた後のジャーナルは復元せず、そのまま残す
+ */
+void editorJournalRecover() {
+    if (!Config.journal || E.filename == NULL) return;
+    char *path = journalPathFor(E.filename);
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct journalHeader)) {
+        // ジャーナルがない（ヘッダを書く前に終了した場合は空のジャーナルとして捨てる）
+        if (fd != -1) {
+            close(fd);
+            unlink(path);
+        }
+        free(path);
+        return;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        free(path);
+        return;
+    }
+
+    struct journalHeader h, cur;
+    memcpy(&h, map, sizeof(h));
+    journalHeaderInit(&cur);
+    const char *reason = NULL;
+    if (memcmp(h.magic, JOURNAL_MAGIC, sizeof(h.magic)) != 0 ||
+        h.check != journalHash(&h, offsetof(struct journalHeader, check))) {
+        reason = "is corrupted";
+    } else if (h.pid != cur.pid && (kill(h.pid, 0) == 0 || errno == EPERM)) {
+        reason = "is in use by another process";
+    } else if (h.size != cur.size || h.mtime_sec != cur.mtime_sec || h.mtime_nsec != cur.mtime_nsec) {
+        reason = "does not match the file";
+    }
+    if (reason) {
+        editorSetStatusMessage("Journal %s %s; not recovered", path, reason);
+        journalDisabled = 1;
+        munmap(map, st.st_size);
+        close(fd);
+        free(path);
+        return;
+    }
+
+    // 壊れたレコード（書き込み途中で終了した末尾）か、適用できないレコードで止める
+    int first, tail;
+    size_t end = journalScan(map, st.st_size, &first, &tail);
+    size_t off = sizeof(h);
+    int n = 0;
+    if (end > off) {
+        struct journalText t;
+        if (journalTextLoad(&t, first, E.numrows - tail) == -1) {
+            editorSetStatusMessage("Journal %s: out of memory; not recovered", path);
+            journalDisabled = 1;
+            munmap(map, st.st_size);
+            close(fd);
+            free(path);
+            return;
+        }
+        while (off < end) {
+            struct journalRecord r;
+            memcpy(&r, map + off, sizeof(r));
+            if (journalTextApply(&t, r.row - first, r.col, map + off + sizeof(r), r.inslen, r.dellen) == -1) break;
+            off += sizeof(r) + r.inslen + r.dellen;
+            n++;
+        }
+        if (n > 0) {
+            // 範囲の行をまとめて置き換え、カーソルを最後の操作の位置に置く
+            memmove(t.b + t.gap, t.b + t.gapend, t.cap - t.gapend);
+            editorReplaceRows(first, E.numrows - tail - first, t.b, t.gap + t.cap - t.gapend);
+            E.cy = first + t.row;
+            E.cx = t.col;
+        }
+        free(t.b);
+    }
+    munmap(map, st.st_size);
+
+    // 捨てた末尾を切り詰め、ヘッダをこのプロセスのものに書き換えて記録を続ける
+    if (ftruncate(fd, off) == -1 || journalWriteAt(fd, (const char *)&cur, sizeof(cur), 0) != 0) {
+        editorSetStatusMessage("Journal %s is not writable; not recovered", path);
+        journalDisabled = 1;
+        close(fd);
+        free(path);
+        return;
+    }
+    journalFd = fd;
+    journalPath = path;
+    journalWritten = off;
+    if (n > 0) {
+        if (E.dirty == 0) E.dirty = 1;
+        editorSetStatusMessage("Recovered %d edits from %s", n, path);
+    }
+}
+
+/**
+ * 保存開始時点のジャーナルの長さを記録（保存のスナップショットを取った直後に呼ぶ）
+ * これ以降の操作は保存した内容に含まれないので、最後のレコードにもまとめない
+ */
+void editorJournalMark() {
+    if (journalFd == -1) {
+        journalMarkOffset = sizeof(struct journalHeader);
+        return;
+    }
+    pthread_mutex_lock(&journalLock);
+    // 書き込み中のバッファはjournalPendingから外れているので、その分も含める
+    journalMarkOffset = journalWritten + journalFlushing + journalPending.len;
+    journalLast = -1;
+    pthread_mutex_unlock(&journalLock);
+}
+
+/**
+ * 保存に成功した後、ジャーナルを保存したファイルに対するものに作り直す
+ * 保存開始後の操作がなければ削除し、あればその操作だけを新しいヘッダの後ろに移す
+ * 作り直したジャーナルは一時ファイルに書いてからrenameで置き換える
+ */
+void editorJournalRebase() {
+    if (journalFd == -1) return;
+    journalStopThread();
+    if (journalError) {
+        journalFail(journalError);
+        return;
+    }
+    if (journalWritten <= journalMarkOffset) {
+        editorJournalClose(1);
+        return;
+    }
+
+    struct journalHeader h;
+    journalHeaderInit(&h);
+    size_t taillen = journalWritten - journalMarkOffset;
+    struct abuf ab = ABUF_INIT;
+    abAppend(&ab, (const char *)&h, sizeof(h));
+    char *tmp = malloc(strlen(journalPath) + 5);
+    sprintf(tmp, "%s.tmp", journalPath);
+    int fd = -1, err = 0;
+    errno = 0;
+    if (abReserve(&ab, taillen) == -1) {
+        err = ENOMEM;
+    } else if (pread(journalFd, ab.b + ab.len, taillen, journalMarkOffset) != (ssize_t)taillen) {
+        err = errno ? errno : EIO;
+    } else if ((fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) == -1) {
+        err = errno;
+    } else {
+        ab.len += taillen;
+        err = journalWriteAt(fd, ab.b, ab.len, 0);
+        if (!err && rename(tmp, journalPath) == -1) err = errno;
+    }
+    if (err) {
+        if (fd != -1) {
+            close(fd);
+            unlink(tmp);
+        }
+        free(tmp);
+        abFree(&ab);
+        journalFail(err);
+        return;
+    }
+    close(journalFd);
+    journalFd = fd;
+    journalWritten = ab.len;
+    free(tmp);
+    abFree(&ab);
+}
+
+/**
+ * ジャーナルを閉じる（記録済みのレコードは書き込んでから閉じる）
+ * removeが真ならジャーナルを削除する（変更を保存したか、破棄して終了する場合）
+ */
+void editorJournalClose(int remove) {
+    journalStopThread();
+    if (remove && journalPath) unlink(journalPath);
+    journalReset();
+    journalDisabled = 0;
+}
@@ -19,12 +19,19 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
@@ -42,8 +49,12 @@
 #define SPC ' '                     /* スペース文字 */
 
 /* バッファ初期化と配列サイズマクロ */
-#define ABUF_INIT {NULL, 0}         /* 追加バッファの初期化 */
+#define ABUF_INIT {NULL, 0, 0}      /* 追加バッファの初期化 */
 #define HLDB_ENTRIES (getHLDBEntries()) /* 動的シンタックスハイライトデータベースサイズ */
+#define ROW_CHUNK_MAX 64            /* 行チャンク1つあたりの最大行数 */
+#define ROW_GAP_MIN 16              /* 行のギャップを広げる時の最小の余裕 */
+#define ROW_CKPT_STRIDE 256         /* cx⇔rx変換用チェックポイントの間隔（バイト） */
+#define SCAN_BATCH 4096             /* 改行位置を一度に抽出する最大数 */
 
 /* エディタキー定義 - 特殊キーを識別するための定数 */
 enum editorKey {
@@ -56,7 +67,9 @@ enum editorKey {
   HOME,               /* Homeキー */
   END,                /* Endキー */
   PAGE_UP,            /* PageUpキー */
-  PAGE_DOWN           /* PageDownキー */
+  PAGE_DOWN,          /* PageDownキー */
+  PASTE_START,        /* 貼り付け開始（bracketed paste） */
+  WAKEUP              /* 別スレッドからの起床通知（キー入力ではない） */
 };
 
 /* シンタックスハイライト種別 - テキストの色分け表示用 */
@@ -71,10 +84,25 @@ enum editorHighLight {
   HL_MATCH            /* 検索マッチ */
 };
 
+/* バイト走査カーネル種別 */
+enum scanKernel {
+  SCAN_KERNEL_SCALAR = 0,   /* スカラー版（memchr） */
+  SCAN_KERNEL_SSE2,         /* SSE2版 */
+  SCAN_KERNEL_AVX2          /* AVX2版 */
+};
+
+/* 画面セルの表示属性 */
+#define CELL_ATTR_INVERSE (1<<0)     /* 反転表示 */
+
 /* ハイライト機能フラグ */
 #define HL_HIGHLIGHT_NUMBERS (1<<0)  /* 数値のハイライト有効 */
 #define HL_HIGHLIGHT_STRINGS (1<<1)  /* 文字列のハイライト有効 */
 
+/* 行ハイライトの鮮度（erow.hl_dirty） */
+#define HL_ROW_CLEAN 0               /* コメント状態・ハイライト配列とも計算済み */
+#define HL_ROW_STALE 1               /* コメント状態のみ計算済み */
+#define HL_ROW_DIRTY 2               /* テキスト変更によりどちらも未計算 */
+
 /** データ構造 */
 
 /* シンタックスハイライト定義構造体 */
@@ -88,17 +116,53 @@ struct editorSyntax {
   int flags;                        /* ハイライト機能フラグ */
 };
 
+struct rowChunk;
+struct regex;
+
+/* cx⇔rx変換用チェックポイント - 行内の文字境界での文字位置と表示位置の組 */
+struct rowCheckpoint {
+  int cx;                   /* 文字位置（バイト） */
+  int rx;                   /* 表示位置 */
+};
+
 /* エディタ行構造体 - テキストの各行を表現 */
 typedef struct erow {
-  int idx;                  /* 行インデックス */
+  struct rowChunk *chunk;   /* 所属する行チャンク（行インデックスはここから計算） */
   int size;                 /* 文字数（バイト数） */
+  int cap;                  /* charsの確保サイズ */
+  int gap;                  /* 編集用ギャップの開始位置（-1ならギャップなしで連続） */
   int rsize;                /* 表示文字数 */
-  char *chars;              /* 実際の文字データ */
-  char *render;             /* 表示用文字データ（タブ展開済み） */
+  char *chars;              /* 実際の文字データ（ギャップがある間は途中に空きを含む） */
+  char *render;             /* 表示用文字データ（タブ展開済み、NULLなら未作成） */
+  struct rowCheckpoint *ckpt; /* cx⇔rx変換用チェックポイント（必要になった分だけ作成） */
+  int nckpt;                /* 計算済みのチェックポイント数 */
+  int ckptcap;              /* ckptの確保数 */
   unsigned char *hl;        /* ハイライト情報配列 */
-  int hl_open_comment;      /* 複数行コメント開始フラグ */
+  int hl_open_comment;      /* 複数行コメント開始フラグ（行末時点） */
+  int hl_prev_comment;      /* ハイライト計算時の前行のコメント状態 */
+  int hl_dirty;             /* ハイライトの鮮度（HL_ROW_*） */
+  unsigned int snap_gen;    /* charsを参照した最後のスナップショットの世代 */
+  unsigned int hl_gen;      /* ハイライト計算時のシンタックス世代 */
 } erow;
 
+/* 行チャンク構造体 - 行ロープ（暗黙treap）のノード、連続した行をまとめて保持 */
+struct rowChunk {
+  struct rowChunk *left;            /* 前方の部分木 */
+  struct rowChunk *right;           /* 後方の部分木 */
+  struct rowChunk *parent;          /* 親ノード */
+  unsigned int prio;                /* treap優先度 */
+  int count;                        /* 部分木の総行数 */
+  int n;                            /* このチャンクの行数 */
+  erow *rows;                       /* 行配列（容量cap）、未展開ならNULL */
+  int cap;                          /* rowsの確保数（ROW_CHUNK_MAX以下、行数に合わせて増減） */
+  const char *src;                  /* 未展開時の元データ（ファイルマッピング内） */
+  size_t srclen;                    /* 元データのバイト数 */
+  int hl_open_comment;              /* 未展開時の末尾行のコメント状態 */
+  int hl_in_comment;                /* 状態計算時の先頭行への入力コメント状態 */
+  unsigned int hl_gen;              /* 状態計算時のシンタックス世代 */
+  int hl_stale;                     /* 状態を再計算すべき行を含むかどうか */
+};
+
 /* エディタメイン設定構造体 - エディタの状態を管理 */
 struct editorConfig {
   int cx, cy;                       /* カーソル位置（文字単位） */
@@ -108,12 +172,21 @@ struct editorConfig {
   int screenrows;                   /* 画面行数 */
   int screencols;                   /* 画面列数 */
   int numrows;                      /* ファイル総行数 */
-  erow *row;                        /* 行データ配列 */
+  struct rowChunk *rowroot;         /* 行ロープの根 */
+  struct rowChunk *rowcache;        /* 直前に参照したチャンク */
+  int rowcache_start;               /* rowcacheの先頭行位置 */
+  char *map;                        /* 遅延読み込み中のファイルマッピング */
+  size_t mapsize;                   /* ファイルマッピングのサイズ */
+  int mapfd;                        /* マッピング元のファイル（保存時に未変更の範囲をコピーする） */
+  unsigned int snap_min;            /* 使用中で最も古いスナップショットの世代（なければ0） */
   int dirty;                        /* 変更フラグ */
+  mode_t umask;                     /* 新しく作るファイルに適用するumask（起動時に取得） */
   char *filename;                   /* ファイル名 */
   char statusmsg[80];               /* ステータスメッセージ */
   time_t statusmsg_time;            /* ステータスメッセージ表示時刻 */
   struct editorSyntax *syntax;      /* 使用中のシンタックスハイライト */
+  unsigned int hl_gen;              /* シンタックス世代（切り替えごとに増加） */
+  int hl_frontier;                  /* この行より前はコメント状態が確定済み */
   struct termios orig_termios;      /* 元のターミナル設定 */
 };
 
@@ -130,12 +203,27 @@ struct editorSettings {
   int color_string;                 /* 文字列の色 */
   int color_number;                 /* 数値の色 */
   int color_match;                  /* 検索マッチの色 */
+  int lazy_load;                    /* mmapによる遅延読み込みフラグ */
+  int scroll_region;                /* スクロール領域による画面スクロールフラグ */
+  int undo_limit;                   /* 元に戻す記録の上限（KB） */
+  int journal;                      /* 障害復旧用ジャーナルの記録フラグ */
+  int journal_ops;                  /* ジャーナルをまとめて書き込む操作数 */
+  int journal_delay;                /* 入力が止まってからジャーナルを書き込むまでの時間（ミリ秒） */
 };
 
 /* 追加バッファ構造体 - 効率的な文字列構築用 */
 struct abuf {
   char *b;                          /* バッファデータ */
   int len;                          /* データ長 */
+  int cap;                          /* 確保済みサイズ */
+};
+
+/* 画面セル構造体 - 画面上の1桁分の表示内容（8バイト、整数1つとして比較する） */
+struct screenCell {
+  char ch[4];                       /* UTF-8バイト列 */
+  unsigned char len;                /* バイト数（0なら直前の全角文字の右半分） */
+  unsigned char attr;               /* 表示属性（CELL_ATTR_*） */
+  short fg;                         /* 前景色（SGRコード） */
 };
 
 /** グローバル変数 */
@@ -150,6 +238,11 @@ void die(const char *s);
 void disableRawMode();
 void enableRawMode();
 int editorReadKey();
+int editorKeysPending();
+char *editorReadPaste(int *len);
+int editorWakeupInit();
+void editorWakeup();
+void editorWakeupDrain();
 int getCursorPosition(int *rows, int *cols);
 int getWindowSize(int *rows, int *cols);
 
@@ -161,6 +254,23 @@ int move_to_prev_char(char *str, int pos);
 int utf8_char_len(unsigned char c);
 int get_char_width(char *str, int pos);
 
+/** バイト走査関数 */
+
+int scanUseKernel(int kernel);
+int scanAutoKernel();
+const char *scanKernelName(int kernel);
+size_t scanLineEnds(const char *buf, size_t len, size_t *ends, size_t cap);
+const char *scanFind(const char *hay, size_t len, const char *needle, size_t nlen);
+
+/** 正規表現関数 */
+
+struct regex *regexCompile(const char *pattern, const char **err);
+void regexFree(struct regex *re);
+const char *regexPrefix(struct regex *re, int *len, int *literal);
+void regexSetCancel(struct regex *re, const int *cancel);
+int regexMatchLine(struct regex *re, const char *s, int n,
+                   void (*fn)(int start, int len, void *arg), void *arg);
+
 /** 設定関数 */
 
 void initDefaultConfig();
@@ -170,49 +280,109 @@ int loadConfig(const char *filename);
 
 int is_separator(int c);
 void editorUpdateSyntax(erow *row);
+void editorSyntaxInvalidate(int at);
+void editorSyntaxEnsure(int first, int last);
 int editorSyntaxToColor(int hl);
 void editorSelectSyntaxHighlight();
 
+/** 行ストレージ関数 */
+
+erow *editorRowAt(int at);
+int editorRowIndex(erow *row);
+erow *editorRowPrev(erow *row);
+erow *editorRowNext(erow *row);
+erow *ropePeekPrev(erow *row);
+erow *ropePeekNext(erow *row);
+struct rowChunk *ropeChunkAt(int at, int *start);
+struct rowChunk *ropeChunkPrev(struct rowChunk *c);
+void ropeAppendLazy(const char *src, size_t len, int n);
+erow *ropeInsertRow(int at);
+erow *ropeInsertRows(int at, int n);
+void ropeDeleteRow(int at);
+void editorFreeRows();
+
 /** 行操作関数 */
 
 int editorRowCxToRx(erow *row, int cx);
 int editorRowRxToCx(erow *row, int rx);
+void editorRenderRow(erow *row);
 void editorUpdateRow(erow *row);
+void editorRowEnsureRender(erow *row);
+void editorRowCompact(erow *row);
+char *editorRowText(erow *row);
+int editorRowPrevChar(erow *row, int at);
+int editorRowNextChar(erow *row, int at);
 void editorInsertRow(int at, char *s, size_t len);
+int editorInsertRows(int at, const char *s, size_t len);
+int editorReplaceRows(int at, int n, const char *s, size_t len);
 void editorFreeRow(erow *row);
 void editorDelRow(int at);
 void editorRowInsertChar(erow *row, int at, int c);
+void editorRowInsertString(erow *row, int at, const char *s, size_t len);
 void editorRowAppendString(erow *row, char *s, size_t len);
+void editorRowTruncate(erow *row, int at);
 void editorRowDelChar(erow *row, int at);
+void editorRowDelRange(erow *row, int from, int to);
+unsigned int editorSnapshotBegin();
+void editorSnapshotEnd(unsigned int gen);
 
 /** エディタ操作関数 */
 
 void editorInsertChar(int c);
 void editorInsertNewLine();
+void editorInsertText(const char *s, size_t len);
 void editorDelChar();
 
 /** ファイル入出力関数 */
 
-char *editorRowsToString(int *buflen);
+int editorWriteFile(const char *filename, size_t *written);
 void editorOpen(char *filename);
 void editorSave();
+void editorSaveCollect();
+void editorSaveWait();
+
+/** 元に戻す・やり直し関数 */
+
+void editorUndoRecord(int row, int col, const char *ins, size_t inslen, const char *del, size_t dellen);
+int editorUndo();
+int editorRedo();
+void editorUndoReset();
+unsigned long editorUndoState();
+unsigned long editorUndoMark();
+size_t editorUndoUsage();
+
+/** ジャーナル関数 */
+
+void editorJournalRecord(int row, int col, const char *ins, size_t inslen, const char *del, size_t dellen);
+void editorJournalRecover();
+void editorJournalMark();
+void editorJournalRebase();
+void editorJournalClose(int remove);
 
 /** 検索関数 */
 
 void editorFindCallback(char *query, int key);
 void editorFind();
+int editorFindMatchCount();
+void editorFindWait();
+const unsigned char *editorFindHighlight(int filerow, erow *row);
+int editorFindStatus(char *buf, int size);
 
 /** 追加バッファ関数 */
 
+int abReserve(struct abuf *ab, int len);
 void abAppend(struct abuf *ab, const char *s, int len);
+void abReset(struct abuf *ab);
 void abFree(struct abuf *ab);
 
 /** 出力関数 */
 
 void editorScroll();
-void editorDrawRows(struct abuf *ab);
-void editorDrawStatusBar(struct abuf *ab);
-void editorDrawMessageBar(struct abuf *ab);
+void editorDrawRows(struct screenCell *frame, int *lens);
+void editorDrawStatusBar(struct screenCell *cells, int *used);
+void editorDrawMessageBar(struct screenCell *cells, int *used);
+void editorScreenInvalidate();
+void editorRenderFrame(struct abuf *ab);
 void editorRefreshScreen();
 void editorSetStatusMessage(const char *fmt, ...);
 
@@ -149,9 +149,13 @@ void initEditor() {
   E.rowoff = 0;          // 行スクロールオフセット
   E.coloff = 0;          // 列スクロールオフセット
   E.numrows = 0;         // 総行数
-  E.row = NULL;          // 行データ配列
+  E.rowroot = NULL;      // 行ロープ
+  E.rowcache = NULL;     // 行チャンクキャッシュ
+  E.rowcache_start = 0;
   E.dirty = 0;           // 変更フラグ
   E.filename = NULL;     // ファイル名
+  E.umask = umask(0);    // umaskは取得と同時に変わるので戻す
+  umask(E.umask);
   E.statusmsg[0] = '\0'; // ステータスメッセージ
   E.statusmsg_time = 0;  // メッセージ表示時刻
   E.syntax = NULL;       // シンタックスハイライト設定
@@ -187,12 +191,15 @@ int main(int argc, char *argv[]) {
   }
 
   // ヘルプメッセージを表示
-  editorSetStatusMessage("HELP: Ctrl-s = save | Ctrl-q = quit | Ctrl-f = find");
+  editorSetStatusMessage("HELP: Ctrl-s = save | Ctrl-q = quit | Ctrl-f = find | Ctrl-z/y = undo/redo");
 
   // メインループ：画面更新とキー入力処理を繰り返す
+  // 届いているキーはまとめて処理してから1回だけ画面を更新する
   while (1) {
     editorRefreshScreen();
-    editorProcessKeypress();
+    do {
+      editorProcessKeypress();
+    } while (editorKeysPending());
   }
   
   return 0;
@@ -36,7 +36,7 @@ void editorScroll() {
     // 現在行のカーソル位置を表示位置に変換
     E.rx = E.cx;
     if (E.cy < E.numrows) {
-        E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+        E.rx = editorRowCxToRx(editorRowAt(E.cy), E.cx);
     }
     
     // 垂直スクロール処理
@@ -63,107 +63,233 @@ void editorScroll() {
     }
 }
 
+/* 画面の二重バッファ（front=最後に出力した画面、back=作成中の画面） */
+static struct screenCell *screenFront = NULL;
+static struct screenCell *screenBack = NULL;
+static int *screenFrontLen = NULL;  /* frontの各行で使用中の桁数（これ以降のセルは空白） */
+static int *screenBackLen = NULL;   /* backの各行で使用中の桁数 */
+static int screenRows = 0;          /* バッファの行数（テキスト行+ステータスバー+メッセージバー） */
+static int screenCols = 0;          /* バッファの列数 */
+static int screenValid = 0;         /* frontが端末の表示内容と一致しているか */
+static int screenRowoff = 0;        /* frontを描画した時の垂直スクロールオフセット */
+static int screenColoff = 0;        /* frontを描画した時の水平スクロールオフセット */
+
+/* 出力中の表示属性 */
+struct sgrState {
+    short fg;
+    unsigned char attr;
+};
+
+/**
+ * セルを空白（既定の属性）にする
+ */
+static void cellClear(struct screenCell *cell, unsigned char attr) {
+    cell->ch[0] = ' ';
+    cell->ch[1] = cell->ch[2] = cell->ch[3] = 0;
+    cell->len = 1;
+    cell->attr = attr;
+    cell->fg = 39;
+}
+
+/**
+ * n個のセルを空白にする
+ * 先頭のセルを倍々に複写して埋める
+ */
+static void cellFill(struct screenCell *cells, int n, unsigned char attr) {
+    if (n <= 0) return;
+    cellClear(&cells[0], attr);
+    for (int done = 1; done < n; done *= 2) {
+        memcpy(&cells[done], cells, sizeof(struct screenCell) * (done < n - done ? done : n - done));
+    }
+}
+
+/**
+ * セルが行末消去（\x1b[K）後と同じ状態かどうか
+ */
+static int cellIsBlank(const struct screenCell *cell) {
+    return cell->len == 1 && cell->ch[0] == ' ' && cell->attr == 0 && cell->fg == 39;
+}
+
+/**
+ * 行の描画を桁位置xで終える
+ * 前回の描画で使っていた区間の残りだけを空白にし、使用中の桁数を更新する
+ */
+static void cellEndRow(struct screenCell *cells, int x, int *len) {
+    if (x < *len) cellFill(&cells[x], *len - x, 0);
+    *len = x;
+}
+
+/* セルは8バイトで整数1つとして扱えること */
+typedef char screenCellSizeCheck[sizeof(struct screenCell) == sizeof(unsigned long long) ? 1 : -1];
+
+/**
+ * セルの内容を1つの整数として取得（まとめて比較するため）
+ */
+static unsigned long long cellBits(const struct screenCell *cell) {
+    unsigned long long bits;
+    memcpy(&bits, cell, sizeof(bits));
+    return bits;
+}
+
+/**
+ * 2つのセルの表示内容が同じかどうか
+ * chの未使用バイトは常に0なので構造体全体を比較できる
+ */
+static int cellEqual(const struct screenCell *a, const struct screenCell *b) {
+    return cellBits(a) == cellBits(b);
+}
+
+/**
+ * 行のセルに文字列を書き込む
+ * UTF-8文字は1セル、全角文字は2セル（右半分はlen=0）を使う
+ * 書き込み後の桁位置を返す
+ */
+static int cellPutText(struct screenCell *cells, int x, int cols, const char *s, int len,
+                       short fg, unsigned char attr) {
+    int i = 0;
+    while (i < len) {
+        int n = utf8_char_len((unsigned char)s[i]);
+        if (n > len - i) n = len - i;
+        int width = get_char_width((char *)s, i);
+        if (x + width > cols) break;
+
+        struct screenCell *cell = &cells[x];
+        memset(cell->ch, 0, sizeof(cell->ch));
+        memcpy(cell->ch, &s[i], n);
+        cell->len = n;
+        cell->attr = attr;
+        cell->fg = fg;
+        if (width == 2) {
+            cellClear(&cells[x + 1], attr);
+            cells[x + 1].len = 0;
+            cells[x + 1].fg = fg;
+        }
+        x += width;
+        i += n;
+    }
+    return x;
+}
+
+/* セルの整数値の中でch[0]が占めるビット位置（バイト順に依存するので実行時に求める） */
+static int cellCharShift = -1;
+
+/**
+ * cellCharShiftを求める
+ */
+static void cellInitShift() {
+    struct screenCell cell;
+    memset(&cell, 0, sizeof(cell));
+    cell.ch[0] = 1;
+    unsigned long long bits = cellBits(&cell);
+    for (cellCharShift = 0; !(bits & 1); bits >>= 1) cellCharShift++;
+}
+
 /**
  * テキスト行の描画
  * シンタックスハイライトとUTF-8文字を適切に処理
+ * frameのE.screenrows行分に画面内容を書き込み、lensに各行の使用桁数を記録する
+ * （lensは前回frameに描画した時の値で、その桁より右は空白であること）
  */
-void editorDrawRows(struct abuf *ab) {
+void editorDrawRows(struct screenCell *frame, int *lens) {
     int y;
+    int cols = E.screencols;
     int line_num_width = getLineNumberWidth();  // 行番号幅を計算
+
+    if (cellCharShift < 0) cellInitShift();
+
+    // 表示範囲の行だけハイライトを計算
+    editorSyntaxEnsure(E.rowoff, E.rowoff + E.screenrows);
     
     for (y = 0; y < E.screenrows; y++) {
         int filerow = y + E.rowoff;
+        struct screenCell *cells = &frame[y * cols];
         
         if (filerow >= E.numrows) {
+            cellFill(cells, lens[y], 0);
             // 行番号表示が有効な場合はスペースを確保
-            if (line_num_width > 0) {
-                for (int i = 0; i < line_num_width; i++) {
-                    abAppend(ab, " ", 1);
-                }
-            }
+            int x = line_num_width < cols ? line_num_width : cols;
             
             // ファイル末尾を超えた行の処理
             if (E.numrows == 0 && y == E.screenrows / 3) {
                 // 空ファイルの場合はウェルカムメッセージを表示
                 char welcome[80];
                 int welcomelen = snprintf(welcome, sizeof(welcome), "%s", Config.welcome_message);
-                if (welcomelen > E.screencols) welcomelen = E.screencols;
+                if (welcomelen > (int)sizeof(welcome) - 1) welcomelen = sizeof(welcome) - 1;
+                if (welcomelen > cols) welcomelen = cols;
                 
                 // 画面中央に配置
-                int padding = (E.screencols - welcomelen) / 2;
-                if (padding) {
-                    abAppend(ab, "~", 1);
-                    padding--;
-                }
-                while (padding--) abAppend(ab, " ", 1);
-                abAppend(ab, welcome, welcomelen);
+                int padding = (cols - welcomelen) / 2;
+                if (padding) x = cellPutText(cells, x, cols, "~", 1, 39, 0);
+                x += padding ? padding - 1 : 0;
+                x = cellPutText(cells, x, cols, welcome, welcomelen, 39, 0);
             } else {
                 // 通常は各行にチルダを表示
-                abAppend(ab, "~", 1);
+                x = cellPutText(cells, x, cols, "~", 1, 39, 0);
             }
-        } else {
-            // 行番号を表示
-            if (line_num_width > 0) {
-                char line_num[16];
-                int num_len = snprintf(line_num, sizeof(line_num), "%*d ", 
-                                     line_num_width - 1, filerow + 1);
-                abAppend(ab, line_num, num_len);
+            lens[y] = x;
+            continue;
+        }
+
+        int x = 0;
+        // 行番号を表示
+        if (line_num_width > 0) {
+            char line_num[16];
+            int num_len = snprintf(line_num, sizeof(line_num), "%*d ", 
+                                 line_num_width - 1, filerow + 1);
+            x = cellPutText(cells, x, cols, line_num, num_len, 39, 0);
+        }
+        
+        // 実際のテキスト行の描画
+        erow *row = editorRowAt(filerow);
+        editorRowEnsureRender(row);
+        const char *render = row->render;
+        const unsigned char *hls = editorFindHighlight(filerow, row);
+        int rsize = row->rsize;
+        
+        // 同じハイライトが続く区間ごとに描画
+        int j = E.coloff;
+        while (j < rsize && x < cols) {
+            unsigned char hl = hls[j];
+            short color = hl == HL_NORMAL ? 39 : editorSyntaxToColor(hl);
+
+            // 表示可能なASCII文字の区間は1バイト1セルで直接書き込む
+            // （文字以外が同じセルの整数値に文字コードを重ねて作る）
+            struct screenCell cell;
+            cellClear(&cell, 0);
+            cell.ch[0] = 0;
+            cell.fg = color;
+            unsigned long long base = cellBits(&cell);
+            int end = j + (cols - x);
+            if (end > rsize) end = rsize;
+            while (j < end && hls[j] == hl &&
+                   (unsigned char)render[j] >= 0x20 && (unsigned char)render[j] < 0x7f) {
+                unsigned long long bits = base | ((unsigned long long)(unsigned char)render[j++] << cellCharShift);
+                memcpy(&cells[x++], &bits, sizeof(bits));
             }
-            
-            // 実際のテキスト行の描画
-            int len = E.row[filerow].rsize - E.coloff;
-            if (len < 0) len = 0;
-            // テキスト表示領域を行番号分だけ狭める
-            int text_cols = E.screencols - line_num_width;
-            if (len > text_cols) len = text_cols;
-            
-            char *c = &E.row[filerow].render[E.coloff];
-            unsigned char *hl = &E.row[filerow].hl[E.coloff];
-            int current_color = -1;
-            
-            // 1文字ずつ描画（色付きで）
-            for (int j = 0; j < len; j++) {
-                // UTF-8制御文字チェック（0x80以上は制御文字でない）
-                if ((unsigned char)c[j] < 0x80 && iscntrl(c[j])) {
-                    // 制御文字の場合は反転表示
-                    char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-                    abAppend(ab, "\x1b[7m", 4);    // 反転開始
-                    abAppend(ab, &sym, 1);
-                    abAppend(ab, "\x1b[m", 3);     // リセット
-                    
-                    // 色が設定されている場合は復元
-                    if (current_color != -1) {
-                        char buf[16];
-                        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
-                        abAppend(ab, buf, clen);
-                    }
-                } else if (hl[j] == HL_NORMAL) {
-                    // 通常文字の場合
-                    if (current_color != -1) {
-                        abAppend(ab, "\x1b[39m", 5);  // デフォルト色にリセット
-                        current_color = -1;
-                    }
-                    abAppend(ab, &c[j], 1);
-                } else {
-                    // ハイライト文字の場合
-                    int color = editorSyntaxToColor(hl[j]);
-                    if (color != current_color) {
-                        // 色が変わった場合のみ色変更コマンドを送信
-                        current_color = color;
-                        char buf[16];
-                        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-                        abAppend(ab, buf, clen);
-                    }
-                    abAppend(ab, &c[j], 1);
-                }
+            if (j >= rsize || x >= cols) break;
+            if (hls[j] != hl) continue;
+
+            const char *c = &render[j];
+            // 残りのASCIIは制御文字（0x80以上は制御文字でない）
+            if ((unsigned char)*c < 0x80) {
+                // 制御文字の場合は反転表示
+                char sym = (*c <= 26) ? '@' + *c : '?';
+                x = cellPutText(cells, x, cols, &sym, 1, color, CELL_ATTR_INVERSE);
+                j++;
+                continue;
             }
-            // 行末で色をリセット
-            abAppend(ab, "\x1b[39m", 5);
+
+            // マルチバイト文字
+            int n = utf8_char_len((unsigned char)*c);
+            if (n > rsize - j) n = rsize - j;
+            int nx = cellPutText(cells, x, cols, c, n, color, 0);
+            if (nx == x) break;  // 全角文字が右端に収まらない
+            x = nx;
+            j += n;
         }
-        
-        // 行末クリアと改行
-        abAppend(ab, "\x1b[K", 3);  // 行末まで削除
-        abAppend(ab, "\r\n", 2);    // 改行
+
+        // 前回より短くなった分を空白にする
+        cellEndRow(cells, x, &lens[y]);
     }
 }
 
@@ -171,8 +297,11 @@ void editorDrawRows(struct abuf *ab) {
  * ステータスバーの描画
  * ファイル名、行数、変更状態、カーソル位置等を表示
  */
-void editorDrawStatusBar(struct abuf *ab) {
-    abAppend(ab, "\x1b[7m", 4);  // 反転表示開始
+void editorDrawStatusBar(struct screenCell *cells, int *used) {
+    int cols = E.screencols;
+    // 行全体を反転表示
+    cellFill(cells, cols, CELL_ATTR_INVERSE);
+    *used = cols;
     
     char status[80];   // 左側のステータス情報
     char rstatus[80];  // 右側のステータス情報
@@ -183,78 +312,307 @@ void editorDrawStatusBar(struct abuf *ab) {
         E.numrows, 
         E.dirty ? "(modified)" : "");
     
-    // 右側：ファイルタイプと現在位置
-    int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d/%d", 
+    // 右側：検索中のマッチ数、ファイルタイプと現在位置
+    char matches[32];
+    int mlen = editorFindStatus(matches, sizeof(matches));
+    int rlen = snprintf(rstatus, sizeof(rstatus), "%s%s%s | %d/%d", 
+        matches, mlen ? " | " : "",
         E.syntax ? E.syntax->filetype : "no ft", 
         E.cy + 1, E.numrows);
+    if (rlen >= (int)sizeof(rstatus)) rlen = sizeof(rstatus) - 1;
     
-    if (len > E.screencols) len = E.screencols;
-    abAppend(ab, status, len);
+    if (len > cols) len = cols;
+    cellPutText(cells, 0, cols, status, len, 39, CELL_ATTR_INVERSE);
     
-    // 左右のステータスの間を埋める
-    while (len < E.screencols) {
-        if (E.screencols - len == rlen) {
-            abAppend(ab, rstatus, rlen);
-            break;
-        } else {
-            abAppend(ab, " ", 1);
-            len++;
-        }
+    // 右側のステータスは右端に揃え、左側と重なる場合は表示しない
+    if (len <= cols - rlen) {
+        cellPutText(cells, cols - rlen, cols, rstatus, rlen, 39, CELL_ATTR_INVERSE);
     }
-    
-    abAppend(ab, "\x1b[m", 3);   // 反転表示終了
-    abAppend(ab, "\r\n", 2);     // 改行
 }
 
 /**
  * メッセージバーの描画
  * 一時的なメッセージを表示（設定された時間後に消える）
  */
-void editorDrawMessageBar(struct abuf *ab) {
-    abAppend(ab, "\x1b[K", 3);   // 行クリア
+void editorDrawMessageBar(struct screenCell *cells, int *used) {
+    int cols = E.screencols;
+    int x = 0;
     
     int msglen = strlen(E.statusmsg);
-    if (msglen > E.screencols) msglen = E.screencols;
+    if (msglen > cols) msglen = cols;
     
     // メッセージが設定されており、タイムアウト内の場合のみ表示
     if (msglen && time(NULL) - E.statusmsg_time < Config.status_timeout) {
-        abAppend(ab, E.statusmsg, msglen);
+        x = cellPutText(cells, 0, cols, E.statusmsg, msglen, 39, 0);
     }
+    cellEndRow(cells, x, used);
 }
 
 /**
- * 画面全体の更新
- * 全てのコンポーネントを描画してターミナルに出力
+ * 次回の画面更新で全体を再描画させる
+ * 端末の表示内容が不明になった場合（画面クリア後など）に呼ぶ
  */
-void editorRefreshScreen() {
+void editorScreenInvalidate() {
+    screenValid = 0;
+}
+
+/* 表示属性ごとのSGRシーケンス表（前景色×反転、最初に使われた時に作成） */
+#define SGR_FG_MAX 128
+static struct {
+    char seq[16];
+    unsigned char len;
+} sgrTable[2][SGR_FG_MAX];
+
+/**
+ * 表示属性に対応するSGRシーケンスを取得
+ * 同じ属性のシーケンスは表から取り出すので書式化は最初の1回だけ
+ */
+static const char *screenAttrSeq(short fg, unsigned char attr, int *len) {
+    static char buf[32];
+    int inverse = (attr & CELL_ATTR_INVERSE) ? 1 : 0;
+    int cached = fg >= 0 && fg < SGR_FG_MAX;
+
+    if (cached && sgrTable[inverse][fg].len) {
+        *len = sgrTable[inverse][fg].len;
+        return sgrTable[inverse][fg].seq;
+    }
+
+    int n = snprintf(buf, sizeof(buf), "\x1b[0%s", inverse ? ";7" : "");
+    if (fg != 39) n += snprintf(buf + n, sizeof(buf) - n, ";%d", fg);
+    buf[n++] = 'm';
+    if (cached) {
+        memcpy(sgrTable[inverse][fg].seq, buf, n);
+        sgrTable[inverse][fg].len = n;
+    }
+    *len = n;
+    return buf;
+}
+
+/**
+ * 表示属性を切り替えるエスケープシーケンスを出力
+ */
+static void screenSetAttr(struct abuf *ab, struct sgrState *st, short fg, unsigned char attr) {
+    if (st->fg == fg && st->attr == attr) return;
+    st->fg = fg;
+    st->attr = attr;
+
+    int len;
+    const char *seq = screenAttrSeq(fg, attr, &len);
+    abAppend(ab, seq, len);
+}
+
+/**
+ * 画面1行分の差分を出力
+ * 前回と異なる区間だけをカーソル移動付きで書き、行末の空白は行末消去で済ませる
+ */
+static void screenDiffRow(struct abuf *ab, struct sgrState *st, int y) {
+    int cols = screenCols;
+    struct screenCell *old = &screenFront[y * cols];
+    struct screenCell *new = &screenBack[y * cols];
+    int newlen = screenBackLen[y];
+
+    // どちらかで使用中の桁より右は両方とも空白
+    int used = screenFrontLen[y] > newlen ? screenFrontLen[y] : newlen;
+    int first = 0;
+    while (first < used && cellEqual(&old[first], &new[first])) first++;
+    if (first == used) return;
+    int last = used - 1;
+    while (last > first && cellEqual(&old[last], &new[last])) last--;
+
+    // 全角文字の途中で区切らない
+    while (first > 0 && (new[first].len == 0 || old[first].len == 0)) first--;
+    while (last + 1 < cols && (new[last + 1].len == 0 || old[last + 1].len == 0)) last++;
+
+    // 区間が行末の空白にかかる場合は行末消去を使う
+    int tail = newlen;
+    while (tail > first && cellIsBlank(&new[tail - 1])) tail--;
+    int clear = 0;
+    if (last >= tail) {
+        last = tail - 1;
+        clear = 1;
+    }
+
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, first + 1);
+    abAppend(ab, buf, len);
+
+    // 行の最大出力量（全セルで属性が変わる場合）を一度に確保して直接書き込む
+    if (abReserve(ab, (last - first + 1) * (4 + sizeof(sgrTable[0][0].seq))) == -1) return;
+    char *out = &ab->b[ab->len];
+    short cur_fg = st->fg;
+    unsigned char cur_attr = st->attr;
+
+    // 現在の属性のASCII文字と、反転なしの空白はセル全体の比較1回で判定する
+    struct screenCell tmpl;
+    memset(&tmpl, 0xff, sizeof(tmpl));
+    tmpl.ch[0] = 0;
+    unsigned long long same_mask = cellBits(&tmpl);
+    tmpl.ch[0] = (char)0xff;
+    tmpl.fg = 0;
+    unsigned long long space_mask = cellBits(&tmpl);
+    cellClear(&tmpl, 0);
+    tmpl.fg = 0;
+    unsigned long long space_key = cellBits(&tmpl);
+    tmpl.ch[0] = 0;
+    tmpl.attr = cur_attr;
+    tmpl.fg = cur_fg;
+    unsigned long long same_key = cellBits(&tmpl);
+
+    for (int x = first; x <= last; x++) {
+        unsigned long long bits = cellBits(&new[x]);
+        if ((bits & same_mask) == same_key ||
+            (cur_attr == 0 && (bits & space_mask) == space_key)) {
+            *out++ = new[x].ch[0];
+            continue;
+        }
+
+        struct screenCell cell = new[x];
+        if (cell.len == 0) continue;
+
+        if (cell.fg != cur_fg || cell.attr != cur_attr) {
+            int seqlen;
+            const char *seq = screenAttrSeq(cell.fg, cell.attr, &seqlen);
+            memcpy(out, seq, seqlen);
+            out += seqlen;
+            cur_fg = cell.fg;
+            cur_attr = cell.attr;
+            tmpl.attr = cur_attr;
+            tmpl.fg = cur_fg;
+            same_key = cellBits(&tmpl);
+        }
+
+        memcpy(out, cell.ch, cell.len);
+        out += cell.len;
+    }
+    ab->len = out - ab->b;
+    st->fg = cur_fg;
+    st->attr = cur_attr;
+    if (clear) {
+        screenSetAttr(ab, st, 39, 0);
+        abAppend(ab, "\x1b[K", 3);
+    }
+}
+
+/**
+ * 垂直スクロールを端末のスクロール領域で行う
+ * テキスト行の範囲だけをd行（正なら上方向）ずらし、frontも同じだけずらす
+ */
+static void screenScroll(struct abuf *ab, int d) {
+    int rows = E.screenrows;
+    int cols = screenCols;
+    int n = d > 0 ? d : -d;
+    char buf[32];
+
+    int len = snprintf(buf, sizeof(buf), "\x1b[1;%dr\x1b[%d%c\x1b[r", rows, n, d > 0 ? 'S' : 'T');
+    abAppend(ab, buf, len);
+
+    if (d > 0) {
+        memmove(screenFront, &screenFront[n * cols], sizeof(struct screenCell) * (rows - n) * cols);
+        memmove(screenFrontLen, &screenFrontLen[n], sizeof(int) * (rows - n));
+        cellFill(&screenFront[(rows - n) * cols], n * cols, 0);
+        memset(&screenFrontLen[rows - n], 0, sizeof(int) * n);
+    } else {
+        memmove(&screenFront[n * cols], screenFront, sizeof(struct screenCell) * (rows - n) * cols);
+        memmove(&screenFrontLen[n], screenFrontLen, sizeof(int) * (rows - n));
+        cellFill(screenFront, n * cols, 0);
+        memset(screenFrontLen, 0, sizeof(int) * n);
+    }
+}
+
+/**
+ * 画面更新の出力内容を作成
+ * 新しい画面をbackに描画し、前回出力したfrontとの差分だけをabに追加する
+ */
+void editorRenderFrame(struct abuf *ab) {
     editorScroll();  // スクロール処理
 
-    struct abuf ab = ABUF_INIT;
+    int rows = E.screenrows + 2;
+    int cols = E.screencols;
+    if (rows != screenRows || cols != screenCols) {
+        // 画面サイズが変わった場合はバッファを作り直す
+        free(screenFront);
+        free(screenBack);
+        free(screenFrontLen);
+        free(screenBackLen);
+        screenFront = malloc(sizeof(struct screenCell) * rows * cols);
+        screenBack = malloc(sizeof(struct screenCell) * rows * cols);
+        screenFrontLen = calloc(rows, sizeof(int));
+        screenBackLen = calloc(rows, sizeof(int));
+        cellFill(screenBack, rows * cols, 0);
+        screenRows = rows;
+        screenCols = cols;
+        screenValid = 0;
+    }
 
     // カーソル非表示
-    abAppend(&ab, "\x1b[?25l", 6);
-    // カーソルをホーム位置に移動
-    abAppend(&ab, "\x1b[H", 3);
+    abAppend(ab, "\x1b[?25l", 6);
+    // 表示属性を既定に戻す（以降は変化した時だけ出力）
+    struct sgrState st = {39, 0};
+
+    if (!screenValid) {
+        // 全体を再描画：画面をクリアして空白の画面との差分を出力
+        abAppend(ab, "\x1b[m\x1b[2J", 7);
+        cellFill(screenFront, rows * cols, 0);
+        memset(screenFrontLen, 0, sizeof(int) * rows);
+        screenValid = 1;
+    } else {
+        abAppend(ab, "\x1b[m", 3);
+        int d = E.rowoff - screenRowoff;
+        if (Config.scroll_region && d != 0 && d < E.screenrows && -d < E.screenrows &&
+            E.coloff == screenColoff) {
+            screenScroll(ab, d);
+        }
+    }
 
     // 各コンポーネントの描画
-    editorDrawRows(&ab);
-    editorDrawStatusBar(&ab);
-    editorDrawMessageBar(&ab);
+    editorDrawRows(screenBack, screenBackLen);
+    editorDrawStatusBar(&screenBack[E.screenrows * cols], &screenBackLen[E.screenrows]);
+    editorDrawMessageBar(&screenBack[(E.screenrows + 1) * cols], &screenBackLen[E.screenrows + 1]);
+
+    // 変化した行だけを出力
+    for (int y = 0; y < rows; y++) screenDiffRow(ab, &st, y);
+    screenSetAttr(ab, &st, 39, 0);
 
     // カーソルを正しい位置に移動（行番号幅を考慮）
     int line_num_width = getLineNumberWidth();
     char buf[32];
-    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", 
+    int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", 
         E.cy - E.rowoff + 1, 
         E.rx - E.coloff + 1 + line_num_width);  // 行番号幅分右にシフト
-    abAppend(&ab, buf, strlen(buf));
+    abAppend(ab, buf, len);
 
     // カーソル表示
-    abAppend(&ab, "\x1b[?25h", 6);
+    abAppend(ab, "\x1b[?25h", 6);
+
+    // 出力した画面をfrontにする
+    struct screenCell *tmp = screenFront;
+    screenFront = screenBack;
+    screenBack = tmp;
+    int *tmplen = screenFrontLen;
+    screenFrontLen = screenBackLen;
+    screenBackLen = tmplen;
+    screenRowoff = E.rowoff;
+    screenColoff = E.coloff;
+}
+
+/**
+ * 画面全体の更新
+ * 前回からの差分をターミナルに出力
+ */
+void editorRefreshScreen() {
+    // 出力バッファは容量を保ったまま使い回す
+    static struct abuf ab = ABUF_INIT;
+    abReset(&ab);
+
+    // バックグラウンド保存が終わっていれば結果をステータスメッセージに反映
+    editorSaveCollect();
+
+    editorRenderFrame(&ab);
 
     // バッファの内容を一度にターミナルに出力
-    write(STDOUT_FILENO, ab.b, ab.len);
-    abFree(&ab);
+    // 書ききれなかった場合は画面と一致しないので次回は全体を描き直す
+    if (write(STDOUT_FILENO, ab.b, ab.len) != ab.len)
+        editorScreenInvalidate();
 }
 
 /**
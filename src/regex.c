@@ -0,0 +1,900 @@
+/**
+ * regex.c - 正規表現エンジン
+ *
+ * 検索用の正規表現をバックトラックなしで照合する：
+ * - パターンを構文木に解析し、Thompson構成でNFAに変換（コンパイルは1回だけ）
+ * - NFAは遅延構築のDFAとして実行（状態は初めて通る時に作り、上限を超えたら作り直す）
+ * - 行内のマッチ開始位置は後ろ向きのDFAで1回走査して求め、
+ *   各マッチの終端は前向きのDFAで最長一致を求める
+ *   （前向きの走査は（位置, 状態）ごとに結果を覚え、以前の走査と合流したらそこで打ち切るので、
+ *   行全体でも各位置を状態数回までしか読まない）
+ * - パターンの先頭の固定文字列を取り出し、scanFindによる候補の絞り込みに使えるようにする
+ *
+ * 対応する構文: . [...] [^...] \d \w \s \D \W \S ^ $ | (...) * + ? {m} {m,} {m,n}
+ * UTF-8の文字はバイト列として扱い、. と文字クラスは1文字単位で一致する
+ * （否定の文字クラスに書いたASCII以外の文字は除外されない）
+ *
+ * エディタ状態（E）には依存しないので単体でテスト可能
+ */
+
+#include "kiloe.h"
+
+#define RX_MAX_NODES 20000          /* NFAのノード数の上限 */
+#define RX_MAX_REPEAT 1000          /* {m,n}の回数の上限 */
+#define RX_MAX_STATES 2048          /* キャッシュするDFA状態数の上限 */
+#define RX_HASH_SIZE 4096           /* DFA状態のハッシュ表の大きさ（2のべき乗） */
+#define RX_PREFIX_MAX 64            /* 取り出す先頭の固定文字列の最大長 */
+#define RX_MEMO_MIN 1024            /* 前向きの走査結果の表の最小の大きさ（2のべき乗） */
+#define RX_CANCEL_SLICE (1 << 16)   /* 中断要求を確認する間隔（バイト、2のべき乗） */
+
+/* 構文木のノード種別 */
+enum rxAstType {
+    RXA_SET,        /* バイト集合のどれか1バイト */
+    RXA_CAT,        /* 連接 */
+    RXA_ALT,        /* 選択 */
+    RXA_REP,        /* 繰り返し */
+    RXA_BOL,        /* 行頭 */
+    RXA_EOL,        /* 行末 */
+    RXA_EMPTY       /* 空文字列 */
+};
+
+/* 構文木のノード */
+struct rxAst {
+    int type;
+    struct rxAst *a, *b;            /* 子（RXA_REPはaのみ） */
+    int min, max;                   /* 繰り返し回数（maxが-1なら上限なし） */
+    unsigned char set[32];          /* RXA_SETのバイト集合（256ビット） */
+};
+
+/* NFAのノード種別 */
+enum rxOp {
+    RXO_BYTE,       /* 集合内のバイトを読んでoutへ */
+    RXO_SPLIT,      /* outとout1の両方へ（空遷移） */
+    RXO_BOL,        /* 走査の先頭でのみoutへ */
+    RXO_EOL,        /* 走査の末尾でのみoutへ */
+    RXO_MATCH       /* 受理 */
+};
+
+/* NFAのノード */
+struct rxNode {
+    unsigned char op;
+    int out, out1;
+    unsigned char set[32];
+};
+
+/* DFA状態 - 空遷移で閉じたNFAノードの集合 */
+struct rxState {
+    int *nodes;                     /* NFAノード（昇順） */
+    int n;
+    int begin;                      /* 走査の先頭の状態かどうか */
+    int match;                      /* この位置で受理 */
+    int matchEnd;                   /* 走査の末尾ならこの位置で受理 */
+    struct rxState *next[256];      /* 遷移先（未計算ならNULL） */
+    struct rxState *chain;          /* ハッシュ表の同じ枠の次の状態 */
+};
+
+/* 遅延構築のDFA */
+struct rxDfa {
+    struct rxNode *nodes;           /* NFA */
+    int nnodes;
+    int start;                      /* NFAの開始ノード */
+    int unanchored;                 /* 毎位置で開始ノードから始め直すかどうか */
+    struct rxState *table[RX_HASH_SIZE];
+    int nstates;
+    unsigned int flushes;           /* キャッシュを捨てた回数 */
+    struct rxState *init[2];        /* 開始状態（走査の先頭かどうか別） */
+    int *stack;                     /* 空遷移の探索用 */
+    int *list;                      /* 状態を作る時の作業領域 */
+    unsigned int *seen;             /* 探索済みの印（世代番号） */
+    unsigned int gen;
+};
+
+/* 前向きの走査結果 - 位置posで状態stにいる走査が、pos以降で受理する最後の位置 */
+struct rxMemo {
+    int pos;
+    struct rxState *st;
+    int best;                       /* 受理しなければ-1 */
+    unsigned int gen;               /* 記録した行の世代（re->memogenと違えば空き） */
+};
+
+/* コンパイル済みの正規表現 */
+struct regex {
+    struct rxDfa fwd;               /* 前向き・位置固定（マッチの終端を求める） */
+    struct rxDfa rev;               /* 後ろ向き・位置非固定（マッチの開始位置を求める） */
+    char prefix[RX_PREFIX_MAX];     /* 全マッチに共通の先頭の固定文字列 */
+    int prefixlen;
+    int literal;                    /* パターン全体が固定文字列かどうか */
+    unsigned char *starts;          /* 行内の各位置からマッチが始まるかの印（作業領域） */
+    int startscap;
+    struct rxMemo *memo;            /* 前向きの走査結果の表（開番地法） */
+    int memocap;
+    int memon;
+    unsigned int memogen;           /* 行ごと・DFAのキャッシュを捨てるごとに増やす */
+    unsigned int memoflushes;       /* 表を作った時点の前向きのDFAのキャッシュ破棄回数 */
+    struct rxState **path;          /* 走査中に通った状態（作業領域） */
+    int pathcap;
+    const int *cancel;              /* 中断要求（0以外で照合を打ち切る。NULLなら確認しない） */
+};
+
+/** 構文木 */
+
+static struct rxAst *rxNew(int type, struct rxAst *a, struct rxAst *b) {
+    struct rxAst *t = calloc(1, sizeof(struct rxAst));
+    t->type = type;
+    t->a = a;
+    t->b = b;
+    return t;
+}
+
+static void rxAstFree(struct rxAst *t) {
+    if (!t) return;
+    rxAstFree(t->a);
+    rxAstFree(t->b);
+    free(t);
+}
+
+static void rxSetAdd(unsigned char *set, int lo, int hi) {
+    for (int c = lo; c <= hi; c++) set[c >> 3] |= 1 << (c & 7);
+}
+
+static int rxSetHas(const unsigned char *set, int c) {
+    return set[c >> 3] & (1 << (c & 7));
+}
+
+static struct rxAst *rxRange(int lo, int hi) {
+    struct rxAst *t = rxNew(RXA_SET, NULL, NULL);
+    rxSetAdd(t->set, lo, hi);
+    return t;
+}
+
+/**
+ * ASCII以外のUTF-8の1文字（先頭バイトと継続バイトの並び）
+ */
+static struct rxAst *rxAnyMultibyte() {
+    struct rxAst *two = rxNew(RXA_CAT, rxRange(0xc2, 0xdf), rxRange(0x80, 0xbf));
+    struct rxAst *three = rxNew(RXA_CAT, rxNew(RXA_CAT, rxRange(0xe0, 0xef), rxRange(0x80, 0xbf)),
+                                rxRange(0x80, 0xbf));
+    struct rxAst *four = rxNew(RXA_CAT, rxNew(RXA_CAT, rxNew(RXA_CAT, rxRange(0xf0, 0xf4),
+                                                             rxRange(0x80, 0xbf)),
+                                              rxRange(0x80, 0xbf)),
+                               rxRange(0x80, 0xbf));
+    return rxNew(RXA_ALT, two, rxNew(RXA_ALT, three, four));
+}
+
+/**
+ * ASCII部分のバイト集合と、ASCII以外の任意の1文字の選択
+ * UTF-8として不正な先頭バイトは単独の1文字として扱う
+ */
+static struct rxAst *rxWithMultibyte(struct rxAst *ascii) {
+    rxSetAdd(ascii->set, 0xc0, 0xc1);
+    rxSetAdd(ascii->set, 0xf5, 0xff);
+    return rxNew(RXA_ALT, ascii, rxAnyMultibyte());
+}
+
+/**
+ * \d \w \s に対応するASCIIのバイト集合を追加（該当しなければ0を返す）
+ */
+static int rxClassEscape(unsigned char *set, int c) {
+    switch (c) {
+        case 'd':
+            rxSetAdd(set, '0', '9');
+            return 1;
+        case 'w':
+            rxSetAdd(set, '0', '9');
+            rxSetAdd(set, 'A', 'Z');
+            rxSetAdd(set, 'a', 'z');
+            rxSetAdd(set, '_', '_');
+            return 1;
+        case 's':
+            rxSetAdd(set, ' ', ' ');
+            rxSetAdd(set, '\t', '\r');
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * エスケープされた1文字の値（\t \n \r 以外は文字そのもの）
+ */
+static int rxEscapeChar(int c) {
+    switch (c) {
+        case 't': return '\t';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+    }
+    return c;
+}
+
+/* 構文解析の状態 */
+struct rxParser {
+    const char *p;
+    const char *err;
+};
+
+static struct rxAst *rxParseAlt(struct rxParser *ps);
+
+/**
+ * UTF-8の1文字をバイトの連接として読む
+ */
+static struct rxAst *rxParseChar(struct rxParser *ps) {
+    int n = utf8_char_len((unsigned char)*ps->p);
+    struct rxAst *t = rxRange((unsigned char)ps->p[0], (unsigned char)ps->p[0]);
+    for (int i = 1; i < n && ps->p[i]; i++) {
+        t = rxNew(RXA_CAT, t, rxRange((unsigned char)ps->p[i], (unsigned char)ps->p[i]));
+    }
+    while (n-- > 0 && *ps->p) ps->p++;
+    return t;
+}
+
+/**
+ * 文字クラス [...] を読む（先頭の[は読み込み済み）
+ * ASCIIはバイト集合に、ASCII以外の文字はバイト列の選択にまとめる
+ */
+static struct rxAst *rxParseClass(struct rxParser *ps) {
+    struct rxAst *ascii = rxNew(RXA_SET, NULL, NULL);
+    struct rxAst *multi = NULL;
+    int negate = 0;
+
+    if (*ps->p == '^') {
+        negate = 1;
+        ps->p++;
+    }
+    int first = 1;
+    while (*ps->p && (*ps->p != ']' || first)) {
+        first = 0;
+        int c = (unsigned char)*ps->p;
+        if (c == '\\' && ps->p[1]) {
+            int e = ps->p[1];
+            ps->p += 2;
+            if (rxClassEscape(ascii->set, e)) continue;
+            if (e == 'D' || e == 'W' || e == 'S') {
+                unsigned char tmp[32] = {0};
+                rxClassEscape(tmp, e - 'A' + 'a');
+                for (int b = 0; b < 0x80; b++) if (!rxSetHas(tmp, b)) rxSetAdd(ascii->set, b, b);
+                continue;
+            }
+            c = rxEscapeChar(e);
+        } else if (c >= 0x80) {
+            struct rxAst *ch = rxParseChar(ps);
+            multi = multi ? rxNew(RXA_ALT, multi, ch) : ch;
+            continue;
+        } else {
+            ps->p++;
+        }
+
+        // 範囲指定（ASCIIのみ）
+        if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+            int hi = (unsigned char)ps->p[1];
+            ps->p += 2;
+            if (hi == '\\' && *ps->p) hi = rxEscapeChar(*ps->p++);
+            if (hi >= 0x80 || hi < c) {
+                ps->err = "bad range in []";
+                break;
+            }
+            rxSetAdd(ascii->set, c, hi);
+        } else {
+            rxSetAdd(ascii->set, c, c);
+        }
+    }
+    if (!ps->err && *ps->p != ']') ps->err = "missing ]";
+    if (ps->err) {
+        rxAstFree(ascii);
+        rxAstFree(multi);
+        return NULL;
+    }
+    ps->p++;
+
+    if (negate) {
+        for (int b = 0; b < 32; b++) ascii->set[b] = ~ascii->set[b];
+        memset(&ascii->set[16], 0, 16);
+        rxAstFree(multi);
+        return rxWithMultibyte(ascii);
+    }
+    return multi ? rxNew(RXA_ALT, ascii, multi) : ascii;
+}
+
+/**
+ * 繰り返し回数 {m} {m,} {m,n} を読む（先頭の{は読み込み済み）
+ */
+static int rxParseCount(struct rxParser *ps, int *min, int *max) {
+    if (!isdigit((unsigned char)*ps->p)) return -1;
+    *min = strtol(ps->p, (char **)&ps->p, 10);
+    *max = *min;
+    if (*ps->p == ',') {
+        ps->p++;
+        *max = isdigit((unsigned char)*ps->p) ? (int)strtol(ps->p, (char **)&ps->p, 10) : -1;
+    }
+    if (*ps->p != '}') return -1;
+    ps->p++;
+    if (*min > RX_MAX_REPEAT || *max > RX_MAX_REPEAT || (*max != -1 && *max < *min)) return -1;
+    return 0;
+}
+
+/**
+ * 1つの要素（文字・クラス・グループ・アンカー）を読む
+ */
+static struct rxAst *rxParseAtom(struct rxParser *ps) {
+    int c = (unsigned char)*ps->p;
+    switch (c) {
+        case '(': {
+            ps->p++;
+            struct rxAst *t = rxParseAlt(ps);
+            if (!t) return NULL;
+            if (*ps->p != ')') {
+                ps->err = "missing )";
+                rxAstFree(t);
+                return NULL;
+            }
+            ps->p++;
+            return t;
+        }
+        case '[':
+            ps->p++;
+            return rxParseClass(ps);
+        case '.':
+            ps->p++;
+            return rxWithMultibyte(rxRange(0x00, 0x7f));
+        case '^':
+            ps->p++;
+            return rxNew(RXA_BOL, NULL, NULL);
+        case '$':
+            ps->p++;
+            return rxNew(RXA_EOL, NULL, NULL);
+        case '*': case '+': case '?': case '{':
+            ps->err = "nothing to repeat";
+            return NULL;
+        case '\\': {
+            int e = (unsigned char)ps->p[1];
+            if (!e) {
+                ps->err = "trailing \\";
+                return NULL;
+            }
+            ps->p += 2;
+            struct rxAst *t = rxNew(RXA_SET, NULL, NULL);
+            if (rxClassEscape(t->set, e)) return t;
+            if (e == 'D' || e == 'W' || e == 'S') {
+                rxClassEscape(t->set, e - 'A' + 'a');
+                for (int b = 0; b < 16; b++) t->set[b] = ~t->set[b];
+                return rxWithMultibyte(t);
+            }
+            e = rxEscapeChar(e);
+            rxSetAdd(t->set, e, e);
+            return t;
+        }
+    }
+    return rxParseChar(ps);
+}
+
+/**
+ * 要素とそれに続く繰り返し指定を読む
+ */
+static struct rxAst *rxParseRepeat(struct rxParser *ps) {
+    struct rxAst *t = rxParseAtom(ps);
+    while (t) {
+        int min, max;
+        char c = *ps->p;
+        if (c != '*' && c != '+' && c != '?' && c != '{') break;
+        ps->p++;
+        if (c == '*') min = 0, max = -1;
+        else if (c == '+') min = 1, max = -1;
+        else if (c == '?') min = 0, max = 1;
+        else if (rxParseCount(ps, &min, &max) != 0) {
+            ps->err = "bad {m,n}";
+            rxAstFree(t);
+            return NULL;
+        }
+        t = rxNew(RXA_REP, t, NULL);
+        t->min = min;
+        t->max = max;
+    }
+    return t;
+}
+
+/**
+ * 連接を読む（|か)か末尾まで）
+ */
+static struct rxAst *rxParseCat(struct rxParser *ps) {
+    struct rxAst *t = NULL;
+    while (*ps->p && *ps->p != '|' && *ps->p != ')') {
+        struct rxAst *r = rxParseRepeat(ps);
+        if (!r) {
+            rxAstFree(t);
+            return NULL;
+        }
+        t = t ? rxNew(RXA_CAT, t, r) : r;
+    }
+    return t ? t : rxNew(RXA_EMPTY, NULL, NULL);
+}
+
+/**
+ * 選択を読む
+ */
+static struct rxAst *rxParseAlt(struct rxParser *ps) {
+    struct rxAst *t = rxParseCat(ps);
+    while (t && *ps->p == '|') {
+        ps->p++;
+        struct rxAst *r = rxParseCat(ps);
+        if (!r) {
+            rxAstFree(t);
+            return NULL;
+        }
+        t = rxNew(RXA_ALT, t, r);
+    }
+    return t;
+}
+
+/**
+ * 全マッチに共通の先頭の固定文字列を取り出す
+ * 構文木の左端から1バイトだけの集合が続く間を集める
+ *
+ * @return: 木全体が固定文字列として読み切れた場合は1
+ */
+static int rxPrefix(struct rxAst *t, char *buf, int *len, int *anchored) {
+    switch (t->type) {
+        case RXA_SET: {
+            int byte = -1;
+            for (int c = 0; c < 256; c++) {
+                if (!rxSetHas(t->set, c)) continue;
+                if (byte != -1) return 0;
+                byte = c;
+            }
+            if (byte == -1 || *len == RX_PREFIX_MAX) return 0;
+            buf[(*len)++] = byte;
+            return 1;
+        }
+        case RXA_CAT:
+            return rxPrefix(t->a, buf, len, anchored) && rxPrefix(t->b, buf, len, anchored);
+        case RXA_BOL:
+        case RXA_EOL:
+            *anchored = 1;
+            return 1;
+        case RXA_EMPTY:
+            return 1;
+    }
+    return 0;
+}
+
+/** NFA */
+
+static int rxNodeNew(struct rxDfa *d, int op, int out, int out1) {
+    if (d->nnodes == RX_MAX_NODES) return -1;
+    struct rxNode *n = &d->nodes[d->nnodes];
+    n->op = op;
+    n->out = out;
+    n->out1 = out1;
+    return d->nnodes++;
+}
+
+/**
+ * 構文木をNFAに変換（Thompson構成）
+ * 後ろから組み立て、作った断片の続きをnextにつなぐ
+ * reverseなら連接の順序と行頭・行末を入れ替えた、逆向きに読むNFAを作る
+ *
+ * @return: 断片の開始ノード（ノード数の上限を超えたら-1）
+ */
+static int rxEmit(struct rxDfa *d, struct rxAst *t, int next, int reverse) {
+    if (next < 0) return -1;
+    switch (t->type) {
+        case RXA_SET: {
+            int n = rxNodeNew(d, RXO_BYTE, next, -1);
+            if (n >= 0) memcpy(d->nodes[n].set, t->set, 32);
+            return n;
+        }
+        case RXA_CAT:
+            if (reverse) return rxEmit(d, t->b, rxEmit(d, t->a, next, reverse), reverse);
+            return rxEmit(d, t->a, rxEmit(d, t->b, next, reverse), reverse);
+        case RXA_ALT: {
+            int x = rxEmit(d, t->a, next, reverse);
+            int y = rxEmit(d, t->b, next, reverse);
+            if (x < 0 || y < 0) return -1;
+            return rxNodeNew(d, RXO_SPLIT, x, y);
+        }
+        case RXA_REP: {
+            int cont = next;
+            if (t->max == -1) {
+                // ループ：分岐ノードを先に作り、本体の続きを分岐に戻す
+                int s = rxNodeNew(d, RXO_SPLIT, -1, next);
+                if (s < 0) return -1;
+                int body = rxEmit(d, t->a, s, reverse);
+                if (body < 0) return -1;
+                d->nodes[s].out = body;
+                cont = s;
+            } else {
+                for (int k = t->min; k < t->max && cont >= 0; k++) {
+                    int body = rxEmit(d, t->a, cont, reverse);
+                    if (body < 0) return -1;
+                    cont = rxNodeNew(d, RXO_SPLIT, body, cont);
+                }
+            }
+            for (int k = 0; k < t->min && cont >= 0; k++) cont = rxEmit(d, t->a, cont, reverse);
+            return cont;
+        }
+        case RXA_BOL:
+            return rxNodeNew(d, reverse ? RXO_EOL : RXO_BOL, next, -1);
+        case RXA_EOL:
+            return rxNodeNew(d, reverse ? RXO_BOL : RXO_EOL, next, -1);
+    }
+    return next;
+}
+
+/** 遅延構築のDFA */
+
+static int rxCompareInt(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * NFAノードsから空遷移でたどれるノードを集める
+ * 集合に入れるのはバイトを読むノード・受理ノード・まだ通れない行末ノードだけ
+ * 行頭ノードは走査の先頭でしか通れず、後から通れるようにはならないので捨てる
+ */
+static void rxClosure(struct rxDfa *d, int s, int atBegin, int atEnd, int *n) {
+    int sp = 0;
+    d->stack[sp++] = s;
+    while (sp > 0) {
+        int x = d->stack[--sp];
+        if (d->seen[x] == d->gen) continue;
+        d->seen[x] = d->gen;
+        struct rxNode *node = &d->nodes[x];
+        switch (node->op) {
+            case RXO_SPLIT:
+                d->stack[sp++] = node->out1;
+                d->stack[sp++] = node->out;
+                break;
+            case RXO_BOL:
+                if (atBegin) d->stack[sp++] = node->out;
+                break;
+            case RXO_EOL:
+                if (atEnd) d->stack[sp++] = node->out;
+                else d->list[(*n)++] = x;
+                break;
+            default:
+                d->list[(*n)++] = x;
+                break;
+        }
+    }
+}
+
+/**
+ * キャッシュした状態を全て捨てる
+ */
+static void rxFlush(struct rxDfa *d) {
+    for (int h = 0; h < RX_HASH_SIZE; h++) {
+        struct rxState *st = d->table[h];
+        while (st) {
+            struct rxState *next = st->chain;
+            free(st->nodes);
+            free(st);
+            st = next;
+        }
+        d->table[h] = NULL;
+    }
+    d->nstates = 0;
+    d->init[0] = d->init[1] = NULL;
+    d->flushes++;
+}
+
+/**
+ * d->listのノード集合に対応する状態を取得（なければ作成）
+ * 状態数が上限に達していたらキャッシュを捨ててから作る
+ */
+static struct rxState *rxLookup(struct rxDfa *d, int n, int begin) {
+    qsort(d->list, n, sizeof(int), rxCompareInt);
+    unsigned int h = 2166136261u ^ begin;
+    for (int i = 0; i < n; i++) h = (h ^ d->list[i]) * 16777619u;
+    h &= RX_HASH_SIZE - 1;
+
+    for (struct rxState *st = d->table[h]; st; st = st->chain) {
+        if (st->n == n && st->begin == begin && memcmp(st->nodes, d->list, sizeof(int) * n) == 0) return st;
+    }
+
+    if (d->nstates == RX_MAX_STATES) rxFlush(d);
+    struct rxState *st = calloc(1, sizeof(struct rxState));
+    st->nodes = malloc(sizeof(int) * (n ? n : 1));
+    memcpy(st->nodes, d->list, sizeof(int) * n);
+    st->n = n;
+    st->begin = begin;
+    for (int i = 0; i < n; i++) {
+        if (d->nodes[st->nodes[i]].op == RXO_MATCH) st->match = 1;
+    }
+
+    // 走査の末尾なら行末ノードを通って受理できるか
+    st->matchEnd = st->match;
+    d->gen++;
+    int m = 0;
+    for (int i = 0; i < n && !st->matchEnd; i++) {
+        if (d->nodes[st->nodes[i]].op != RXO_EOL) continue;
+        int before = m;
+        rxClosure(d, d->nodes[st->nodes[i]].out, begin, 1, &m);
+        for (int k = before; k < m; k++) {
+            if (d->nodes[d->list[k]].op == RXO_MATCH) st->matchEnd = 1;
+        }
+    }
+
+    st->chain = d->table[h];
+    d->table[h] = st;
+    d->nstates++;
+    return st;
+}
+
+/**
+ * 走査を始める状態（beginなら走査の先頭）
+ */
+static struct rxState *rxInit(struct rxDfa *d, int begin) {
+    if (d->init[begin]) return d->init[begin];
+    d->gen++;
+    int n = 0;
+    rxClosure(d, d->start, begin, 0, &n);
+    struct rxState *st = rxLookup(d, n, begin);
+    d->init[begin] = st;
+    return st;
+}
+
+/**
+ * 状態stからバイトcを読んだ遷移先を計算してキャッシュする
+ */
+static struct rxState *rxStep(struct rxDfa *d, struct rxState *st, unsigned char c) {
+    d->gen++;
+    int n = 0;
+    for (int i = 0; i < st->n; i++) {
+        struct rxNode *node = &d->nodes[st->nodes[i]];
+        if (node->op == RXO_BYTE && rxSetHas(node->set, c)) rxClosure(d, node->out, 0, 0, &n);
+    }
+    if (d->unanchored) rxClosure(d, d->start, 0, 0, &n);
+
+    unsigned int flushes = d->flushes;
+    struct rxState *next = rxLookup(d, n, 0);
+    // キャッシュを捨てた場合はstも解放済み
+    if (d->flushes == flushes) st->next[c] = next;
+    return next;
+}
+
+static inline struct rxState *rxNext(struct rxDfa *d, struct rxState *st, unsigned char c) {
+    struct rxState *next = st->next[c];
+    return next ? next : rxStep(d, st, c);
+}
+
+/**
+ * 構文木からDFAを用意
+ */
+static int rxDfaInit(struct rxDfa *d, struct rxAst *t, int reverse, int unanchored) {
+    memset(d, 0, sizeof(*d));
+    d->nodes = malloc(sizeof(struct rxNode) * RX_MAX_NODES);
+    d->unanchored = unanchored;
+    d->start = rxEmit(d, t, rxNodeNew(d, RXO_MATCH, -1, -1), reverse);
+    if (d->start < 0) return -1;
+    d->nodes = realloc(d->nodes, sizeof(struct rxNode) * d->nnodes);
+    // 空遷移の探索は各ノードを1回しか積まないが、分岐ノードは2つ積む
+    d->stack = malloc(sizeof(int) * (d->nnodes * 2 + 1));
+    d->list = malloc(sizeof(int) * (d->nnodes + 1));
+    d->seen = calloc(d->nnodes, sizeof(unsigned int));
+    return 0;
+}
+
+static void rxDfaFree(struct rxDfa *d) {
+    rxFlush(d);
+    free(d->nodes);
+    free(d->stack);
+    free(d->list);
+    free(d->seen);
+}
+
+/** 公開関数 */
+
+/**
+ * 正規表現をコンパイル
+ * 失敗した場合はNULLを返し、errに理由を設定する
+ */
+struct regex *regexCompile(const char *pattern, const char **err) {
+    struct rxParser ps = {pattern, NULL};
+    struct rxAst *t = rxParseAlt(&ps);
+    if (t && *ps.p == ')') ps.err = "unmatched )";
+    if (!t || ps.err) {
+        *err = ps.err;
+        rxAstFree(t);
+        return NULL;
+    }
+
+    struct regex *re = calloc(1, sizeof(struct regex));
+    int anchored = 0;
+    re->literal = rxPrefix(t, re->prefix, &re->prefixlen, &anchored) && !anchored && re->prefixlen > 0;
+    if (rxDfaInit(&re->fwd, t, 0, 0) != 0 || rxDfaInit(&re->rev, t, 1, 1) != 0) {
+        *err = "pattern too large";
+        rxAstFree(t);
+        regexFree(re);
+        return NULL;
+    }
+    rxAstFree(t);
+    return re;
+}
+
+/**
+ * コンパイル済みの正規表現を解放
+ */
+void regexFree(struct regex *re) {
+    if (!re) return;
+    rxDfaFree(&re->fwd);
+    rxDfaFree(&re->rev);
+    free(re->starts);
+    free(re->memo);
+    free(re->path);
+    free(re);
+}
+
+/**
+ * 全マッチに共通の先頭の固定文字列を取得（なければ長さ0）
+ * literalには、パターン全体がその固定文字列と同じかどうかを設定する
+ */
+const char *regexPrefix(struct regex *re, int *len, int *literal) {
+    *len = re->prefixlen;
+    if (literal) *literal = re->literal;
+    return re->prefix;
+}
+
+/**
+ * 照合の中断要求を設定（別スレッドから*cancelを0以外にすると、
+ * 実行中のregexMatchLineがRX_CANCEL_SLICEバイト以内に打ち切られる）
+ */
+void regexSetCancel(struct regex *re, const int *cancel) {
+    re->cancel = cancel;
+}
+
+static int rxCancelled(struct regex *re) {
+    return re->cancel && __atomic_load_n(re->cancel, __ATOMIC_RELAXED);
+}
+
+/**
+ * 前向きの走査結果を全て無効にする（表の中身は世代番号で区別するので消さない）
+ */
+static void rxMemoReset(struct regex *re) {
+    re->memon = 0;
+    if (++re->memogen == 0) {
+        memset(re->memo, 0, sizeof(struct rxMemo) * re->memocap);
+        re->memogen = 1;
+    }
+    re->memoflushes = re->fwd.flushes;
+}
+
+static unsigned int rxMemoHash(int pos, struct rxState *st) {
+    return ((unsigned int)pos * 2654435761u) ^ (unsigned int)((size_t)st >> 4);
+}
+
+/**
+ * 位置posで状態stにいる走査の結果（記録がなければ-2）
+ */
+static int rxMemoGet(struct regex *re, int pos, struct rxState *st) {
+    if (re->memocap == 0) return -2;
+    unsigned int mask = re->memocap - 1;
+    for (unsigned int h = rxMemoHash(pos, st) & mask; re->memo[h].gen == re->memogen; h = (h + 1) & mask) {
+        if (re->memo[h].pos == pos && re->memo[h].st == st) return re->memo[h].best;
+    }
+    return -2;
+}
+
+static void rxMemoPut(struct regex *re, int pos, struct rxState *st, int best) {
+    if ((re->memon + 1) * 2 > re->memocap) {
+        // 表を広げて記録し直す
+        struct rxMemo *old = re->memo;
+        int oldcap = re->memocap;
+        re->memocap = oldcap ? oldcap * 2 : RX_MEMO_MIN;
+        re->memo = calloc(re->memocap, sizeof(struct rxMemo));
+        unsigned int gen = re->memogen;
+        re->memogen = 1;
+        re->memon = 0;
+        for (int i = 0; i < oldcap; i++) {
+            if (old[i].gen == gen) rxMemoPut(re, old[i].pos, old[i].st, old[i].best);
+        }
+        free(old);
+    }
+    unsigned int mask = re->memocap - 1;
+    unsigned int h = rxMemoHash(pos, st) & mask;
+    while (re->memo[h].gen == re->memogen) h = (h + 1) & mask;
+    re->memo[h] = (struct rxMemo){pos, st, best, re->memogen};
+    re->memon++;
+}
+
+/**
+ * 行内の位置startから始まる最長のマッチの終端を求める（マッチしなければ-1）
+ * 以前の走査と同じ位置で同じ状態になったら、その先は同じ結果になるので記録を使って打ち切る
+ * 走査し終えたら、通った各位置からの結果を記録する
+ * 走査中に中断要求があれば記録せずに-2を返す
+ */
+static int rxLongest(struct regex *re, const char *s, int n, int start) {
+    struct rxDfa *d = &re->fwd;
+    if (d->flushes != re->memoflushes) rxMemoReset(re);
+    if (n - start > re->pathcap) {
+        re->pathcap = (n - start) * 2;
+        re->path = realloc(re->path, sizeof(struct rxState *) * re->pathcap);
+    }
+
+    struct rxState *st = rxInit(d, start == 0);
+    int best = -1;          // 合流した走査の結果（-1なら以降で受理しない）
+    int k = 0;
+    for (int i = start; i < n; i++) {
+        if (((i - start) & (RX_CANCEL_SLICE - 1)) == RX_CANCEL_SLICE - 1 && rxCancelled(re)) {
+            rxMemoReset(re);
+            return -2;
+        }
+        st = rxNext(d, st, (unsigned char)s[i]);
+        if (st->n == 0) break;
+        int memo = rxMemoGet(re, i + 1, st);
+        if (memo != -2) {
+            best = memo;
+            break;
+        }
+        re->path[k++] = st;
+    }
+
+    // 後ろから、各位置以降で最後に受理する位置を求めて記録
+    // （途中でキャッシュを捨てた場合は通った状態が解放済みなので記録しない）
+    int valid = d->flushes == re->memoflushes;
+    for (int j = k - 1; j >= 0; j--) {
+        int pos = start + j + 1;
+        struct rxState *p = re->path[j];
+        if (best == -1 && (p->match || (pos == n && p->matchEnd))) best = pos;
+        if (valid) rxMemoPut(re, pos, p, best);
+    }
+    if (!valid) rxMemoReset(re);
+
+    st = rxInit(d, start == 0);
+    if (best == -1 && (st->match || (start == n && st->matchEnd))) best = start;
+    return best;
+}
+
+/**
+ * 1行（改行を含まないn バイト）の中の重ならないマッチを左から順に列挙
+ * 各マッチは最左・最長で選び、見つけるたびにfn(開始位置, 長さ, arg)を呼ぶ
+ * 空文字列のマッチはその行で最初のマッチの場合だけ数える（x* などで全位置が並ばないように）
+ * 後ろ向きの走査1回と、マッチごとの前向きの走査だけで済み、バックトラックはしない
+ * 前向きの走査は互いに合流したところで打ち切るので、全体でも行長×DFA状態数に比例する
+ * regexSetCancelで中断要求を設定していれば、走査中にも確認して途中で打ち切る
+ *
+ * @return: マッチ数（中断した場合は-1）
+ */
+int regexMatchLine(struct regex *re, const char *s, int n,
+                   void (*fn)(int start, int len, void *arg), void *arg) {
+    if (n + 1 > re->startscap) {
+        re->startscap = (n + 1) * 2;
+        re->starts = realloc(re->starts, re->startscap);
+    }
+
+    // 行末から逆向きに読み、各位置からマッチが始まるかどうかを印付け
+    struct rxDfa *d = &re->rev;
+    struct rxState *st = rxInit(d, 1);
+    re->starts[n] = st->match || (n == 0 && st->matchEnd);
+    for (int i = n - 1; i >= 0; i--) {
+        if (((n - 1 - i) & (RX_CANCEL_SLICE - 1)) == RX_CANCEL_SLICE - 1 && rxCancelled(re)) return -1;
+        st = rxNext(d, st, (unsigned char)s[i]);
+        re->starts[i] = st->match || (i == 0 && st->matchEnd);
+    }
+
+    rxMemoReset(re);
+    int count = 0;
+    int check = RX_CANCEL_SLICE;    // 次に中断要求を確認する位置
+    for (int i = 0; i <= n; ) {
+        const unsigned char *p = memchr(&re->starts[i], 1, n + 1 - i);
+        if (!p) break;
+        i = p - re->starts;
+        if (i >= check) {
+            if (rxCancelled(re)) return -1;
+            check = i + RX_CANCEL_SLICE;
+        }
+        int end = rxLongest(re, s, n, i);
+        if (end == -2) return -1;
+        if (end > i) {
+            fn(i, end - i, arg);
+            count++;
+            i = end;
+        } else {
+            if (end == i && count == 0) {
+                fn(i, 0, arg);
+                count++;
+            }
+            i++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,586 @@
+/**
+ * rope.c - 行ストレージ（行チャンクのロープ）
+ *
+ * 全行を最大ROW_CHUNK_MAX行ずつのチャンクに分け、
+ * チャンクを行数をキーとする暗黙treapで管理する：
+ * - 行の参照・挿入・削除をO(log n)で実行
+ * - 行配列は行数に合わせて確保し、削除で行が減ったチャンクは隣と統合する
+ * - 行インデックスはチャンクの親をたどって必要な時だけ計算
+ * - 直前に参照したチャンクをキャッシュし、連続アクセスを高速化
+ * - ファイルマッピング上の未展開チャンクを初めて参照された時に展開
+ */
+
+#include "kiloe.h"
+
+/**
+ * treap優先度用の疑似乱数（xorshift32）
+ * rand()の状態を汚さないよう独自に持つ
+ */
+static unsigned int ropeRandom() {
+    static unsigned int state = 2463534242u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/**
+ * 部分木の総行数（NULLは0行）
+ */
+static int chunkCount(struct rowChunk *t) {
+    return t ? t->count : 0;
+}
+
+/**
+ * 子の変更後に行数と子の親ポインタを再計算
+ */
+static void chunkUpdate(struct rowChunk *t) {
+    t->count = chunkCount(t->left) + t->n + chunkCount(t->right);
+    if (t->left) t->left->parent = t;
+    if (t->right) t->right->parent = t;
+}
+
+/**
+ * チャンクから根までの行数をdeltaだけ増減
+ */
+static void chunkAdjust(struct rowChunk *t, int delta) {
+    for (; t; t = t->parent) t->count += delta;
+}
+
+/**
+ * cap行分の行配列を持つ空のチャンクを確保
+ */
+static struct rowChunk *chunkNew(int cap) {
+    struct rowChunk *t = malloc(sizeof(struct rowChunk));
+    t->left = t->right = t->parent = NULL;
+    t->prio = ropeRandom();
+    t->count = 0;
+    t->n = 0;
+    t->cap = cap;
+    t->rows = malloc(sizeof(erow) * cap);
+    t->src = NULL;
+    t->srclen = 0;
+    t->hl_open_comment = 0;
+    t->hl_in_comment = 0;
+    t->hl_gen = 0;
+    t->hl_stale = 1;
+    return t;
+}
+
+static int chunkStart(struct rowChunk *c);
+
+/**
+ * 行配列の確保数をcapに変える
+ * 行の位置が変わるので、各行のchunkは同じままでも行へのポインタは取り直す必要がある
+ */
+static void chunkResize(struct rowChunk *c, int cap) {
+    c->rows = realloc(c->rows, sizeof(erow) * cap);
+    c->cap = cap;
+}
+
+/**
+ * 行配列にn行分の空きを確保（足りなければ倍々に、ROW_CHUNK_MAXまで増やす）
+ */
+static void chunkReserve(struct rowChunk *c, int n) {
+    if (n <= c->cap) return;
+    int cap = c->cap * 2 > n ? c->cap * 2 : n;
+    chunkResize(c, cap < ROW_CHUNK_MAX ? cap : ROW_CHUNK_MAX);
+}
+
+/**
+ * 行数が確保数の1/4以下に減っていれば、行配列を行数の2倍に縮める
+ */
+static void chunkShrink(struct rowChunk *c) {
+    if (c->n > 0 && c->n <= c->cap / 4) chunkResize(c, c->n * 2);
+}
+
+/**
+ * 未展開チャンクの行を元データから作成
+ * 既にハイライト確定範囲（hl_frontierより前）にあるチャンクは、
+ * 直前のチャンクの状態からその場でハイライトを計算して範囲を保つ
+ */
+static void chunkLoad(struct rowChunk *c) {
+    if (c->rows) return;
+    c->rows = malloc(sizeof(erow) * c->n);
+    c->cap = c->n;
+
+    const char *p = c->src;
+    const char *end = c->src + c->srclen;
+    for (int j = 0; j < c->n; j++) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *eol = nl ? nl : end;
+        size_t len = eol - p;
+        // 行末の改行文字を除去
+        while (len > 0 && (p[len - 1] == '\n' || p[len - 1] == '\r')) len--;
+
+        erow *row = &c->rows[j];
+        row->chunk = c;
+        row->size = len;
+        row->cap = len + 1;
+        row->gap = -1;
+        row->ckpt = NULL;
+        row->nckpt = 0;
+        row->ckptcap = 0;
+        row->snap_gen = 0;
+        row->chars = malloc(len + 1);
+        memcpy(row->chars, p, len);
+        row->chars[len] = '\0';
+        row->rsize = 0;
+        row->render = NULL;
+        row->hl = NULL;
+        row->hl_open_comment = 0;
+        row->hl_prev_comment = 0;
+        row->hl_gen = 0;
+        editorRenderRow(row);
+
+        p = nl ? nl + 1 : end;
+    }
+
+    if (chunkStart(c) < E.hl_frontier) {
+        for (int j = 0; j < c->n; j++) editorUpdateSyntax(&c->rows[j]);
+    }
+}
+
+/**
+ * 2つのロープを連結（aの全行がbの全行より前）
+ */
+static struct rowChunk *ropeMerge(struct rowChunk *a, struct rowChunk *b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (a->prio > b->prio) {
+        a->right = ropeMerge(a->right, b);
+        chunkUpdate(a);
+        return a;
+    }
+    b->left = ropeMerge(a, b->left);
+    chunkUpdate(b);
+    return b;
+}
+
+/**
+ * ロープを先頭k行とそれ以降に分割
+ * kはチャンク境界でなければならない
+ */
+static void ropeSplit(struct rowChunk *t, int k, struct rowChunk **l, struct rowChunk **r) {
+    if (!t) {
+        *l = *r = NULL;
+        return;
+    }
+    int lc = chunkCount(t->left);
+    if (k >= lc + t->n) {
+        ropeSplit(t->right, k - lc - t->n, &t->right, r);
+        chunkUpdate(t);
+        *l = t;
+    } else {
+        ropeSplit(t->left, k, l, &t->left);
+        chunkUpdate(t);
+        *r = t;
+    }
+}
+
+/**
+ * 行位置atのチャンク境界にチャンクを差し込む
+ */
+static void ropeInsertChunk(int at, struct rowChunk *c) {
+    struct rowChunk *l, *r;
+    ropeSplit(E.rowroot, at, &l, &r);
+    E.rowroot = ropeMerge(ropeMerge(l, c), r);
+    E.rowroot->parent = NULL;
+}
+
+/**
+ * 行位置atから始まるチャンクをロープから外して解放
+ */
+static void ropeRemoveChunk(int at, struct rowChunk *c) {
+    struct rowChunk *l, *m, *r;
+    ropeSplit(E.rowroot, at, &l, &m);
+    ropeSplit(m, c->n, &m, &r);
+    E.rowroot = ropeMerge(l, r);
+    if (E.rowroot) E.rowroot->parent = NULL;
+    free(c->rows);
+    free(c);
+}
+
+/**
+ * 中順で前のチャンクを取得
+ */
+static struct rowChunk *chunkPrev(struct rowChunk *t) {
+    if (t->left) {
+        t = t->left;
+        while (t->right) t = t->right;
+        return t;
+    }
+    while (t->parent && t->parent->left == t) t = t->parent;
+    return t->parent;
+}
+
+/**
+ * 中順で次のチャンクを取得
+ */
+static struct rowChunk *chunkNext(struct rowChunk *t) {
+    if (t->right) {
+        t = t->right;
+        while (t->left) t = t->left;
+        return t;
+    }
+    while (t->parent && t->parent->right == t) t = t->parent;
+    return t->parent;
+}
+
+/**
+ * チャンクの先頭行位置を計算
+ */
+static int chunkStart(struct rowChunk *c) {
+    int idx = chunkCount(c->left);
+    for (; c->parent; c = c->parent) {
+        if (c->parent->right == c) {
+            idx += chunkCount(c->parent->left) + c->parent->n;
+        }
+    }
+    return idx;
+}
+
+/**
+ * 行atを含むチャンクを展開せずに検索し、その先頭行位置を*startに返す
+ * 直前のチャンクとその次のチャンクはキャッシュから即座に返す
+ */
+static struct rowChunk *ropeLocate(int at, int *start) {
+    struct rowChunk *c = E.rowcache;
+    if (c) {
+        int s = E.rowcache_start;
+        if (at >= s && at < s + c->n) {
+            *start = s;
+            return c;
+        }
+        if (at >= s + c->n) {
+            struct rowChunk *next = chunkNext(c);
+            if (next && at < s + c->n + next->n) {
+                E.rowcache = next;
+                E.rowcache_start = s + c->n;
+                *start = E.rowcache_start;
+                return next;
+            }
+        }
+    }
+
+    struct rowChunk *t = E.rowroot;
+    int base = 0;
+    while (t) {
+        int lc = chunkCount(t->left);
+        if (at < base + lc) {
+            t = t->left;
+        } else if (at < base + lc + t->n) {
+            *start = base + lc;
+            E.rowcache = t;
+            E.rowcache_start = *start;
+            return t;
+        } else {
+            base += lc + t->n;
+            t = t->right;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 行atを含むチャンクを検索して展開し、その先頭行位置を*startに返す
+ */
+static struct rowChunk *ropeFind(int at, int *start) {
+    struct rowChunk *c = ropeLocate(at, start);
+    if (c) chunkLoad(c);
+    return c;
+}
+
+/**
+ * 行atを含むチャンクを展開せずに取得（範囲外ならNULL）
+ */
+struct rowChunk *ropeChunkAt(int at, int *start) {
+    if (at < 0 || at >= E.numrows) return NULL;
+    return ropeLocate(at, start);
+}
+
+/**
+ * 前のチャンクを展開せずに取得
+ */
+struct rowChunk *ropeChunkPrev(struct rowChunk *c) {
+    return chunkPrev(c);
+}
+
+/**
+ * 指定位置の行を取得
+ * 範囲外の場合はNULLを返す
+ */
+erow *editorRowAt(int at) {
+    if (at < 0 || at >= E.numrows) return NULL;
+    int start;
+    struct rowChunk *c = ropeFind(at, &start);
+    return &c->rows[at - start];
+}
+
+/**
+ * 行の現在のインデックスを計算
+ * チャンクから根まで親をたどり、左側の行数を合計する
+ */
+int editorRowIndex(erow *row) {
+    return chunkStart(row->chunk) + (int)(row - row->chunk->rows);
+}
+
+/**
+ * 直前の行を取得（先頭行ならNULL）
+ */
+erow *editorRowPrev(erow *row) {
+    if (row > row->chunk->rows) return row - 1;
+    struct rowChunk *c = chunkPrev(row->chunk);
+    if (!c) return NULL;
+    chunkLoad(c);
+    return &c->rows[c->n - 1];
+}
+
+/**
+ * 直後の行を取得（最終行ならNULL）
+ */
+erow *editorRowNext(erow *row) {
+    struct rowChunk *c = row->chunk;
+    if (row + 1 < c->rows + c->n) return row + 1;
+    c = chunkNext(c);
+    if (!c) return NULL;
+    chunkLoad(c);
+    return &c->rows[0];
+}
+
+/**
+ * 直前の行を展開済みの場合のみ取得
+ * 隣のチャンクが未展開ならNULL（展開の連鎖を起こさない）
+ */
+erow *ropePeekPrev(erow *row) {
+    if (row > row->chunk->rows) return row - 1;
+    struct rowChunk *c = chunkPrev(row->chunk);
+    return (c && c->rows) ? &c->rows[c->n - 1] : NULL;
+}
+
+/**
+ * 直後の行を展開済みの場合のみ取得
+ */
+erow *ropePeekNext(erow *row) {
+    struct rowChunk *c = row->chunk;
+    if (row + 1 < c->rows + c->n) return row + 1;
+    c = chunkNext(c);
+    return (c && c->rows) ? &c->rows[0] : NULL;
+}
+
+/**
+ * 元データ上のn行を未展開チャンクとして末尾に追加
+ * 行の中身は最初に参照された時にchunkLoadで作成される
+ */
+void ropeAppendLazy(const char *src, size_t len, int n) {
+    struct rowChunk *t = malloc(sizeof(struct rowChunk));
+    t->left = t->right = t->parent = NULL;
+    t->prio = ropeRandom();
+    t->count = n;
+    t->n = n;
+    t->rows = NULL;
+    t->cap = 0;
+    t->src = src;
+    t->srclen = len;
+    t->hl_open_comment = 0;
+    t->hl_in_comment = 0;
+    t->hl_gen = 0;
+    t->hl_stale = 1;
+    E.rowcache = NULL;
+    ropeInsertChunk(E.numrows, t);
+}
+
+/**
+ * 展開済みのチャンクcを先頭off行とそれ以降に分ける
+ * startはcの先頭行位置、後半を持つ新しいチャンクを返す
+ */
+static struct rowChunk *chunkSplit(struct rowChunk *c, int start, int off) {
+    struct rowChunk *d = chunkNew(c->n - off);
+    d->n = c->n - off;
+    memcpy(d->rows, &c->rows[off], sizeof(erow) * d->n);
+    for (int j = 0; j < d->n; j++) d->rows[j].chunk = d;
+    d->count = d->n;
+    c->n = off;
+    chunkAdjust(c, -d->n);
+    chunkShrink(c);
+    ropeInsertChunk(start + off, d);
+    return d;
+}
+
+/**
+ * 展開済みのチャンクcの後ろに、直後のチャンクdの行を移してdを取り除く
+ * startはdの先頭行位置。統合したチャンクのコメント状態は計算し直させる
+ */
+static void chunkAbsorb(struct rowChunk *c, struct rowChunk *d, int start) {
+    int n = d->n;
+    chunkReserve(c, c->n + n);
+    memcpy(&c->rows[c->n], d->rows, sizeof(erow) * n);
+    for (int j = 0; j < n; j++) c->rows[c->n + j].chunk = c;
+    ropeRemoveChunk(start, d);
+    c->n += n;
+    chunkAdjust(c, n);
+    c->hl_stale = 1;
+}
+
+/**
+ * 行位置atに未初期化の行スロットを確保
+ * chunk以外のフィールドの初期化は呼び出し側が行い、E.numrowsも呼び出し側が更新する
+ */
+erow *ropeInsertRow(int at) {
+    struct rowChunk *c;
+    int start;
+
+    E.rowcache = NULL;
+
+    if (E.rowroot == NULL) {
+        // 最初の行：空のチャンクを作成
+        c = chunkNew(1);
+        E.rowroot = c;
+        start = 0;
+    } else if (at == E.numrows) {
+        // 末尾への追加：最後のチャンクを使用
+        c = E.rowroot;
+        while (c->right) c = c->right;
+        start = E.numrows - c->n;
+        chunkLoad(c);
+    } else {
+        c = ropeFind(at, &start);
+        E.rowcache = NULL;
+    }
+
+    int off = at - start;
+    if (c->n == ROW_CHUNK_MAX) {
+        if (off == c->n) {
+            // チャンク末尾への挿入：後ろに空のチャンクを追加
+            struct rowChunk *d = chunkNew(1);
+            ropeInsertChunk(start + c->n, d);
+            c = d;
+            start = at;
+            off = 0;
+        } else {
+            // 満杯のチャンクを半分に分割
+            int half = ROW_CHUNK_MAX / 2;
+            struct rowChunk *d = chunkSplit(c, start, half);
+            if (off > half) {
+                c = d;
+                start += half;
+                off -= half;
+            }
+        }
+    }
+
+    // 挿入位置以降の行をチャンク内で後ろにシフト
+    chunkReserve(c, c->n + 1);
+    memmove(&c->rows[off + 1], &c->rows[off], sizeof(erow) * (c->n - off));
+    c->n++;
+    chunkAdjust(c, 1);
+    c->rows[off].chunk = c;
+    return &c->rows[off];
+}
+
+/**
+ * 行位置atにn行分の未初期化の行スロットをまとめて確保
+ * 新しいチャンクを組み立ててから1回の分割・連結でロープに差し込む
+ * chunk以外のフィールドの初期化とE.numrowsの更新は呼び出し側が行う
+ * 確保した先頭の行を返す（続く行はeditorRowNextでたどる）
+ */
+erow *ropeInsertRows(int at, int n) {
+    if (n <= 0) return NULL;
+    E.rowcache = NULL;
+
+    // 挿入位置がチャンクの途中ならチャンク境界になるよう分ける
+    if (at > 0 && at < E.numrows) {
+        int start;
+        struct rowChunk *c = ropeFind(at, &start);
+        E.rowcache = NULL;
+        if (at > start) chunkSplit(c, start, at - start);
+    }
+
+    // 新しい行を詰めたチャンク列を作成
+    struct rowChunk *t = NULL;
+    struct rowChunk *first = NULL;
+    for (int done = 0; done < n; ) {
+        struct rowChunk *c = chunkNew(n - done < ROW_CHUNK_MAX ? n - done : ROW_CHUNK_MAX);
+        c->n = c->cap;
+        c->count = c->n;
+        for (int j = 0; j < c->n; j++) c->rows[j].chunk = c;
+        t = ropeMerge(t, c);
+        t->parent = NULL;
+        if (!first) first = c;
+        done += c->n;
+    }
+
+    ropeInsertChunk(at, t);
+    return &first->rows[0];
+}
+
+/**
+ * 行位置atのスロットをロープから取り除く
+ * 行のメモリ解放とE.numrowsの更新は呼び出し側が行う
+ * 行数がROW_CHUNK_MAX/4を下回ったチャンクは、展開済みの隣のチャンクに収まれば統合し、
+ * 統合できなければ行配列を縮める（削除を繰り返しても小さなチャンクが溜まらないように）
+ */
+void ropeDeleteRow(int at) {
+    int start;
+    struct rowChunk *c = ropeFind(at, &start);
+    E.rowcache = NULL;
+
+    if (c->n == 1) {
+        // 最後の1行ならチャンクごと取り除く
+        ropeRemoveChunk(start, c);
+        return;
+    }
+
+    int off = at - start;
+    memmove(&c->rows[off], &c->rows[off + 1], sizeof(erow) * (c->n - off - 1));
+    c->n--;
+    chunkAdjust(c, -1);
+    if (c->n >= ROW_CHUNK_MAX / 4) return;
+
+    struct rowChunk *prev = chunkPrev(c);
+    struct rowChunk *next = chunkNext(c);
+    if (prev && prev->rows && prev->n + c->n <= ROW_CHUNK_MAX) {
+        chunkAbsorb(prev, c, start);
+    } else if (next && next->rows && c->n + next->n <= ROW_CHUNK_MAX) {
+        chunkAbsorb(c, next, start + c->n);
+    } else {
+        chunkShrink(c);
+    }
+}
+
+/**
+ * チャンク部分木を再帰的に解放
+ */
+static void ropeFree(struct rowChunk *t) {
+    if (!t) return;
+    ropeFree(t->left);
+    ropeFree(t->right);
+    if (t->rows) {
+        for (int j = 0; j < t->n; j++) editorFreeRow(&t->rows[j]);
+        free(t->rows);
+    }
+    free(t);
+}
+
+/**
+ * 全行を解放して空のバッファに戻す
+ */
+void editorFreeRows() {
+    // 保存中のスナップショットは行とファイルマッピングを参照しているので先に書き終える
+    editorSaveWait();
+    editorUndoReset();
+    editorJournalClose(0);
+    ropeFree(E.rowroot);
+    E.rowroot = NULL;
+    E.rowcache = NULL;
+    E.rowcache_start = 0;
+    E.numrows = 0;
+
+    // 未展開チャンクが参照していたファイルマッピングを解放
+    if (E.map) {
+        munmap(E.map, E.mapsize);
+        close(E.mapfd);
+        E.map = NULL;
+        E.mapsize = 0;
+    }
+}
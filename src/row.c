@@ -2,73 +2,135 @@
  * row.c - 行操作機能
  * 
  * テキストの各行に対する基本操作を提供：
- * - カーソル位置変換（文字位置⇔表示位置）
- * - 行の更新・挿入・削除
- * - 文字の挿入・削除・追加
+ * - カーソル位置変換（文字位置⇔表示位置、長い行ではチェックポイントから計算）
+ * - 行の更新・挿入・削除（格納は rope.c の行ロープ）
+ * - 文字の挿入・削除・追加（編集位置にギャップを開いて連続した編集をO(1)にする）
+ * - 保存や検索のスレッドが参照中の行を書き換える時の切り離し（スナップショットの内容を保つ）
  * - UTF-8とタブ文字の適切な処理
  */
 
 #include "kiloe.h"
 
+/**
+ * 1文字分進めた時の文字位置と表示位置を計算
+ * UTF-8文字の表示幅とタブ展開を考慮する
+ */
+static void rowStep(erow *row, int *cx, int *rx) {
+    if (row->chars[*cx] == '\t') {
+        // タブ位置の計算（次のタブストップ位置まで）
+        *rx += KILO_TAB_STOP - (*rx % KILO_TAB_STOP);
+        (*cx)++;
+    } else {
+        // UTF-8文字の表示幅を取得（日本語文字は2幅）
+        *rx += get_char_width(row->chars, *cx);
+        // 次のUTF-8文字の開始位置へ移動
+        *cx = move_to_next_char(row->chars, *cx, row->size);
+    }
+}
+
+/**
+ * cx⇔rx変換用のチェックポイントをk番目まで作成
+ * k番目はk*ROW_CKPT_STRIDEバイト以降の最初の文字境界で、計算済みの最後の点から続けて求める
+ */
+static void rowCkptExtend(erow *row, int k) {
+    if (k < row->nckpt) return;
+    if (k >= row->ckptcap) {
+        row->ckptcap = row->ckptcap * 2 > k + 1 ? row->ckptcap * 2 : k + 1;
+        row->ckpt = realloc(row->ckpt, sizeof(struct rowCheckpoint) * row->ckptcap);
+    }
+    if (row->nckpt == 0) {
+        row->ckpt[0].cx = 0;
+        row->ckpt[0].rx = 0;
+        row->nckpt = 1;
+    }
+
+    int cx = row->ckpt[row->nckpt - 1].cx;
+    int rx = row->ckpt[row->nckpt - 1].rx;
+    while (row->nckpt <= k) {
+        int target = row->nckpt * ROW_CKPT_STRIDE;
+        while (cx < target && cx < row->size) rowStep(row, &cx, &rx);
+        row->ckpt[row->nckpt].cx = cx;
+        row->ckpt[row->nckpt].rx = rx;
+        row->nckpt++;
+    }
+}
+
+/**
+ * 位置at以降の変更で古くなるチェックポイントを捨てる
+ * atより十分前のチェックポイントは前にある文字だけで決まるので残す
+ */
+static void rowCkptInvalidate(erow *row, int at) {
+    int keep = at / ROW_CKPT_STRIDE;
+    if (row->nckpt > keep) row->nckpt = keep;
+}
+
 /**
  * chars内カーソル位置をrender内カーソル位置に変換
- * UTF-8文字の表示幅とタブ展開を考慮した位置計算
+ * 直前のチェックポイントから歩くので、長い行でもROW_CKPT_STRIDEバイト程度で済む
  */
 int editorRowCxToRx(erow *row, int cx) {
+    editorRowCompact(row);
+    if (cx > row->size) cx = row->size;
     int rx = 0;
     int j = 0;
-    
-    while (j < cx && j < row->size) {
-        if (row->chars[j] == '\t') {
-            // タブ位置の計算（次のタブストップ位置まで）
-            rx += (KILO_TAB_STOP - 1) - (rx % KILO_TAB_STOP);
-            rx++;
-            j++;
-        } else {
-            // UTF-8文字の表示幅を取得（日本語文字は2幅）
-            int char_width = get_char_width(row->chars, j);
-            rx += char_width;
-            // 次のUTF-8文字の開始位置へ移動
-            j = move_to_next_char(row->chars, j, row->size);
-        }
+
+    int k = cx / ROW_CKPT_STRIDE;
+    if (k > 0) {
+        rowCkptExtend(row, k);
+        // 文字境界への補正でcxを越えている場合は1つ前から
+        if (row->ckpt[k].cx > cx) k--;
+        j = row->ckpt[k].cx;
+        rx = row->ckpt[k].rx;
     }
+    
+    while (j < cx) rowStep(row, &j, &rx);
     return rx;
 }
 
 /**
  * render内カーソル位置をchars内カーソル位置に変換
- * 表示位置から実際のバイト位置を逆算
+ * 表示位置がrx以下の最後のチェックポイントを二分探索し、そこから逆算
  */
 int editorRowRxToCx(erow *row, int rx) {
+    editorRowCompact(row);
     int cur_rx = 0;
     int cx = 0;
+
+    if (row->size >= ROW_CKPT_STRIDE) {
+        // rxを越えるか行末に達するまでチェックポイントを作成
+        int last = row->size / ROW_CKPT_STRIDE;
+        while (row->nckpt <= last && (row->nckpt == 0 || row->ckpt[row->nckpt - 1].rx <= rx)) {
+            rowCkptExtend(row, row->nckpt);
+        }
+        int lo = 0, hi = row->nckpt - 1;
+        while (lo < hi) {
+            int mid = (lo + hi + 1) / 2;
+            if (row->ckpt[mid].rx <= rx) lo = mid;
+            else hi = mid - 1;
+        }
+        cx = row->ckpt[lo].cx;
+        cur_rx = row->ckpt[lo].rx;
+    }
     
     while (cx < row->size) {
-        if (row->chars[cx] == '\t') {
-            // タブの表示幅を計算
-            cur_rx += (KILO_TAB_STOP - 1) - (cur_rx % KILO_TAB_STOP);
-            cur_rx++;
-            // 指定表示位置を超えた場合は現在位置を返す
-            if (cur_rx > rx) return cx;
-            cx++;
-        } else {
-            // UTF-8文字の表示幅を取得
-            int char_width = get_char_width(row->chars, cx);
-            // 指定表示位置を超える場合は現在位置を返す
-            if (cur_rx + char_width > rx) return cx;
-            cur_rx += char_width;
-            // 次のUTF-8文字の開始位置へ移動
-            cx = move_to_next_char(row->chars, cx, row->size);
-        }
+        int next_cx = cx;
+        int next_rx = cur_rx;
+        rowStep(row, &next_cx, &next_rx);
+        // 指定表示位置を超える場合は現在位置を返す
+        if (next_rx > rx) return cx;
+        cx = next_cx;
+        cur_rx = next_rx;
     }
     return cx;
 }
 
 /**
- * 行の表示用データを更新
- * タブをスペースに展開してrenderバッファを構築し、シンタックスハイライトも更新
+ * 行の表示用データを構築
+ * タブをスペースに展開してrenderバッファを作り、ハイライトは未計算の印を付ける
  */
-void editorUpdateRow(erow *row) {
+void editorRenderRow(erow *row) {
+    editorRowCompact(row);
+
     // タブ文字の数をカウント
     int tabs = 0;
     int j;
@@ -114,8 +176,232 @@ void editorUpdateRow(erow *row) {
     row->render[idx] = '\0';
     row->rsize = idx;
 
-    // シンタックスハイライト情報を更新
-    editorUpdateSyntax(row);
+    // ハイライトは表示時に計算する
+    row->hl_dirty = HL_ROW_DIRTY;
+}
+
+/**
+ * 行の表示用データを更新
+ * renderを作り直し、この行以降のシンタックスハイライトを無効化
+ */
+void editorUpdateRow(erow *row) {
+    rowCkptInvalidate(row, 0);
+    editorRenderRow(row);
+    editorSyntaxInvalidate(editorRowIndex(row));
+}
+
+/**
+ * renderが古くなっていれば作り直す
+ * 文字の挿入・削除ではrenderを破棄するだけで、表示やハイライトの直前にここで作り直す
+ */
+void editorRowEnsureRender(erow *row) {
+    if (row->render == NULL) editorRenderRow(row);
+}
+
+/**
+ * 行のテキストが変わったことを記録
+ * renderは次に必要になるまで作り直さない（ギャップを閉じずに済む）
+ */
+static void rowTextChanged(erow *row, int at) {
+    rowCkptInvalidate(row, at);
+    free(row->render);
+    row->render = NULL;
+    row->rsize = 0;
+    row->hl_dirty = HL_ROW_DIRTY;
+    editorSyntaxInvalidate(editorRowIndex(row));
+}
+
+/* 使用中のスナップショットの世代と、それらが参照したまま行から切り離した文字列（メインスレッドのみ） */
+static unsigned int snapGen = 0;        /* 最後に作ったスナップショットの世代 */
+static unsigned int *snapLive = NULL;
+static int snapNlive = 0;
+static int snapLiveCap = 0;
+
+struct snapRetained {
+    char *chars;
+    unsigned int gen;   /* 切り離した時点の行のsnap_gen */
+};
+static struct snapRetained *snapRetained = NULL;
+static int snapNretained = 0;
+static int snapRetainedCap = 0;
+
+/**
+ * 行の文字列を参照するスナップショットを開始し、その世代を返す
+ * 呼び出し側は参照した行のsnap_genに世代を記録し、使い終わったらeditorSnapshotEndを呼ぶ
+ * 記録した行を使用中に書き換えたり削除したりすると、元の文字列はそれまで残される
+ */
+unsigned int editorSnapshotBegin() {
+    if (++snapGen == 0) snapGen = 1;
+    if (snapNlive == snapLiveCap) {
+        snapLiveCap = snapLiveCap ? snapLiveCap * 2 : 4;
+        snapLive = realloc(snapLive, sizeof(unsigned int) * snapLiveCap);
+    }
+    snapLive[snapNlive++] = snapGen;
+    if (E.snap_min == 0) E.snap_min = snapGen;
+    return snapGen;
+}
+
+/**
+ * スナップショットの使用を終える
+ * 残っているスナップショットのどれからも参照されなくなった文字列を解放する
+ */
+void editorSnapshotEnd(unsigned int gen) {
+    int i = 0;
+    while (i < snapNlive && snapLive[i] != gen) i++;
+    if (i == snapNlive) return;
+    memmove(&snapLive[i], &snapLive[i + 1], sizeof(unsigned int) * (snapNlive - i - 1));
+    snapNlive--;
+    // 世代は作った順に並ぶので、先頭が最も古い
+    E.snap_min = snapNlive ? snapLive[0] : 0;
+
+    int kept = 0;
+    for (int j = 0; j < snapNretained; j++) {
+        if (E.snap_min != 0 && snapRetained[j].gen >= E.snap_min) snapRetained[kept++] = snapRetained[j];
+        else free(snapRetained[j].chars);
+    }
+    snapNretained = kept;
+}
+
+/**
+ * 使用中のスナップショットが行のcharsを参照しているかどうか
+ * 行に記録した世代が最も古い使用中の世代以降なら、参照している可能性がある
+ */
+static int rowSnapshotted(erow *row) {
+    return E.snap_min != 0 && row->snap_gen >= E.snap_min;
+}
+
+/**
+ * 参照されている文字列を、参照するスナップショットが全て終わるまで預かる
+ */
+static void rowRetain(erow *row) {
+    if (snapNretained == snapRetainedCap) {
+        snapRetainedCap = snapRetainedCap ? snapRetainedCap * 2 : 64;
+        snapRetained = realloc(snapRetained, sizeof(struct snapRetained) * snapRetainedCap);
+    }
+    snapRetained[snapNretained].chars = row->chars;
+    snapRetained[snapNretained].gen = row->snap_gen;
+    snapNretained++;
+}
+
+/**
+ * charsを書き換える前に呼び、使用中のスナップショットが参照していれば切り離す
+ * 元の領域はスナップショットが終わるまで預け、行には複製を持たせる（書き換える行だけを複製する）
+ */
+static void rowDetach(erow *row) {
+    if (!rowSnapshotted(row)) return;
+    char *copy = malloc(row->cap);
+    memcpy(copy, row->chars, row->cap);
+    rowRetain(row);
+    row->chars = copy;
+    row->snap_gen = 0;
+}
+
+/**
+ * ギャップを閉じてcharsを連続した文字列に戻す
+ * charsを直接読む処理の前に呼ぶ
+ */
+void editorRowCompact(erow *row) {
+    if (row->gap < 0) return;
+    rowDetach(row);
+    int gaplen = row->cap - 1 - row->size;
+    memmove(&row->chars[row->gap], &row->chars[row->gap + gaplen], row->size - row->gap);
+    row->chars[row->size] = '\0';
+    row->gap = -1;
+}
+
+/**
+ * 行の文字列を連続したNUL終端の文字列として取得
+ */
+char *editorRowText(erow *row) {
+    editorRowCompact(row);
+    return row->chars;
+}
+
+/**
+ * ギャップに少なくともneedバイトの空きを確保
+ * 容量は倍々に増やし、ギャップ以降の文字は新しい末尾に移す
+ */
+static void rowGapReserve(erow *row, int need) {
+    if (row->cap - 1 - row->size >= need) return;
+    rowDetach(row);
+
+    int oldcap = row->cap;
+    int newcap = oldcap * 2;
+    if (newcap < row->size + 1 + need + ROW_GAP_MIN) newcap = row->size + 1 + need + ROW_GAP_MIN;
+    row->chars = realloc(row->chars, newcap);
+    row->cap = newcap;
+
+    if (row->gap >= 0) {
+        int tail = row->size - row->gap;
+        memmove(&row->chars[newcap - 1 - tail], &row->chars[oldcap - 1 - tail], tail);
+        row->chars[newcap - 1] = '\0';
+    }
+}
+
+/**
+ * ギャップを位置atに移動（ギャップがなければatに開く）
+ * 移動量はatと現在のギャップ位置の距離だけで済む
+ */
+static void rowGapMove(erow *row, int at) {
+    int gaplen = row->cap - 1 - row->size;
+    rowDetach(row);
+
+    if (row->gap < 0) {
+        // at以降の文字を確保領域の末尾に寄せる
+        memmove(&row->chars[at + gaplen], &row->chars[at], row->size - at);
+        row->chars[row->cap - 1] = '\0';
+    } else if (at < row->gap) {
+        // ギャップの前の文字をギャップの後ろへ
+        memmove(&row->chars[at + gaplen], &row->chars[at], row->gap - at);
+    } else if (at > row->gap) {
+        // ギャップの後ろの文字をギャップの前へ
+        memmove(&row->chars[row->gap], &row->chars[row->gap + gaplen], at - row->gap);
+    }
+    row->gap = at;
+}
+
+/**
+ * 行内で位置atの直前のUTF-8文字の開始位置を取得
+ * ギャップをatに移動するだけで、ギャップは閉じない
+ */
+int editorRowPrevChar(erow *row, int at) {
+    if (row->gap >= 0) rowGapMove(row, at);
+    return move_to_prev_char(row->chars, at);
+}
+
+/**
+ * 行内で位置atの次のUTF-8文字の開始位置を取得
+ * ギャップをatに移動するだけで、ギャップは閉じない
+ */
+int editorRowNextChar(erow *row, int at) {
+    if (row->gap < 0) return move_to_next_char(row->chars, at, row->size);
+    rowGapMove(row, at);
+    // at以降の文字はギャップの長さだけ後ろにある
+    return move_to_next_char(row->chars + (row->cap - 1 - row->size), at, row->size);
+}
+
+/**
+ * 確保した行スロットを文字列で初期化
+ */
+static void rowInit(erow *row, const char *s, size_t len) {
+    row->size = len;
+    row->cap = len + 1;
+    row->gap = -1;
+    row->ckpt = NULL;
+    row->nckpt = 0;
+    row->ckptcap = 0;
+    row->snap_gen = 0;
+    row->chars = malloc(len + 1);
+    memcpy(row->chars, s, len);
+    row->chars[len] = '\0';
+    
+    // 表示用データを初期化
+    row->rsize = 0;
+    row->render = NULL;
+    row->hl = NULL;
+    row->hl_open_comment = 0;
+    row->hl_prev_comment = 0;
+    row->hl_gen = 0;
 }
 
 /**
@@ -125,42 +411,104 @@ void editorInsertRow(int at, char *s, size_t len) {
     // 挿入位置の妥当性チェック
     if (at < 0 || at > E.numrows) return;
 
-    // 行配列を1つ拡張
-    E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-    // 挿入位置以降の行を後ろにシフト
-    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
-    
-    // シフト後の行インデックスを更新
-    for (int j = at + 1; j <= E.numrows; j++) E.row[j].idx++;
-
-    // 新しい行を初期化
-    E.row[at].idx = at;
-    E.row[at].size = len;
-    E.row[at].chars = malloc(len + 1);
-    memcpy(E.row[at].chars, s, len);
-    E.row[at].chars[len] = '\0';
+    // 行ロープに新しい行スロットを確保（後続行の移動とインデックス更新は不要）
+    erow *row = ropeInsertRow(at);
+    rowInit(row, s, len);
     
-    // 表示用データを初期化
-    E.row[at].rsize = 0;
-    E.row[at].render = NULL;
-    E.row[at].hl = NULL;
-    E.row[at].hl_open_comment = 0;
-    
-    // 行データを更新
-    editorUpdateRow(&E.row[at]);
-    
-    // 行数とダーティフラグを更新
+    // 行数を更新してから行データを更新（行インデックスの計算に必要）
     E.numrows++;
+    editorUpdateRow(row);
+    
+    // ダーティフラグを更新
     E.dirty++;
 }
 
+/**
+ * 改行区切りの文字列を複数行として指定位置にまとめて挿入
+ * 改行はLF・CR・CRLFのいずれも受け付け、末尾の改行の後には空行ができる
+ * 行スロットは一度に確保し、ハイライトの無効化も挿入位置で1回だけ行う
+ * 挿入した行数を返す
+ */
+int editorInsertRows(int at, const char *s, size_t len) {
+    // 挿入位置の妥当性チェック
+    if (at < 0 || at > E.numrows) return 0;
+
+    // 行数を数える
+    int n = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '\r' && i + 1 < len && s[i + 1] == '\n') i++;
+        if (s[i] == '\n' || s[i] == '\r') n++;
+    }
+
+    erow *row = ropeInsertRows(at, n);
+    E.numrows += n;
+
+    const char *p = s;
+    const char *end = s + len;
+    for (int j = 0; j < n; j++) {
+        const char *eol = p;
+        while (eol < end && *eol != '\n' && *eol != '\r') eol++;
+        rowInit(row, p, eol - p);
+        editorRenderRow(row);
+
+        // 改行（CRLFは1つの改行）を読み飛ばす
+        if (eol < end && *eol == '\r' && eol + 1 < end && eol[1] == '\n') eol++;
+        p = eol < end ? eol + 1 : end;
+        if (j + 1 < n) row = editorRowNext(row);
+    }
+
+    editorSyntaxInvalidate(at);
+    E.dirty++;
+    return n;
+}
+
+/**
+ * 行位置atからn行を、改行で終わる行を連結した文字列の行でまとめて置き換える（ジャーナルの復元用）
+ * 改行はLFのみで、CRは行の内容として扱う
+ * 行スロットは一度に確保し、ハイライトの無効化も置き換え位置で1回だけ行う
+ * 置き換えた後の行数を返す
+ */
+int editorReplaceRows(int at, int n, const char *s, size_t len) {
+    // 置き換え範囲の妥当性チェック
+    if (at < 0 || n < 0 || at + n > E.numrows) return 0;
+
+    for (int j = 0; j < n; j++) {
+        editorFreeRow(editorRowAt(at));
+        ropeDeleteRow(at);
+        E.numrows--;
+    }
+
+    // 行数を数える
+    int m = 0;
+    for (const char *p = s; (p = memchr(p, '\n', s + len - p)); p++) m++;
+
+    erow *row = ropeInsertRows(at, m);
+    E.numrows += m;
+
+    const char *p = s;
+    for (int j = 0; j < m; j++) {
+        const char *eol = memchr(p, '\n', s + len - p);
+        rowInit(row, p, eol - p);
+        editorRenderRow(row);
+        p = eol + 1;
+        if (j + 1 < m) row = editorRowNext(row);
+    }
+
+    editorSyntaxInvalidate(at);
+    E.dirty++;
+    return m;
+}
+
 /**
  * 行のメモリを解放
  */
 void editorFreeRow(erow *row) {
     free(row->render);
-    free(row->chars);
+    // 使用中のスナップショットが参照していれば終わるまで残す
+    if (rowSnapshotted(row)) rowRetain(row);
+    else free(row->chars);
     free(row->hl);
+    free(row->ckpt);
 }
 
 /**
@@ -170,17 +518,16 @@ void editorDelRow(int at) {
     // 削除位置の妥当性チェック
     if (at < 0 || at >= E.numrows) return;
     
-    // 行のメモリを解放
-    editorFreeRow(&E.row[at]);
-    // 削除位置以降の行を前にシフト
-    memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
-    
-    // シフト後の行インデックスを更新
-    for (int j = at; j < E.numrows - 1; j++) E.row[j].idx = j;
+    // 行のメモリを解放して行ロープから取り除く
+    editorFreeRow(editorRowAt(at));
+    ropeDeleteRow(at);
     
     // 行数とダーティフラグを更新
     E.numrows--;
     E.dirty++;
+
+    // 次の行の直前の行が変わるのでハイライトを無効化
+    editorSyntaxInvalidate(at);
 }
 
 /**
@@ -190,17 +537,32 @@ void editorRowInsertChar(erow *row, int at, int c) {
     // 挿入位置の調整（範囲外なら行末に）
     if (at < 0 || at > row->size) at = row->size;
     
-    // 文字配列を1バイト拡張
-    row->chars = realloc(row->chars, row->size + 2);
-    // 挿入位置以降の文字を後ろにシフト
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
-    
-    // 新しい文字を挿入
+    // 挿入位置にギャップを移動して1バイト埋める
+    rowGapReserve(row, 1);
+    rowGapMove(row, at);
+    row->chars[row->gap++] = c;
     row->size++;
-    row->chars[at] = c;
     
     // 行データを更新
-    editorUpdateRow(row);
+    rowTextChanged(row, at);
+    E.dirty++;
+}
+
+/**
+ * 行の指定位置に文字列を挿入（改行を含まないこと）
+ * ギャップを1回移動して埋めるだけで、行の残りは複製しない
+ */
+void editorRowInsertString(erow *row, int at, const char *s, size_t len) {
+    if (at < 0 || at > row->size) at = row->size;
+    if (len == 0) return;
+
+    rowGapReserve(row, len);
+    rowGapMove(row, at);
+    memcpy(&row->chars[row->gap], s, len);
+    row->gap += len;
+    row->size += len;
+
+    rowTextChanged(row, at);
     E.dirty++;
 }
 
@@ -208,30 +570,57 @@ void editorRowInsertChar(erow *row, int at, int c) {
  * 行末尾に文字列を追加
  */
 void editorRowAppendString(erow *row, char *s, size_t len) {
+    editorRowCompact(row);
+    rowDetach(row);
     // 文字配列を必要な分だけ拡張
-    row->chars = realloc(row->chars, row->size + len + 1);
+    if (row->size + (int)len + 1 > row->cap) {
+        row->cap = row->size + len + 1;
+        row->chars = realloc(row->chars, row->cap);
+    }
     // 文字列を行末に追加
+    int at = row->size;
     memcpy(&row->chars[row->size], s, len);
     row->size += len;
     row->chars[row->size] = '\0';
     
     // 行データを更新
-    editorUpdateRow(row);
+    rowTextChanged(row, at);
     E.dirty++;
 }
 
+/**
+ * 行を位置atで切り詰める（表示用データの更新は呼び出し側で行う）
+ */
+void editorRowTruncate(erow *row, int at) {
+    editorRowCompact(row);
+    rowDetach(row);
+    row->size = at;
+    row->chars[row->size] = '\0';
+}
+
 /**
  * 行の指定位置の文字を削除
  */
 void editorRowDelChar(erow *row, int at) {
-    // 削除位置の妥当性チェック
-    if (at < 0 || at >= row->size) return;
+    editorRowDelRange(row, at, at + 1);
+}
+
+/**
+ * 行の[from, to)のバイト範囲を削除
+ * マルチバイト文字や範囲選択の削除でも行の更新は1回だけ行う
+ */
+void editorRowDelRange(erow *row, int from, int to) {
+    // 削除範囲の妥当性チェック（行の範囲に収める）
+    if (from < 0) from = 0;
+    if (to > row->size) to = row->size;
+    if (from >= to) return;
     
-    // 削除位置以降の文字を前にシフト
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-    row->size--;
+    // 削除範囲の直後にギャップを移動し、ギャップを削除範囲まで広げる
+    rowGapMove(row, to);
+    row->gap = from;
+    row->size -= to - from;
     
     // 行データを更新
-    editorUpdateRow(row);
+    rowTextChanged(row, from);
     E.dirty++;
 }
\ No newline at end of file
@@ -0,0 +1,281 @@
+/**
+ * scan.c - バイト走査カーネル
+ *
+ * 大きなバッファを一括で走査する低レベル処理を提供：
+ * - 改行位置の抽出（ファイル読み込み時の行インデックス作成用）
+ * - 部分文字列の検索（検索機能用、先頭・末尾バイトでの絞り込み＋照合）
+ * - SSE2/AVX2版とスカラー版を実行時のCPU機能で切り替え
+ *
+ * エディタ状態（E）には依存しないので単体でベンチマーク可能
+ */
+
+#include "kiloe.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_HAVE_X86 1
+#endif
+
+#define SCAN_FIND_LONG 32           /* この長さ以上の検索語はHorspool法も使う */
+
+/**
+ * 改行位置抽出（スカラー版）
+ * libcのmemchrで次の改行へ移動する
+ */
+static size_t scanLineEndsScalar(const char *buf, size_t len, size_t *ends, size_t cap) {
+    size_t n = 0;
+    const char *p = buf;
+    const char *end = buf + len;
+
+    while (n < cap && p < end) {
+        p = memchr(p, '\n', end - p);
+        if (!p) break;
+        ends[n++] = p - buf;
+        p++;
+    }
+    return n;
+}
+
+/**
+ * 長い検索語用の部分文字列検索（Horspool法）
+ * 窓の末尾のバイトで次の照合位置までまとめて読み飛ばす
+ */
+static const char *scanFindHorspool(const char *hay, size_t len, const char *needle, size_t nlen) {
+    if (len < nlen) return NULL;
+    size_t skip[256];
+    for (int c = 0; c < 256; c++) skip[c] = nlen;
+    for (size_t i = 0; i + 1 < nlen; i++) skip[(unsigned char)needle[i]] = nlen - 1 - i;
+
+    unsigned char last = needle[nlen - 1];
+    for (size_t i = 0; i + nlen <= len; ) {
+        unsigned char c = hay[i + nlen - 1];
+        if (c == last && memcmp(hay + i, needle, nlen - 1) == 0) return hay + i;
+        i += skip[c];
+    }
+    return NULL;
+}
+
+/**
+ * 部分文字列検索（スカラー版）
+ * memchrで先頭バイトの候補へ移動し、残りをmemcmpで照合する
+ * 長い検索語はHorspool法の読み飛ばしの方が速い
+ */
+static const char *scanFindScalar(const char *hay, size_t len, const char *needle, size_t nlen) {
+    if (len < nlen) return NULL;
+    if (nlen >= SCAN_FIND_LONG) return scanFindHorspool(hay, len, needle, nlen);
+    const char *p = hay;
+    const char *end = hay + len - nlen + 1;  /* 照合を始められる最後の位置の次 */
+
+    while (p < end) {
+        p = memchr(p, needle[0], end - p);
+        if (!p) return NULL;
+        if (memcmp(p + 1, needle + 1, nlen - 1) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+#ifdef SCAN_HAVE_X86
+
+/**
+ * 改行位置抽出（SSE2版）
+ * 16バイトずつ比較し、ビットマスクから改行位置を取り出す
+ */
+__attribute__((target("sse2")))
+static size_t scanLineEndsSSE2(const char *buf, size_t len, size_t *ends, size_t cap) {
+    size_t n = 0;
+    size_t i = 0;
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        while (mask) {
+            if (n == cap) return n;
+            ends[n++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    size_t head = n;
+    if (n < cap) n += scanLineEndsScalar(buf + i, len - i, ends + n, cap - n);
+    // スカラー版が返した末尾部分の位置を全体の位置に補正
+    for (size_t k = head; k < n; k++) ends[k] += i;
+    return n;
+}
+
+/**
+ * 改行位置抽出（AVX2版）
+ * 64バイトを2回の比較で1つの64ビットマスクにまとめる
+ */
+__attribute__((target("avx2")))
+static size_t scanLineEndsAVX2(const char *buf, size_t len, size_t *ends, size_t cap) {
+    size_t n = 0;
+    size_t i = 0;
+    const __m256i nl = _mm256_set1_epi8('\n');
+
+    for (; i + 64 <= len; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(buf + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(buf + i + 32));
+        unsigned long long mask =
+            (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, nl)) |
+            ((unsigned long long)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, nl)) << 32);
+        while (mask) {
+            if (n == cap) return n;
+            ends[n++] = i + __builtin_ctzll(mask);
+            mask &= mask - 1;
+        }
+    }
+    size_t head = n;
+    if (n < cap) n += scanLineEndsScalar(buf + i, len - i, ends + n, cap - n);
+    // スカラー版が返した末尾部分の位置を全体の位置に補正
+    for (size_t k = head; k < n; k++) ends[k] += i;
+    return n;
+}
+
+/**
+ * 部分文字列検索（SSE2版）
+ * 16か所の候補位置について先頭バイトと末尾バイトを同時に比較し、
+ * 両方が一致した位置だけを照合する
+ * 長い検索語で照合の失敗が多すぎる入力はHorspool法に切り替える
+ */
+__attribute__((target("sse2")))
+static const char *scanFindSSE2(const char *hay, size_t len, const char *needle, size_t nlen) {
+    size_t i = 0;
+    size_t misses = 0;
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[nlen - 1]);
+
+    for (; i + nlen - 1 + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + nlen - 1));
+        unsigned int mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (memcmp(hay + pos + 1, needle + 1, nlen - 2) == 0) return hay + pos;
+            if (nlen >= SCAN_FIND_LONG && ++misses > 64 + i / 16) {
+                return scanFindHorspool(hay + i, len - i, needle, nlen);
+            }
+            mask &= mask - 1;
+        }
+    }
+    return scanFindScalar(hay + i, len - i, needle, nlen);
+}
+
+/**
+ * 部分文字列検索（AVX2版）
+ * SSE2版と同じ絞り込みを32か所ずつ行う
+ */
+__attribute__((target("avx2")))
+static const char *scanFindAVX2(const char *hay, size_t len, const char *needle, size_t nlen) {
+    size_t i = 0;
+    size_t misses = 0;
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[nlen - 1]);
+
+    for (; i + nlen - 1 + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(hay + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(hay + i + nlen - 1));
+        unsigned int mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (memcmp(hay + pos + 1, needle + 1, nlen - 2) == 0) return hay + pos;
+            if (nlen >= SCAN_FIND_LONG && ++misses > 64 + i / 16) {
+                return scanFindHorspool(hay + i, len - i, needle, nlen);
+            }
+            mask &= mask - 1;
+        }
+    }
+    return scanFindScalar(hay + i, len - i, needle, nlen);
+}
+
+#endif /* SCAN_HAVE_X86 */
+
+/* 使用中のカーネル（未選択なら最初の呼び出しで自動選択） */
+static size_t (*scanLineEndsImpl)(const char *, size_t, size_t *, size_t) = NULL;
+static const char *(*scanFindImpl)(const char *, size_t, const char *, size_t) = NULL;
+static int scanCurrent = -1;
+static pthread_once_t scanOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * 使用する走査カーネルを選択
+ * CPUが対応していないカーネルを指定した場合は-1を返す
+ */
+int scanUseKernel(int kernel) {
+    switch (kernel) {
+        case SCAN_KERNEL_SCALAR:
+            scanLineEndsImpl = scanLineEndsScalar;
+            scanFindImpl = scanFindScalar;
+            break;
+#ifdef SCAN_HAVE_X86
+        case SCAN_KERNEL_SSE2:
+            if (!__builtin_cpu_supports("sse2")) return -1;
+            scanLineEndsImpl = scanLineEndsSSE2;
+            scanFindImpl = scanFindSSE2;
+            break;
+        case SCAN_KERNEL_AVX2:
+            if (!__builtin_cpu_supports("avx2")) return -1;
+            scanLineEndsImpl = scanLineEndsAVX2;
+            scanFindImpl = scanFindAVX2;
+            break;
+#endif
+        default:
+            return -1;
+    }
+    scanCurrent = kernel;
+    return 0;
+}
+
+/**
+ * CPUが対応する最速のカーネルを選択して返す
+ */
+int scanAutoKernel() {
+    if (scanUseKernel(SCAN_KERNEL_AVX2) == 0) return scanCurrent;
+    if (scanUseKernel(SCAN_KERNEL_SSE2) == 0) return scanCurrent;
+    scanUseKernel(SCAN_KERNEL_SCALAR);
+    return scanCurrent;
+}
+
+/**
+ * 最初の走査でカーネルを選択（scanUseKernelで選択済みならそのまま使う）
+ * 検索スレッドとメインスレッドのどちらが先に呼んでも1回だけ実行する
+ */
+static void scanInitKernel() {
+    if (scanCurrent == -1) scanAutoKernel();
+}
+
+/**
+ * カーネル名を取得（ベンチマーク・テスト表示用）
+ */
+const char *scanKernelName(int kernel) {
+    switch (kernel) {
+        case SCAN_KERNEL_SCALAR: return "scalar";
+        case SCAN_KERNEL_SSE2: return "sse2";
+        case SCAN_KERNEL_AVX2: return "avx2";
+        default: return "unknown";
+    }
+}
+
+/**
+ * バッファ内の改行位置を先頭から順にendsへ書き出す
+ * 最大cap個まで書き出して個数を返す（capに達した場合は
+ * 最後の改行の次の位置から再度呼び出せば続きを得られる）
+ */
+size_t scanLineEnds(const char *buf, size_t len, size_t *ends, size_t cap) {
+    pthread_once(&scanOnce, scanInitKernel);
+    return scanLineEndsImpl(buf, len, ends, cap);
+}
+
+/**
+ * hay内で最初にneedleが現れる位置を返す（なければNULL）
+ * NUL終端を前提としないので、行をまたいだ大きなバッファも一度に走査できる
+ * 1バイトの検索語はmemchr、それ以外は選択中のカーネルで検索する
+ */
+const char *scanFind(const char *hay, size_t len, const char *needle, size_t nlen) {
+    if (nlen == 0) return hay;
+    if (len < nlen) return NULL;
+    if (nlen == 1) return memchr(hay, needle[0], len);
+    pthread_once(&scanOnce, scanInitKernel);
+    return scanFindImpl(hay, len, needle, nlen);
+}
@@ -2,88 +2,638 @@
  * search.c - 検索機能
  * 
  * テキスト検索とハイライト機能を提供：
- * - インクリメンタルサーチ
- * - 検索結果のハイライト表示
- * - 前方・後方検索
+ * - インクリメンタルサーチ（クエリが伸びた時は前回のマッチ候補だけを再確認）
+ * - 全体の走査は検索スレッドで行い、見つかったマッチを順に受け取る
+ * - 検索結果のハイライト表示（表示中の全マッチを描画時に重ねる）と「N of M」表示
+ * - 前方・後方検索（マッチ一覧を順にたどる）
+ * - 正規表現検索（Ctrl-Rで切り替え。先頭の固定文字列で候補の行を絞ってから照合）
  * - UTF-8文字対応の検索
  */
 
 #include "kiloe.h"
 
+#define SEARCH_SLICE (1 << 20)      /* 検索スレッドが中断を確認する間隔（バイト） */
+#define SEARCH_BATCH 256            /* 検索スレッドがまとめて渡すマッチ数 */
+#define SEARCH_NARROW_MAX 65536     /* 絞り込みで済ませる前回のマッチ数の上限 */
+
+/* 検索マッチ（行番号と行内のバイト位置、マッチの長さ） */
+struct searchMatch {
+    int row;
+    int cx;
+    int len;
+};
+
+/* 検索スレッドに渡すスナップショットの区間（行rowから始まる改行区切りのテキスト） */
+struct searchSegment {
+    int row;
+    const char *text;   /* ファイルマッピング内の範囲、または展開済みの1行の文字列 */
+    size_t len;
+};
+
+/* 現在の検索状態（マッチは行順・位置順に並ぶ） */
+static struct searchMatch *searchMatches = NULL;
+static int searchCount = 0;         /* マッチ数 */
+static int searchCap = 0;           /* searchMatchesの確保数 */
+static int searchCurrent = -1;      /* 現在のマッチ（なければ-1） */
+static char *searchQuery = NULL;    /* マッチ一覧を作ったクエリ */
+static int searchComplete = 1;      /* マッチ一覧が全体の走査を終えているかどうか */
+static int searchRegex = 0;         /* 正規表現モード */
+static struct regex *searchRe = NULL;   /* コンパイル済みのパターン（固定文字列で済む場合はNULL） */
+static const char *searchError = NULL;  /* パターンのコンパイルエラー */
+
+/* 検索スレッドの状態（起動から終了の確認まではメインスレッドから書き換えない） */
+static pthread_t workerThread;
+static int workerRunning = 0;                   /* スレッドを起動済みで未回収 */
+static struct searchSegment *workerSegs = NULL; /* 走査するスナップショット */
+static int workerNsegs = 0;
+static unsigned int workerSnapGen = 0;          /* スナップショットの世代（なければ0） */
+static char *workerQuery = NULL;                /* 検索語（正規表現では候補を探す先頭の固定文字列） */
+static struct regex *workerRe = NULL;           /* 正規表現（固定文字列の検索ならNULL） */
+static int workerCancel = 0;                    /* 中断要求（__atomicで読み書き） */
+
+/* 検索スレッドからメインスレッドへ渡すマッチ（workerLockで保護） */
+static pthread_mutex_t workerLock = PTHREAD_MUTEX_INITIALIZER;
+static struct searchMatch *workerPending = NULL;
+static int workerNpending = 0;
+static int workerPendingCap = 0;
+static int workerDone = 0;                      /* 走査を最後まで終えた */
+static int workerNotified = 0;                  /* 受け取られていない起床通知がある */
+
+/**
+ * マッチ一覧の末尾にマッチを追加
+ */
+static void searchAdd(int row, int cx, int len) {
+    if (searchCount == searchCap) {
+        searchCap = searchCap ? searchCap * 2 : 64;
+        searchMatches = realloc(searchMatches, sizeof(struct searchMatch) * searchCap);
+    }
+    searchMatches[searchCount].row = row;
+    searchMatches[searchCount].cx = cx;
+    searchMatches[searchCount].len = len;
+    searchCount++;
+}
+
+/**
+ * 検索スレッドで見つけたマッチをメインスレッドに渡す
+ * 最後の分を渡す時はdoneを立てる。未受け取りの通知がなければ入力待ちを起こす
+ */
+static void workerPublish(const struct searchMatch *batch, int n, int done) {
+    pthread_mutex_lock(&workerLock);
+    if (workerNpending + n > workerPendingCap) {
+        while (workerNpending + n > workerPendingCap) {
+            workerPendingCap = workerPendingCap ? workerPendingCap * 2 : SEARCH_BATCH * 4;
+        }
+        workerPending = realloc(workerPending, sizeof(struct searchMatch) * workerPendingCap);
+    }
+    memcpy(&workerPending[workerNpending], batch, sizeof(struct searchMatch) * n);
+    workerNpending += n;
+    if (done) workerDone = 1;
+    int notify = !workerNotified;
+    workerNotified = 1;
+    pthread_mutex_unlock(&workerLock);
+
+    if (notify) editorWakeup();
+}
+
+/* 検索スレッドで溜めているマッチ */
+struct workerBatch {
+    struct searchMatch m[SEARCH_BATCH];
+    int n;
+    int row;            /* 正規表現で照合中の行 */
+};
+
+/**
+ * 溜めているマッチに追加し、いっぱいになったらメインスレッドに渡す
+ */
+static void workerAdd(struct workerBatch *b, int row, int cx, int len) {
+    b->m[b->n].row = row;
+    b->m[b->n].cx = cx;
+    b->m[b->n].len = len;
+    if (++b->n == SEARCH_BATCH) {
+        workerPublish(b->m, b->n, 0);
+        b->n = 0;
+    }
+}
+
+/**
+ * regexMatchLineから呼ばれ、照合中の行のマッチを追加
+ */
+static void workerAddRegex(int start, int len, void *arg) {
+    struct workerBatch *b = arg;
+    workerAdd(b, b->row, start, len);
+}
+
+/**
+ * 正規表現で1区間を走査（中断されたら1を返す）
+ * 先頭の固定文字列があれば、scanFindでそれを含む行だけを拾って照合する
+ * 固定文字列がなければ全行を照合する。中断要求はSEARCH_SLICEバイトごとと行ごとに確認し、
+ * 長い行の照合中はregexMatchLineの中でも確認する
+ */
+static int workerRegex(const struct searchSegment *seg, struct workerBatch *b) {
+    size_t plen = strlen(workerQuery);
+    const char *end = seg->text + seg->len;
+    const char *line = seg->text;
+    const char *p = seg->text;
+    int at = seg->row;
+
+    // 展開済みの空行（空文字列にマッチするパターンのために照合する）
+    if (seg->len == 0 && !plen) {
+        b->row = at;
+        regexMatchLine(workerRe, "", 0, workerAddRegex, b);
+        return 0;
+    }
+
+    while (p < end) {
+        if (__atomic_load_n(&workerCancel, __ATOMIC_RELAXED)) return 1;
+
+        if (plen) {
+            const char *limit = (size_t)(end - p) > SEARCH_SLICE ? p + SEARCH_SLICE : end;
+            const char *wend = (size_t)(end - limit) > plen - 1 ? limit + plen - 1 : end;
+            const char *m = scanFind(p, wend - p, workerQuery, plen);
+            if (!m) {
+                p = limit;
+                continue;
+            }
+            p = m;
+        }
+
+        // pを含む行を求めて照合し、次の行から探し直す
+        const char *nl;
+        while ((nl = memchr(line, '\n', p - line))) {
+            at++;
+            line = nl + 1;
+        }
+        const char *eol = memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        int len = eol - line;
+        while (len > 0 && line[len - 1] == '\r') len--;
+        b->row = at;
+        if (regexMatchLine(workerRe, line, len, workerAddRegex, b) < 0) return 1;
+
+        if (eol == end) break;
+        at++;
+        p = line = eol + 1;
+    }
+    return 0;
+}
+
+/**
+ * 固定文字列で1区間を走査（中断されたら1を返す）
+ * scanFindで探し、改行を数えて行番号と行内の位置を求める
+ * SEARCH_SLICEバイトごとに中断要求を確認する
+ */
+static int workerLiteral(const struct searchSegment *seg, struct workerBatch *b) {
+    size_t qlen = strlen(workerQuery);
+    const char *end = seg->text + seg->len;
+    const char *line = seg->text;   /* マッチ位置を含む行の先頭 */
+    int at = seg->row;
+
+    for (const char *p = seg->text; p < end; ) {
+        if (__atomic_load_n(&workerCancel, __ATOMIC_RELAXED)) return 1;
+
+        // スライス内で始まるマッチだけを探す（末尾をまたぐマッチのためqlen-1バイト余分に見る）
+        const char *limit = (size_t)(end - p) > SEARCH_SLICE ? p + SEARCH_SLICE : end;
+        const char *wend = (size_t)(end - limit) > qlen - 1 ? limit + qlen - 1 : end;
+        for (const char *m = scanFind(p, wend - p, workerQuery, qlen); m;
+             m = scanFind(m + 1, wend - m - 1, workerQuery, qlen)) {
+            const char *nl;
+            while ((nl = memchr(line, '\n', m - line))) {
+                at++;
+                line = nl + 1;
+            }
+            workerAdd(b, at, m - line, qlen);
+        }
+        p = limit;
+    }
+    return 0;
+}
+
+/**
+ * 検索スレッド本体
+ * スナップショットの各区間を固定文字列または正規表現で走査し、見つけたマッチを順に渡す
+ */
+static void *workerMain(void *arg) {
+    (void)arg;
+    struct workerBatch b;
+    b.n = 0;
+
+    for (int i = 0; i < workerNsegs; i++) {
+        const struct searchSegment *seg = &workerSegs[i];
+        if (workerRe ? workerRegex(seg, &b) : workerLiteral(seg, &b)) return NULL;
+        // 区間の切れ目で見つかった分を渡す（先頭付近のマッチを早く表示するため）
+        if (b.n > 0) {
+            workerPublish(b.m, b.n, 0);
+            b.n = 0;
+        }
+    }
+    workerPublish(b.m, 0, 1);
+    return NULL;
+}
+
+/**
+ * 検索スレッドを回収してスナップショットを破棄
+ * 走査中なら中断させる（スレッドは1行の途中でもSEARCH_SLICEバイト程度で終了する）
+ */
+static void workerStop() {
+    if (workerRunning) {
+        __atomic_store_n(&workerCancel, 1, __ATOMIC_RELAXED);
+        pthread_join(workerThread, NULL);
+        workerRunning = 0;
+    }
+    if (workerSnapGen) editorSnapshotEnd(workerSnapGen);
+    workerSnapGen = 0;
+    free(workerSegs);
+    workerSegs = NULL;
+    workerNsegs = 0;
+    free(workerQuery);
+    workerQuery = NULL;
+    workerRe = NULL;
+
+    workerNpending = 0;
+    workerDone = 0;
+    workerNotified = 0;
+}
+
+/**
+ * スナップショットに区間を追加
+ */
+static void workerSegAdd(int *cap, int row, const char *text, size_t len) {
+    if (workerNsegs == *cap) {
+        *cap = *cap ? *cap * 2 : 64;
+        workerSegs = realloc(workerSegs, sizeof(struct searchSegment) * *cap);
+    }
+    struct searchSegment *seg = &workerSegs[workerNsegs++];
+    seg->row = row;
+    seg->text = text;
+    seg->len = len;
+}
+
+/**
+ * 現在の行を検索スレッド用のスナップショットにする
+ * 未展開のチャンクはファイルマッピングをそのまま参照し（隣り合うものは1つの区間にまとめる）、
+ * 展開済みの行は文字列を複製せずに1行ずつ参照する（費用は展開済みの行数と未展開チャンク数に比例）
+ * 参照した行にはスナップショットの世代を記録し、走査中に書き換える行はrowDetachで切り離させる
+ */
+static void workerSnapshot() {
+    int cap = 0;
+    int start;
+    workerSnapGen = editorSnapshotBegin();
+    for (struct rowChunk *c = ropeChunkAt(0, &start); c; c = ropeChunkAt(start + c->n, &start)) {
+        if (c->rows) {
+            for (int j = 0; j < c->n; j++) {
+                erow *row = &c->rows[j];
+                // ギャップを閉じてから参照する（以降は書き換えない限り動かない）
+                workerSegAdd(&cap, start + j, editorRowText(row), row->size);
+                row->snap_gen = workerSnapGen;
+            }
+            continue;
+        }
+        if (workerNsegs > 0) {
+            // 直前の未展開区間と連続していればつなげる
+            struct searchSegment *prev = &workerSegs[workerNsegs - 1];
+            if (prev->text + prev->len == c->src && prev->text[prev->len - 1] == '\n') {
+                prev->len += c->srclen;
+                continue;
+            }
+        }
+        workerSegAdd(&cap, start, c->src, c->srclen);
+    }
+}
+
+/**
+ * 全行の走査を検索スレッドで開始
+ * reを渡した場合は正規表現で照合し、queryはその先頭の固定文字列（qlenバイト）になる
+ * 前回の走査は中断し、マッチ一覧は空から作り直す
+ */
+static void workerStart(const char *query, int qlen, struct regex *re) {
+    workerStop();
+    searchCount = 0;
+    searchCurrent = -1;
+    searchComplete = 0;
+
+    workerSnapshot();
+    workerQuery = strndup(query, qlen);
+    workerRe = re;
+    workerCancel = 0;
+    if (re) regexSetCancel(re, &workerCancel);
+    editorWakeupInit();
+    if (pthread_create(&workerThread, NULL, workerMain, NULL) != 0) {
+        // スレッドを作れない場合はその場で走査する
+        workerMain(NULL);
+    } else {
+        workerRunning = 1;
+    }
+}
+
+/**
+ * 検索スレッドから届いたマッチをマッチ一覧に追加
+ * 走査を終えていればスレッドを回収する
+ */
+static void searchCollect() {
+    if (searchComplete) return;
+
+    pthread_mutex_lock(&workerLock);
+    for (int i = 0; i < workerNpending; i++) {
+        searchAdd(workerPending[i].row, workerPending[i].cx, workerPending[i].len);
+    }
+    workerNpending = 0;
+    workerNotified = 0;
+    int done = workerDone;
+    pthread_mutex_unlock(&workerLock);
+
+    if (done) {
+        workerStop();
+        searchComplete = 1;
+    }
+}
+
+/**
+ * 検索状態を破棄
+ */
+static void searchReset() {
+    workerStop();
+    searchComplete = 1;
+    free(searchMatches);
+    searchMatches = NULL;
+    searchCount = searchCap = 0;
+    searchCurrent = -1;
+    free(searchQuery);
+    searchQuery = NULL;
+    regexFree(searchRe);
+    searchRe = NULL;
+    searchError = NULL;
+    searchRegex = 0;
+}
+
+/* 絞り込みで候補の行を順に読む位置（未展開のチャンクは展開せずに元データを読む） */
+struct searchCursor {
+    struct rowChunk *c;
+    int start;          /* cの先頭行 */
+    int at;             /* pが指す行（未展開のチャンクのみ） */
+    const char *p;
+};
+
+/**
+ * 行rowの内容を取得（範囲外ならNULL）
+ * 行は昇順に渡す前提で、同じ未展開チャンク内では前回の位置から改行を数えて進む
+ */
+static const char *searchLine(struct searchCursor *cur, int row, int *len) {
+    if (!cur->c || row < cur->start || row >= cur->start + cur->c->n) {
+        cur->c = ropeChunkAt(row, &cur->start);
+        if (!cur->c) return NULL;
+        cur->at = cur->start;
+        cur->p = cur->c->src;
+    }
+    if (cur->c->rows) {
+        erow *r = &cur->c->rows[row - cur->start];
+        *len = r->size;
+        return editorRowText(r);
+    }
+    const char *end = cur->c->src + cur->c->srclen;
+    for (; cur->at < row; cur->at++) cur->p = (const char *)memchr(cur->p, '\n', end - cur->p) + 1;
+    const char *nl = memchr(cur->p, '\n', end - cur->p);
+    int n = (nl ? nl : end) - cur->p;
+    // 読み込み時と同じく行末のCRは行に含めない
+    while (n > 0 && cur->p[n - 1] == '\r') n--;
+    *len = n;
+    return cur->p;
+}
+
+/**
+ * 前回のマッチ一覧をクエリで絞り込む
+ * 伸ばしたクエリのマッチは必ず前回のクエリのマッチでもあるので、候補の位置だけを確認すればよい
+ * 未展開のチャンクにある候補は展開せずにファイルマッピングの内容で確認する
+ * 現在のマッチは、元の位置以降で残った最初のマッチに移す
+ */
+static void searchNarrow(const char *query) {
+    int qlen = strlen(query);
+    int kept = 0;
+    int current = -1;
+    struct searchCursor cur = {NULL, 0, 0, NULL};
+    for (int i = 0; i < searchCount; i++) {
+        struct searchMatch m = searchMatches[i];
+        int len;
+        const char *text = searchLine(&cur, m.row, &len);
+        if (!text || len - m.cx < qlen || memcmp(&text[m.cx], query, qlen) != 0) continue;
+        if (current == -1 && i >= searchCurrent) current = kept;
+        m.len = qlen;
+        searchMatches[kept++] = m;
+    }
+    searchCount = kept;
+    searchCurrent = current == -1 && kept ? 0 : current;
+}
+
+/**
+ * 正規表現をコンパイルして走査を開始
+ * パターン全体が固定文字列なら通常の検索と同じ走査で済ませる
+ * コンパイルできなければエラーを記録し、マッチ一覧を空にする
+ */
+static void searchStartRegex(const char *query) {
+    // 検索スレッドが使っているパターンは止めてから解放する
+    workerStop();
+    regexFree(searchRe);
+    searchRe = regexCompile(query, &searchError);
+    if (!searchRe) {
+        searchComplete = 1;
+        searchCount = 0;
+        searchCurrent = -1;
+        return;
+    }
+    searchError = NULL;
+
+    int len, literal;
+    const char *prefix = regexPrefix(searchRe, &len, &literal);
+    if (literal && len > 0) {
+        workerStart(prefix, len, NULL);
+        regexFree(searchRe);
+        searchRe = NULL;
+    } else {
+        workerStart(prefix, len, searchRe);
+    }
+}
+
+/**
+ * クエリの変化に合わせてマッチ一覧を更新
+ * 前回のクエリを伸ばしただけで、その走査が終わっていてマッチが多すぎなければ絞り込む
+ * それ以外は走査中の検索を中断し、検索スレッドで全行を走査し直す
+ * 正規表現モードでは絞り込めない（伸ばしたパターンのマッチが前回のマッチとは限らない）
+ */
+static void searchUpdate(const char *query) {
+    if (searchQuery && strcmp(query, searchQuery) == 0) return;
+
+    if (query[0] == '\0') {
+        workerStop();
+        searchComplete = 1;
+        searchCount = 0;
+        searchCurrent = -1;
+        searchError = NULL;
+    } else if (searchRegex) {
+        searchStartRegex(query);
+    } else if (searchComplete && searchCount <= SEARCH_NARROW_MAX &&
+               searchQuery && searchQuery[0] && strncmp(query, searchQuery, strlen(searchQuery)) == 0) {
+        searchNarrow(query);
+    } else {
+        workerStart(query, strlen(query), NULL);
+    }
+
+    free(searchQuery);
+    searchQuery = strdup(query);
+}
+
+/**
+ * 行内でcxが指すバイトを1つ進め、render内のバイト位置idxと表示列colを更新
+ * タブはrender上で次のタブストップまでの空白になる
+ */
+static void searchRenderStep(const char *chars, int cx, int *idx, int *col) {
+    if (chars[cx] == '\t') {
+        int n = KILO_TAB_STOP - *col % KILO_TAB_STOP;
+        *idx += n;
+        *col += n;
+    } else {
+        (*idx)++;
+        if (!is_utf8_continuation((unsigned char)chars[cx])) *col += get_char_width((char *)chars, cx);
+    }
+}
+
+/**
+ * 行filerowの最初のマッチの添字を二分探索（なければsearchCount）
+ */
+static int searchFirstInRow(int filerow) {
+    int lo = 0, hi = searchCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (searchMatches[mid].row < filerow) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * 表示する行のハイライトにマッチのハイライトを重ねた配列を返す
+ * 行のhlは書き換えず、マッチがある行だけ使い回しの作業領域に重ねる
+ * （マッチがなければrow->hlをそのまま返す）
+ * 描画する行ごとに呼ばれ、費用は二分探索とその行の長さ分だけ
+ */
+const unsigned char *editorFindHighlight(int filerow, erow *row) {
+    static unsigned char *overlay = NULL;  /* 作業領域（大きくなる時だけ確保し直す） */
+    static int overlaycap = 0;
+
+    int i = searchFirstInRow(filerow);
+    if (!searchQuery || row->rsize == 0 || i == searchCount || searchMatches[i].row != filerow) return row->hl;
+
+    if (row->rsize > overlaycap) {
+        overlaycap = row->rsize * 2;
+        overlay = realloc(overlay, overlaycap);
+    }
+    memcpy(overlay, row->hl, row->rsize);
+
+    // マッチは位置順に並ぶので、行頭から1回歩くだけでrender上の位置に変換できる
+    const char *chars = editorRowText(row);
+    int j = 0, idx = 0, col = 0;
+    for (; i < searchCount && searchMatches[i].row == filerow; i++) {
+        int cx = searchMatches[i].cx;
+        int end = cx + searchMatches[i].len;
+        if (end > row->size) end = row->size;
+        for (; j < cx && j < row->size; j++) searchRenderStep(chars, j, &idx, &col);
+        int start = idx;
+        // 重なり合うマッチでは既に歩いた位置から続ける
+        int k = j, kidx = idx, kcol = col;
+        for (; k < end; k++) searchRenderStep(chars, k, &kidx, &kcol);
+        if (kidx > row->rsize) kidx = row->rsize;
+        if (start < kidx) memset(&overlay[start], HL_MATCH, kidx - start);
+    }
+    return overlay;
+}
+
+/**
+ * ステータスバー用の「N of M」表示を作成
+ * 走査中は受け取り済みのマッチ数の後に「+」を付ける
+ * 正規表現モードでは「(regex)」を付け、パターンが不正ならその理由を表示する
+ * 
+ * @return: 書き込んだ長さ（検索中でなければ0）
+ */
+int editorFindStatus(char *buf, int size) {
+    buf[0] = '\0';
+    if (!searchQuery || !searchQuery[0]) return 0;
+    int len;
+    if (searchError) {
+        len = snprintf(buf, size, "regex: %s", searchError);
+    } else {
+        len = snprintf(buf, size, "%d of %d%s%s", searchCurrent + 1, searchCount,
+                       searchComplete ? "" : "+", searchRegex ? " (regex)" : "");
+    }
+    return len < size ? len : size - 1;
+}
+
 /**
  * 検索コールバック関数
  * ユーザーの入力に応じてリアルタイムで検索を実行
+ * マッチのハイライトは描画時に重ねるので、ここでは行のハイライトに触れない
  */
 void editorFindCallback(char *query, int key) {
-    static int last_match = -1;    // 最後にマッチした行のインデックス
-    static int direction = 1;      // 検索方向（1: 順方向、-1: 逆方向）
-    
-    static int saved_hl_line;      // ハイライト保存用の行番号
-    static char *saved_hl = NULL;  // ハイライト保存用バッファ
-
-    // 前回のハイライトを復元
-    if (saved_hl) {
-        memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-        free(saved_hl);
-        saved_hl = NULL;
-    }
+    // 検索スレッドから届いたマッチを受け取る
+    searchCollect();
 
     // キー入力による動作制御
     if (key == '\r' || key == ESC) {
         // Enter または ESC で検索終了
-        last_match = -1;
-        direction = 1;
+        searchReset();
         return;
     } else if (key == ARROW_RIGHT || key == ARROW_DOWN) {
-        // 右矢印・下矢印で次を検索
-        direction = 1;
+        // 右矢印・下矢印で次のマッチへ
+        if (searchCount) searchCurrent = (searchCurrent + 1) % searchCount;
     } else if (key == ARROW_LEFT || key == ARROW_UP) {
-        // 左矢印・上矢印で前を検索
-        direction = -1;
+        // 左矢印・上矢印で前のマッチへ
+        if (searchCount) searchCurrent = (searchCurrent + searchCount - 1) % searchCount;
+    } else if (key == CTRL_KEY('r')) {
+        // Ctrl-Rで正規表現モードを切り替え、同じクエリで走査し直す
+        workerStop();
+        regexFree(searchRe);
+        searchRe = NULL;
+        searchError = NULL;
+        searchRegex = !searchRegex;
+        free(searchQuery);
+        searchQuery = NULL;
+        searchCount = 0;
+        searchCurrent = -1;
+        searchComplete = 1;
+        searchUpdate(query);
+    } else if (key == WAKEUP) {
+        // 走査中に最初のマッチが届いたらそこへ移動（それ以外はカーソルを動かさない）
+        if (searchCurrent >= 0 || !searchCount) return;
+        searchCurrent = 0;
     } else {
-        // 文字入力時は新規検索開始
-        last_match = -1;
-        direction = 1;
-    }
-
-    // 検索開始位置の設定
-    if (last_match == -1) direction = 1;
-    int current = last_match;
-
-    // 全行を検索
-    int i;
-    for (i = 0; i < E.numrows; i++) {
-        current += direction;
-        // 循環検索（最後の行の次は最初の行）
-        if (current == -1) current = E.numrows - 1;
-        else if (current == E.numrows) current = 0;
-
-        erow *row = &E.row[current];
-        
-        // UTF-8対応：charsバッファ内で検索
-        char *chars_match = strstr(row->chars, query);
-        if (chars_match) {
-            last_match = current;
-            E.cy = current;
-            // カーソル位置をマッチ位置に設定（バイト位置）
-            E.cx = chars_match - row->chars;
-            // 画面をマッチした行まで移動
-            E.rowoff = E.numrows;
-
-            // ハイライト表示用：renderバッファでもマッチ位置を検索
-            char *render_match = strstr(row->render, query);
-            if (render_match) {
-                // 現在のハイライト状態を保存
-                saved_hl_line = current;
-                saved_hl = malloc(row->rsize);
-                memcpy(saved_hl, row->hl, row->rsize);
-
-                // 検索結果をハイライト
-                memset(&row->hl[render_match - row->render], HL_MATCH, strlen(query));
-            }
-            break;
-        }
+        // 文字入力時はマッチ一覧を更新
+        searchUpdate(query);
     }
+
+    if (searchCurrent < 0) return;
+
+    struct searchMatch m = searchMatches[searchCurrent];
+    E.cy = m.row;
+    // カーソル位置をマッチ位置に設定（バイト位置）
+    E.cx = m.cx;
+    // 画面をマッチした行まで移動
+    E.rowoff = E.numrows;
+}
+
+/**
+ * 現在のマッチ数を取得（走査中なら受け取り済みの数）
+ */
+int editorFindMatchCount() {
+    return searchCount;
+}
+
+/**
+ * 検索スレッドの走査が終わるまで待ち、全てのマッチを受け取る
+ * 結果を確定させたい場合（テストなど）に使う
+ */
+void editorFindWait() {
+    if (workerRunning) {
+        pthread_join(workerThread, NULL);
+        workerRunning = 0;
+    }
+    if (searchQuery) editorFindCallback(searchQuery, WAKEUP);
 }
 
 /**
@@ -98,7 +648,7 @@ void editorFind() {
     int saved_rowoff = E.rowoff;
 
     // 検索プロンプトを表示（コールバック付き）
-    char *query = editorPrompt("Search: %s (ESC/Arrows/Enter)", editorFindCallback);
+    char *query = editorPrompt("Search: %s (ESC/Arrows/Enter/^R regex)", editorFindCallback);
     
     if (query) {
         // 検索が実行された場合はメモリを解放
@@ -110,4 +660,4 @@ void editorFind() {
         E.coloff = saved_coloff;
         E.rowoff = saved_rowoff;
     }
-}
\ No newline at end of file
+}
@@ -15,21 +15,105 @@ int is_separator(int c) {
     return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
 }
 
+/* コンパイル済みキーワード表のエントリ */
+struct keywordEntry {
+    const char *word;      /* キーワード（末尾の|は含めない長さで比較） */
+    int len;               /* キーワード長 */
+    unsigned char hl;      /* HL_KEYWORD1またはHL_KEYWORD2 */
+};
+
+/* 使用中のシンタックス定義から作ったキーワード表（開番地法のハッシュ表） */
+static struct editorSyntax *kwSyntax = NULL;
+static struct keywordEntry *kwTable = NULL;
+static unsigned int kwMask = 0;
+
 /**
- * 行のシンタックスハイライトを更新
- * 各行のテキストを解析してキーワード、コメント、文字列、数値をハイライト
+ * キーワード照合用のハッシュ関数（FNV-1a）
  */
-void editorUpdateSyntax(erow *row) {
-    // ハイライト情報配列をrender配列と同じサイズに再割り当て
-    row->hl = realloc(row->hl, row->rsize);
-    // 全体をHL_NORMAL（通常テキスト）で初期化
-    memset(row->hl, HL_NORMAL, row->rsize);
+static unsigned int keywordHash(const char *s, int len) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
 
-    // シンタックス定義がない場合は処理終了
-    if (E.syntax == NULL) return;
+/**
+ * シンタックス定義のキーワードリストをハッシュ表にまとめる
+ * 長さと種別（末尾の|）はここで一度だけ求める
+ * 同じ綴りが複数ある場合はリストで先にあるものを使う
+ */
+static void syntaxCompileKeywords(struct editorSyntax *syntax) {
+    free(kwTable);
+    kwTable = NULL;
+    kwMask = 0;
+    kwSyntax = syntax;
+    if (syntax == NULL || syntax->keywords == NULL) return;
+
+    int count = 0;
+    while (syntax->keywords[count]) count++;
+
+    // 負荷率が1/2以下になる2の冪のサイズを確保
+    unsigned int size = 8;
+    while (size < (unsigned int)count * 2) size <<= 1;
+    kwTable = calloc(size, sizeof(struct keywordEntry));
+    kwMask = size - 1;
+
+    for (int j = 0; j < count; j++) {
+        const char *word = syntax->keywords[j];
+        int len = strlen(word);
+        int kw2 = len > 0 && word[len - 1] == '|';
+        if (kw2) len--;
+        if (len == 0) continue;
+
+        unsigned int h = keywordHash(word, len) & kwMask;
+        while (kwTable[h].word) {
+            if (kwTable[h].len == len && !memcmp(kwTable[h].word, word, len)) break;
+            h = (h + 1) & kwMask;
+        }
+        if (kwTable[h].word) continue;
+        kwTable[h].word = word;
+        kwTable[h].len = len;
+        kwTable[h].hl = kw2 ? HL_KEYWORD2 : HL_KEYWORD1;
+    }
+}
+
+/**
+ * 位置textから始まる単語がキーワードかどうかを判定
+ * 単語（次のセパレータまで）を1回走査してハッシュを求め、表を引く
+ * キーワードならその長さを返し、hl_typeに種別を書き込む。キーワードでなければ0
+ */
+static int syntaxMatchKeyword(const char *text, int len, unsigned char *hl_type) {
+    if (kwSyntax != E.syntax) syntaxCompileKeywords(E.syntax);
+    if (kwTable == NULL) return 0;
+
+    // キーワードはセパレータを含まないので、照合対象は次のセパレータまでの単語
+    unsigned int h = 2166136261u;
+    int wlen = 0;
+    while (wlen < len && !is_separator(text[wlen])) {
+        h ^= (unsigned char)text[wlen];
+        h *= 16777619u;
+        wlen++;
+    }
+    if (wlen == 0) return 0;
+
+    for (h &= kwMask; kwTable[h].word; h = (h + 1) & kwMask) {
+        if (kwTable[h].len == wlen && !memcmp(kwTable[h].word, text, wlen)) {
+            *hl_type = kwTable[h].hl;
+            return wlen;
+        }
+    }
+    return 0;
+}
 
+/**
+ * 1行分のテキストを解析してハイライトを書き込む
+ * in_commentは前行から続く複数行コメント状態、戻り値は行末での状態
+ * hlがNULLの場合はコメント状態の計算だけを行う（キーワード・数値は状態に影響しないので省略）
+ */
+static int syntaxHighlightLine(const char *text, int len, unsigned char *hl, int in_comment) {
     // シンタックス定義から各種設定を取得
-    char **keywords = E.syntax->keywords;
     char *scs = E.syntax->singleline_comment_start;    // 単行コメント開始文字
     char *mcs = E.syntax->multiline_comment_start;     // 複数行コメント開始文字
     char *mce = E.syntax->multiline_comment_end;       // 複数行コメント終了文字
@@ -41,19 +125,17 @@ void editorUpdateSyntax(erow *row) {
     // 解析状態の初期化
     int prev_sep = 1;      // 直前がセパレータかどうか（行頭はセパレータ扱い）
     int in_string = 0;     // 文字列リテラル内かどうか（0=文字列外、'"'=ダブルクォート内、'\''=シングルクォート内）
-    // 前行から続く複数行コメント内かどうかを判定
-    int in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
 
     int i = 0;
-    while (i < row->rsize) {
-        char c = row->render[i];
-        unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
+    while (i < len) {
+        char c = text[i];
+        unsigned char prev_hl = (hl && i > 0) ? hl[i - 1] : HL_NORMAL;
 
         // 単行コメントの処理
         if (scs_len && !in_string && !in_comment) {
-            if (!strncmp(&row->render[i], scs, scs_len)) {
+            if (i + scs_len <= len && !memcmp(&text[i], scs, scs_len)) {
                 // 単行コメント開始文字が見つかった場合、行末まで全てコメント
-                memset(&row->hl[i], HL_COMMENT, row->rsize - i);
+                if (hl) memset(&hl[i], HL_COMMENT, len - i);
                 break;
             }
         }
@@ -62,18 +144,21 @@ void editorUpdateSyntax(erow *row) {
         if (mcs_len && mce_len && !in_string) {
             if (in_comment) {
                 // 既に複数行コメント内の場合
-                row->hl[i] = HL_MLCOMMENT;
+                if (hl) hl[i] = HL_MLCOMMENT;
                 // 複数行コメント終了文字をチェック
-                if (!strncmp(&row->render[i], mce, mce_len)) {
-                    memset(&row->hl[i], HL_MLCOMMENT, mce_len);
+                if (i + mce_len <= len && !memcmp(&text[i], mce, mce_len)) {
+                    if (hl) memset(&hl[i], HL_MLCOMMENT, mce_len);
                     i += mce_len;
                     in_comment = 0;
                     prev_sep = 1;
                     continue;
                 }
-            } else if (!strncmp(&row->render[i], mcs, mcs_len)) {
+                // コメント内の文字はキーワード等として扱わない
+                i++;
+                continue;
+            } else if (i + mcs_len <= len && !memcmp(&text[i], mcs, mcs_len)) {
                 // 複数行コメント開始文字が見つかった場合
-                memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
+                if (hl) memset(&hl[i], HL_MLCOMMENT, mcs_len);
                 i += mcs_len;
                 in_comment = 1;
                 continue;
@@ -84,10 +169,10 @@ void editorUpdateSyntax(erow *row) {
         if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
             if (in_string) {
                 // 文字列リテラル内の場合
-                row->hl[i] = HL_STRING;
+                if (hl) hl[i] = HL_STRING;
                 // エスケープシーケンスの処理
-                if (c == '\\' && i + 1 < row->rsize) {
-                    row->hl[i + 1] = HL_STRING;
+                if (c == '\\' && i + 1 < len) {
+                    if (hl) hl[i + 1] = HL_STRING;
                     i += 2;
                     continue;
                 }
@@ -100,20 +185,26 @@ void editorUpdateSyntax(erow *row) {
                 // 文字列開始文字（"または'）をチェック
                 if (c == '"' || c == '\'') {
                     in_string = c;
-                    row->hl[i] = HL_STRING;
+                    if (hl) hl[i] = HL_STRING;
                     i++;
                     continue;
                 }
             }
         }
 
+        // 状態計算のみの場合、数値とキーワードは判定不要
+        if (!hl) {
+            i++;
+            continue;
+        }
+
         // 数値リテラルの処理
         if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
             if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) || 
                 (c == '.' && prev_hl == HL_NUMBER)) {
                 // 数字かつ直前がセパレータまたは数値の場合、または
                 // ドットかつ直前が数値の場合（小数点）
-                row->hl[i] = HL_NUMBER;
+                hl[i] = HL_NUMBER;
                 i++;
                 prev_sep = 0;
                 continue;
@@ -123,23 +214,11 @@ void editorUpdateSyntax(erow *row) {
         // キーワードの処理
         if (prev_sep) {
             // 直前がセパレータの場合のみキーワードチェック
-            int j;
-            for (j = 0; keywords[j]; j++) {
-                int klen = strlen(keywords[j]);
-                // キーワードの末尾に|がある場合はキーワード2（型名など）
-                int kw2 = keywords[j][klen - 1] == '|';
-                if (kw2) klen--;
-
-                // キーワードとのマッチングをチェック
-                if (!strncmp(&row->render[i], keywords[j], klen) && 
-                    is_separator(row->render[i + klen])) {
-                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
-                    i += klen;
-                    break;
-                }
-            }
-            // キーワードが見つかった場合は次の文字へ
-            if (keywords[j] != NULL) {
+            unsigned char kw_hl;
+            int klen = syntaxMatchKeyword(&text[i], len - i, &kw_hl);
+            if (klen) {
+                memset(&hl[i], kw_hl, klen);
+                i += klen;
                 prev_sep = 0;
                 continue;
             }
@@ -150,11 +229,165 @@ void editorUpdateSyntax(erow *row) {
         i++;
     }
 
-    // 複数行コメント状態の変化をチェックし、次行に影響する場合は更新
-    int changed = (row->hl_open_comment != in_comment);
-    row->hl_open_comment = in_comment;
-    if (changed && row->idx + 1 < E.numrows) {
-        editorUpdateSyntax(&E.row[row->idx + 1]);
+    return in_comment;
+}
+
+/**
+ * 行の直前の複数行コメント状態を取得
+ * 前のチャンクが未展開ならチャンク単位で記録した状態を使う
+ */
+static int syntaxStateBefore(erow *row) {
+    erow *prev = ropePeekPrev(row);
+    if (prev) return prev->hl_open_comment;
+    if (row != row->chunk->rows) return 0;
+    struct rowChunk *c = ropeChunkPrev(row->chunk);
+    return c ? c->hl_open_comment : 0;
+}
+
+/**
+ * 未展開チャンクの元データを走査して末尾のコメント状態を計算
+ * 行を展開せずに状態だけを求める
+ */
+static int syntaxScanChunk(struct rowChunk *c, int in_comment) {
+    const char *p = c->src;
+    const char *end = c->src + c->srclen;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *eol = nl ? nl : end;
+        int len = eol - p;
+        while (len > 0 && p[len - 1] == '\r') len--;
+        in_comment = syntaxHighlightLine(p, len, NULL, in_comment);
+        p = nl ? nl + 1 : end;
+    }
+    return in_comment;
+}
+
+/**
+ * 行atへの入力コメント状態を取得（チャンクは展開しない）
+ * at-1行目までの状態が確定している必要がある
+ */
+static int syntaxStateAt(int at) {
+    if (at == 0) return 0;
+    int start;
+    struct rowChunk *c = ropeChunkAt(at - 1, &start);
+    if (c->rows) return c->rows[at - 1 - start].hl_open_comment;
+    return c->hl_open_comment;
+}
+
+/**
+ * 入力状態in_commentに対して行のコメント状態が確定済みかどうか
+ * 確定済みなら行末の状態も以前と変わらない
+ */
+static int syntaxRowSettled(erow *row, int in_comment) {
+    return row->hl_gen == E.hl_gen && row->hl_dirty != HL_ROW_DIRTY &&
+           row->hl_prev_comment == in_comment;
+}
+
+/**
+ * 表示範囲外の行のコメント状態だけを計算
+ * ハイライト配列は表示されるまで計算しない
+ */
+static void syntaxUpdateState(erow *row, int in_comment) {
+    editorRowEnsureRender(row);
+    row->hl_open_comment = E.syntax ? syntaxHighlightLine(row->render, row->rsize, NULL, in_comment) : 0;
+    row->hl_prev_comment = in_comment;
+    row->hl_dirty = HL_ROW_STALE;
+    row->hl_gen = E.hl_gen;
+}
+
+/**
+ * 行のシンタックスハイライトを更新
+ * 前行の行末状態から1行分だけを計算する（後続行への伝播はeditorSyntaxEnsureが行う）
+ */
+void editorUpdateSyntax(erow *row) {
+    int in_comment = syntaxStateBefore(row);
+    editorRowEnsureRender(row);
+
+    // ハイライト情報配列をrender配列と同じサイズに再割り当て
+    row->hl = realloc(row->hl, row->rsize);
+    // 全体をHL_NORMAL（通常テキスト）で初期化
+    memset(row->hl, HL_NORMAL, row->rsize);
+
+    row->hl_prev_comment = in_comment;
+    row->hl_dirty = 0;
+    row->hl_gen = E.hl_gen;
+
+    // シンタックス定義がない場合は処理終了
+    if (E.syntax == NULL) {
+        row->hl_open_comment = 0;
+        return;
+    }
+
+    row->hl_open_comment = syntaxHighlightLine(row->render, row->rsize, row->hl, in_comment);
+}
+
+/**
+ * 行atのテキストが変わったことを記録
+ * 確定範囲をatまで戻し、atを含むチャンクに再計算が必要な印を付ける
+ */
+void editorSyntaxInvalidate(int at) {
+    if (at < E.hl_frontier) E.hl_frontier = at;
+    if (at < E.numrows) {
+        int start;
+        ropeChunkAt(at, &start)->hl_stale = 1;
+    }
+}
+
+/**
+ * 行[first, last)のハイライトを必要な分だけ計算
+ * 確定範囲をlastまで進める。前行からの状態が以前と同じで変更もない行・チャンクは
+ * 後続の状態も変わらないので読み飛ばす（伝播は状態が一致した所で止まる）。
+ * 表示範囲より前の行は状態だけを計算し、未展開チャンクは展開せずに元データを走査する
+ */
+void editorSyntaxEnsure(int first, int last) {
+    if (last > E.numrows) last = E.numrows;
+
+    while (E.hl_frontier < last) {
+        int at = E.hl_frontier;
+        int start;
+        struct rowChunk *c = ropeChunkAt(at, &start);
+        int in_comment = syntaxStateAt(at);
+        int end = start + c->n;
+
+        if (at == start && end <= first) {
+            // 表示範囲外のチャンク全体：変更がなく入力状態も同じなら丸ごと読み飛ばす
+            if (!c->hl_stale && c->hl_gen == E.hl_gen && c->hl_in_comment == in_comment) {
+                E.hl_frontier = end;
+                continue;
+            }
+            if (!c->rows) {
+                // 未展開チャンク：コメント状態だけを求める
+                c->hl_open_comment = E.syntax ? syntaxScanChunk(c, in_comment) : 0;
+                c->hl_in_comment = in_comment;
+                c->hl_gen = E.hl_gen;
+                c->hl_stale = 0;
+                E.hl_frontier = end;
+                continue;
+            }
+        }
+
+        erow *row = editorRowAt(at);
+        if (at < first) {
+            if (!syntaxRowSettled(row, in_comment)) syntaxUpdateState(row, in_comment);
+        } else if (!syntaxRowSettled(row, in_comment) || row->hl_dirty != HL_ROW_CLEAN) {
+            editorUpdateSyntax(row);
+        }
+        E.hl_frontier++;
+
+        if (E.hl_frontier == end) {
+            // チャンク内の全行が確定した
+            c->hl_in_comment = c->rows[0].hl_prev_comment;
+            c->hl_open_comment = c->rows[c->n - 1].hl_open_comment;
+            c->hl_gen = E.hl_gen;
+            c->hl_stale = 0;
+        }
+    }
+
+    // 以前に状態だけを計算した行が表示範囲に入った場合はハイライト配列を計算
+    for (int at = first < 0 ? 0 : first; at < last; at++) {
+        erow *row = editorRowAt(at);
+        if (row->hl_dirty != HL_ROW_CLEAN) editorUpdateSyntax(row);
     }
 }
 
@@ -204,19 +437,17 @@ void editorSelectSyntaxHighlight() {
                 
                 // マッチした場合、シンタックス定義を設定
                 E.syntax = s;
-                
-                
-
-                // 全行のシンタックスハイライトを更新
-                int filerow;
-                for (filerow = 0; filerow < E.numrows; filerow++) {
-                    editorUpdateSyntax(&E.row[filerow]);
-                }
-
-                return;
+                break;
             }
             i++;
         }
+        if (E.syntax) break;
     }
-    
-}
\ No newline at end of file
+
+    // キーワード表を作り直す
+    syntaxCompileKeywords(E.syntax);
+
+    // 世代を進めて全行のハイライトを無効化（再計算は表示時に行う）
+    E.hl_gen++;
+    E.hl_frontier = 0;
+}
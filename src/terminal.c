@@ -9,6 +9,15 @@
 
 /* グローバル変数はmain.cで定義 */
 
+/* キー入力のリングバッファ（端末から読み込み済みでキーに変換していないバイト列） */
+#define INPUT_BUF_SIZE 8192  /* 2のべき乗 */
+static char inputBuf[INPUT_BUF_SIZE];
+static unsigned int inputHead = 0;  /* 次に取り出す位置 */
+static unsigned int inputTail = 0;  /* 次に書き込む位置 */
+
+/* 別スレッドからキー入力待ちを起こすためのパイプ（未作成なら-1） */
+static int wakeFds[2] = {-1, -1};
+
 /**
  * die - エラー時の緊急終了処理
  * @s: エラーメッセージ
@@ -28,6 +37,8 @@ void die(const char *s) {
  * プログラム終了時に自動的に呼ばれ、端末を通常モードに復帰させる
  */
 void disableRawMode() {
+  // 貼り付けの通知（bracketed paste）を無効化
+  write(STDOUT_FILENO, "\x1b[?2004l", 8);
   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1) {
     die("tcsetattr");
   }
@@ -67,6 +78,176 @@ void enableRawMode() {
   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) {
     die("tcsetattr");
   }
+
+  // 貼り付けをESC[200~ とESC[201~ で囲んで通知させる（bracketed paste）
+  write(STDOUT_FILENO, "\x1b[?2004h", 8);
+}
+
+/**
+ * inputFill - 端末から読めるだけリングバッファに読み込む
+ * 
+ * 1回のread(2)でバッファの空きにまとめて読み込む
+ * 入力がなければVTIMEの時間だけ待つ
+ * 
+ * @return: 読み込んだバイト数（タイムアウト時は0）
+ */
+static int inputFill() {
+  unsigned int used = inputTail - inputHead;
+  if (used == INPUT_BUF_SIZE) return 0;
+
+  // 末尾で折り返さない連続した空き領域に読み込む
+  unsigned int pos = inputTail & (INPUT_BUF_SIZE - 1);
+  unsigned int space = INPUT_BUF_SIZE - used;
+  if (space > INPUT_BUF_SIZE - pos) space = INPUT_BUF_SIZE - pos;
+
+  ssize_t nread = read(STDIN_FILENO, &inputBuf[pos], space);
+  if (nread == -1) {
+    if (errno != EAGAIN && errno != EINTR) die("read");
+    return 0;
+  }
+  inputTail += nread;
+  return nread;
+}
+
+/**
+ * inputGet - リングバッファから1バイト取り出す
+ * @c: 読み取ったバイトを格納するポインタ
+ * 
+ * バッファが空なら端末から読み込む
+ * 
+ * @return: 成功時0、タイムアウト時-1
+ */
+static int inputGet(char *c) {
+  if (inputHead == inputTail && inputFill() == 0) return -1;
+  *c = inputBuf[inputHead++ & (INPUT_BUF_SIZE - 1)];
+  return 0;
+}
+
+/**
+ * inputPeek - リングバッファのiバイト先を取り出さずに参照
+ * @i: 先頭からのオフセット
+ * 
+ * 必要なバイトがまだ届いていなければ端末から読み込む
+ * 
+ * @return: 参照したバイト（タイムアウト時は-1）
+ */
+static int inputPeek(unsigned int i) {
+  while (inputTail - inputHead <= i) {
+    if (inputFill() == 0) return -1;
+  }
+  return (unsigned char)inputBuf[(inputHead + i) & (INPUT_BUF_SIZE - 1)];
+}
+
+/**
+ * editorWakeupInit - キー入力待ちを起こすためのパイプを作成
+ * 
+ * 別スレッドを起動する前にメインスレッドから呼ぶ（作成済みなら何もしない）
+ * 書き込み側は非ブロッキングにし、通知が溜まっても書き込んだスレッドは止まらない
+ * 
+ * @return: 成功時0、失敗時-1
+ */
+int editorWakeupInit() {
+  if (wakeFds[0] != -1) return 0;
+  if (pipe(wakeFds) == -1) {
+    wakeFds[0] = wakeFds[1] = -1;
+    return -1;
+  }
+  fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+  return 0;
+}
+
+/**
+ * editorWakeup - キー入力待ちを起こす
+ * 
+ * どのスレッドからでも呼べる。待っているeditorReadKeyはWAKEUPを返す
+ */
+void editorWakeup() {
+  if (wakeFds[1] != -1) write(wakeFds[1], "", 1);
+}
+
+/**
+ * editorWakeupDrain - 溜まっている起床通知を捨てる
+ */
+void editorWakeupDrain() {
+  char buf[64];
+  if (wakeFds[0] == -1) return;
+  while (read(wakeFds[0], buf, sizeof(buf)) > 0);
+}
+
+/**
+ * inputWait - キー入力か起床通知が届くまで待つ
+ * 
+ * 両方届いている場合はキー入力を優先する
+ * 
+ * @return: 起床通知なら1、それ以外は0
+ */
+static int inputWait() {
+  struct pollfd pfd[2] = {{STDIN_FILENO, POLLIN, 0}, {wakeFds[0], POLLIN, 0}};
+  int n = wakeFds[0] == -1 ? 1 : 2;
+  if (poll(pfd, n, -1) <= 0) return 0;
+  if (pfd[0].revents) return 0;
+  if (n == 2 && (pfd[1].revents & POLLIN)) {
+    editorWakeupDrain();
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * editorKeysPending - 処理待ちのキー入力があるかどうか
+ * 
+ * バッファが空の場合は待たずに端末を確認し、届いている入力を読み込む
+ * 貼り付けなどでまとめて届いたキーを画面更新なしで続けて処理するために使う
+ * 
+ * @return: 入力があれば1、なければ0
+ */
+int editorKeysPending() {
+  if (inputHead != inputTail) return 1;
+
+  struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+  if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN)) return 0;
+  return inputFill() > 0;
+}
+
+/**
+ * editorReadPaste - 貼り付けられた文字列を終了シーケンスまで読み取る
+ * @len: 読み取ったバイト数を格納するポインタ
+ * 
+ * editorReadKeyがPASTE_STARTを返した後に呼び、ESC[201~ までの内容をまとめて返す
+ * リングバッファの連続領域ごとにコピーするので1バイトずつのキー変換は行わない
+ * 入力が途切れた（タイムアウトした）場合はそこまでの内容を返す
+ * 
+ * @return: 貼り付けられた文字列（呼び出し側で解放、空ならNULL）
+ */
+char *editorReadPaste(int *len) {
+  static const char end_seq[] = "\x1b[201~";
+  struct abuf ab = ABUF_INIT;
+
+  while (inputHead != inputTail || inputFill() > 0) {
+    // 折り返さない連続領域のうち、ESCの手前までをまとめてコピー
+    unsigned int pos = inputHead & (INPUT_BUF_SIZE - 1);
+    unsigned int avail = inputTail - inputHead;
+    if (avail > INPUT_BUF_SIZE - pos) avail = INPUT_BUF_SIZE - pos;
+    char *esc = memchr(&inputBuf[pos], ESC, avail);
+    unsigned int n = esc ? (unsigned int)(esc - &inputBuf[pos]) : avail;
+    abAppend(&ab, &inputBuf[pos], n);
+    inputHead += n;
+    if (!esc) continue;
+
+    // ESCが終了シーケンスの先頭かどうか確認
+    unsigned int i = 1;
+    while (i < sizeof(end_seq) - 1 && inputPeek(i) == end_seq[i]) i++;
+    if (i == sizeof(end_seq) - 1) {
+      inputHead += i;
+      break;
+    }
+    abAppend(&ab, &inputBuf[pos + n], 1);
+    inputHead++;
+  }
+
+  *len = ab.len;
+  return ab.b;
 }
 
 /**
@@ -74,33 +255,34 @@ void enableRawMode() {
  * 
  * 通常の文字はそのまま返し、矢印キーやHome/Endなどの特殊キーは
  * エスケープシーケンスを解析して専用の定数を返す
+ * 入力はリングバッファ経由でまとめて読み込む
+ * 入力待ちの間にeditorWakeupで起こされた場合はWAKEUPを返す
  * 
  * @return: 入力されたキーコード（特殊キーの場合は定数値）
  */
 int editorReadKey() {
-  int nread;
   char c;
   
   // 1文字読み取るまでループ
-  while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-    if (nread == -1 && errno != EAGAIN) {
-      die("read");
-    }
+  while (inputHead == inputTail) {
+    if (inputWait()) return WAKEUP;
+    inputFill();
   }
+  inputGet(&c);
 
   // エスケープシーケンスの処理
   if (c == ESC) {
     char seq[3];
 
     // エスケープシーケンスの残りを読み取る
-    if (read(STDIN_FILENO, &seq[0], 1) != 1) return ESC;
-    if (read(STDIN_FILENO, &seq[1], 1) != 1) return ESC;
+    if (inputGet(&seq[0]) == -1) return ESC;
+    if (inputGet(&seq[1]) == -1) return ESC;
 
     // ESC [ で始まるシーケンス
     if (seq[0] == '[') {
       // ESC [ 数字 ~ 形式（Page Up/Down, Delete等）
       if (seq[1] >= '0' && seq[1] <= '9') {
-        if (read(STDIN_FILENO, &seq[2], 1) != 1) return ESC;
+        if (inputGet(&seq[2]) == -1) return ESC;
         if (seq[2] == '~') {
           switch (seq[1]) {
             case '1': return HOME;      // ESC[1~
@@ -111,6 +293,12 @@ int editorReadKey() {
             case '7': return HOME;      // ESC[7~ (代替)
             case '8': return END;       // ESC[8~ (代替)
           }
+        } else if (seq[1] == '2' && seq[2] == '0') {
+          // ESC[200~ 形式（貼り付け開始）
+          char rest[2];
+          if (inputGet(&rest[0]) == -1) return ESC;
+          if (inputGet(&rest[1]) == -1) return ESC;
+          if (rest[0] == '0' && rest[1] == '~') return PASTE_START;
         }
       } else {
         // ESC [ 文字 形式（矢印キー等）
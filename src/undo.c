@@ -0,0 +1,297 @@
+/**
+ * undo.c - 元に戻す・やり直し機能
+ * 
+ * 編集操作の記録と取り消しを提供：
+ * - 操作は（位置、挿入したバイト列、削除したバイト列）のレコードとして1つの領域に追記する
+ * - 連続した文字の入力・削除は1つのレコードにまとめる
+ * - 記録の合計が上限（Config.undo_limit）を超えたら古いものから捨てる
+ * - 取り消し・やり直しの費用はその操作で変わったバイト数に比例する
+ * - 取り消し・やり直しを含む全ての操作は障害復旧用のジャーナルにも記録する
+ * - テキストの状態を識別子で表し、保存した内容と同じ状態に戻ったかを判定できるようにする
+ * 
+ * 位置はテキストを「各行＋改行」を連結したものとみなした（行, バイト位置）で表す
+ * （最終行の次の行の先頭は末尾への追加を表す）
+ */
+
+#include "kiloe.h"
+
+#define UNDO_ALIGN(n) (((n) + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1))
+#define UNDO_MERGE_MAX 4096         /* 1つのレコードにまとめる最大バイト数 */
+
+/* 連続した操作をまとめられるレコードの種類 */
+enum undoMerge {
+    UNDO_MERGE_NONE,
+    UNDO_MERGE_INSERT,              /* 改行を含まない挿入だけのレコード */
+    UNDO_MERGE_DELETE               /* 改行を含まない削除だけのレコード */
+};
+
+/* 操作レコード（直後に挿入したバイト列、削除したバイト列の順に続く） */
+struct undoRecord {
+    int row;                        /* 操作位置 */
+    int col;
+    size_t inslen;                  /* 挿入したバイト数 */
+    size_t dellen;                  /* 削除したバイト数 */
+    size_t prev;                    /* 直前のレコードの大きさ（先頭なら0） */
+    unsigned long id;               /* このレコードまで適用した状態の識別子（まとめる度に振り直す） */
+    int merge;                      /* 後続の操作をまとめられるか（UNDO_MERGE_*） */
+};
+
+static char *undoLog = NULL;        /* レコードを追記する領域 */
+static size_t undoLen = 0;          /* 記録済みの長さ */
+static size_t undoCap = 0;
+static size_t undoPos = 0;          /* 適用済みのレコードの終わり（以降はやり直し用） */
+static size_t undoTop = 0;          /* undoPosで終わるレコードの先頭（undoPos > 0の時だけ有効） */
+static int undoSealed = 0;          /* 最後のレコードに次の操作をまとめない */
+static int undoApplying = 0;        /* 取り消し・やり直しの適用中（記録しない） */
+static unsigned long undoNextId = 0;    /* 最後に振った状態の識別子 */
+static unsigned long undoBaseId = 1;    /* 先頭のレコードより前の状態の識別子 */
+
+/**
+ * レコードの大きさ（ヘッダとバイト列、境界合わせを含む）
+ */
+static size_t undoRecordSize(const struct undoRecord *r) {
+    return UNDO_ALIGN(sizeof(struct undoRecord) + r->inslen + r->dellen);
+}
+
+/**
+ * 領域をlenバイトまで使えるように拡張
+ */
+static void undoReserve(size_t len) {
+    if (len <= undoCap) return;
+    undoCap = undoCap ? undoCap * 2 : 4096;
+    while (undoCap < len) undoCap *= 2;
+    undoLog = realloc(undoLog, undoCap);
+}
+
+/**
+ * 記録の合計が上限を超えていれば古いレコードから捨てる
+ * 捨てる度に領域を詰めるので、上限の3/4まで減らして詰める回数を抑える
+ * （追記の直後に呼ぶので、やり直し用のレコードは残っていない）
+ */
+static void undoTrim() {
+    size_t limit = (size_t)Config.undo_limit * 1024;
+    if (undoLen <= limit) return;
+
+    size_t keep = limit / 4 * 3;
+    size_t drop = 0;
+    while (drop < undoLen && undoLen - drop > keep) {
+        // 捨てたレコードを適用した状態が、残った記録の先頭より前の状態になる
+        undoBaseId = ((struct undoRecord *)(undoLog + drop))->id;
+        drop += undoRecordSize((struct undoRecord *)(undoLog + drop));
+    }
+    memmove(undoLog, undoLog + drop, undoLen - drop);
+    undoLen -= drop;
+    undoPos = undoLen;
+    if (undoLen == 0) return;
+    undoTop -= drop;
+    ((struct undoRecord *)undoLog)->prev = 0;
+}
+
+/**
+ * 最後のレコードに今回の操作をまとめる（まとめられなければ0を返す）
+ * 挿入は後ろに続く文字を、削除はバックスペース（前へ）とDelete（同じ位置）の連続をまとめる
+ */
+static int undoMerge(int row, int col, const char *ins, size_t inslen, const char *del, size_t dellen) {
+    if (undoSealed || undoPos == 0 || undoPos != undoLen) return 0;
+    struct undoRecord *last = (struct undoRecord *)(undoLog + undoTop);
+    if (last->row != row || last->inslen + last->dellen + inslen + dellen > UNDO_MERGE_MAX) return 0;
+
+    if (last->merge == UNDO_MERGE_INSERT && dellen == 0 && !memchr(ins, '\n', inslen) &&
+        col == last->col + (int)last->inslen) {
+        undoReserve(undoTop + UNDO_ALIGN(sizeof(struct undoRecord) + last->inslen + inslen));
+        last = (struct undoRecord *)(undoLog + undoTop);
+        memcpy(undoLog + undoTop + sizeof(struct undoRecord) + last->inslen, ins, inslen);
+        last->inslen += inslen;
+    } else if (last->merge == UNDO_MERGE_DELETE && inslen == 0 && !memchr(del, '\n', dellen) &&
+               (col + (int)dellen == last->col || col == last->col)) {
+        undoReserve(undoTop + UNDO_ALIGN(sizeof(struct undoRecord) + last->dellen + dellen));
+        last = (struct undoRecord *)(undoLog + undoTop);
+        char *bytes = undoLog + undoTop + sizeof(struct undoRecord);
+        if (col == last->col) {
+            // Delete：削除した文字は後ろに続く
+            memcpy(bytes + last->dellen, del, dellen);
+        } else {
+            // バックスペース：削除した文字は前に付く
+            memmove(bytes + dellen, bytes, last->dellen);
+            memcpy(bytes, del, dellen);
+            last->col = col;
+        }
+        last->dellen += dellen;
+    } else {
+        return 0;
+    }
+    last->id = ++undoNextId;
+    undoLen = undoPos = undoTop + undoRecordSize(last);
+    return 1;
+}
+
+/**
+ * 編集操作を記録
+ * 位置(row, col)でdellenバイトのdelを削除し、inslenバイトのinsを挿入した操作として追記する
+ * やり直し用のレコードは捨て、連続した文字の入力・削除は直前のレコードにまとめる
+ */
+void editorUndoRecord(int row, int col, const char *ins, size_t inslen, const char *del, size_t dellen) {
+    if (undoApplying || (inslen == 0 && dellen == 0)) return;
+    editorJournalRecord(row, col, ins, inslen, del, dellen);
+    if (undoMerge(row, col, ins, inslen, del, dellen)) {
+        undoTrim();
+        return;
+    }
+
+    size_t size = UNDO_ALIGN(sizeof(struct undoRecord) + inslen + dellen);
+    undoReserve(undoPos + size);
+    struct undoRecord *r = (struct undoRecord *)(undoLog + undoPos);
+    r->row = row;
+    r->col = col;
+    r->inslen = inslen;
+    r->dellen = dellen;
+    r->prev = undoPos ? undoPos - undoTop : 0;
+    r->id = ++undoNextId;
+    if (dellen == 0 && !memchr(ins, '\n', inslen)) r->merge = UNDO_MERGE_INSERT;
+    else if (inslen == 0 && !memchr(del, '\n', dellen)) r->merge = UNDO_MERGE_DELETE;
+    else r->merge = UNDO_MERGE_NONE;
+    char *bytes = (char *)(r + 1);
+    if (inslen) memcpy(bytes, ins, inslen);
+    if (dellen) memcpy(bytes + inslen, del, dellen);
+
+    undoTop = undoPos;
+    undoLen = undoPos = undoPos + size;
+    undoSealed = 0;
+    undoTrim();
+}
+
+/**
+ * 位置(row, col)からlenバイトを削除（改行をまたぐ場合は行を結合する）
+ * 
+ * @return: 削除する範囲がテキストの外にかかる場合は-1（そこまでは削除する）、それ以外は0
+ */
+static int undoDelete(int row, int col, size_t len) {
+    while (len > 0) {
+        if (row >= E.numrows) return -1;
+        erow *r = editorRowAt(row);
+        size_t avail = r->size - col;
+        if (len <= avail) {
+            editorRowDelRange(r, col, col + len);
+            return 0;
+        }
+        if (avail > 0) {
+            editorRowDelRange(r, col, r->size);
+            len -= avail;
+        }
+        // 行末の改行を削除（最終行なら空になった行そのものを削除）
+        if (row + 1 < E.numrows) {
+            erow *next = editorRowAt(row + 1);
+            editorRowAppendString(editorRowAt(row), editorRowText(next), next->size);
+            editorDelRow(row + 1);
+        } else if (col == 0) {
+            editorDelRow(row);
+        } else {
+            return -1;
+        }
+        len--;
+    }
+    return 0;
+}
+
+/**
+ * 位置(row, col)にlenバイトを挿入し、カーソルを挿入した文字列の直後に置く
+ * 末尾への追加（row == E.numrows）は改行で終わる文字列を行として追加する
+ */
+static void undoInsert(int row, int col, const char *s, size_t len) {
+    E.cy = row;
+    E.cx = col;
+    if (len == 0) return;
+    if (row == E.numrows) {
+        // 最後の改行は追加する行の終わりを表す
+        if (len == 1) editorInsertRow(E.numrows, "", 0);
+        else editorInsertText(s, len - 1);
+        E.cy = E.numrows;
+        E.cx = 0;
+        return;
+    }
+    if (!memchr(s, '\n', len)) {
+        // 改行を含まない文字列は行のギャップに直接挿入する
+        editorRowInsertString(editorRowAt(row), col, s, len);
+        E.cx = col + len;
+        return;
+    }
+    editorInsertText(s, len);
+}
+
+/**
+ * 位置(row, col)でdellenバイトを削除してからinsを挿入
+ */
+static void undoApply(int row, int col, size_t dellen, const char *ins, size_t inslen) {
+    undoApplying = 1;
+    undoDelete(row, col, dellen);
+    undoInsert(row, col, ins, inslen);
+    undoApplying = 0;
+    undoSealed = 1;
+}
+
+/**
+ * 直前の操作を取り消す
+ * 
+ * @return: 取り消した場合は1、取り消す操作がなければ0
+ */
+int editorUndo() {
+    if (undoPos == 0) return 0;
+    struct undoRecord *r = (struct undoRecord *)(undoLog + undoTop);
+    const char *bytes = (const char *)(r + 1);
+    undoPos = undoTop;
+    undoTop -= r->prev;
+    editorJournalRecord(r->row, r->col, bytes + r->inslen, r->dellen, bytes, r->inslen);
+    undoApply(r->row, r->col, r->inslen, bytes + r->inslen, r->dellen);
+    return 1;
+}
+
+/**
+ * 取り消した操作をやり直す
+ * 
+ * @return: やり直した場合は1、やり直す操作がなければ0
+ */
+int editorRedo() {
+    if (undoPos == undoLen) return 0;
+    struct undoRecord *r = (struct undoRecord *)(undoLog + undoPos);
+    const char *bytes = (const char *)(r + 1);
+    undoTop = undoPos;
+    undoPos += undoRecordSize(r);
+    editorJournalRecord(r->row, r->col, bytes, r->inslen, bytes + r->inslen, r->dellen);
+    undoApply(r->row, r->col, r->dellen, bytes, r->inslen);
+    return 1;
+}
+
+/**
+ * 記録を全て破棄（行を全て解放する時など、位置が無効になる場合に呼ぶ）
+ */
+void editorUndoReset() {
+    free(undoLog);
+    undoLog = NULL;
+    undoLen = undoCap = undoPos = undoTop = 0;
+    undoSealed = 0;
+    undoBaseId = ++undoNextId;
+}
+
+/**
+ * 現在のテキストの状態の識別子
+ * 取り消し・やり直しで同じ状態に戻れば同じ値になり、それ以外の編集をすれば別の値になる
+ */
+unsigned long editorUndoState() {
+    return undoPos ? ((struct undoRecord *)(undoLog + undoTop))->id : undoBaseId;
+}
+
+/**
+ * 現在の状態の識別子を返し、以降の操作を直前のレコードにまとめないようにする
+ * 保存した時点の状態に取り消しで正確に戻れるようにするため、保存のスナップショットを取る時に呼ぶ
+ */
+unsigned long editorUndoMark() {
+    undoSealed = 1;
+    return editorUndoState();
+}
+
+/**
+ * 記録に使っているバイト数
+ */
+size_t editorUndoUsage() {
+    return undoLen;
+}
@@ -0,0 +1,120 @@
+/**
+ * bench_buffer.c - 画面更新1回あたりの出力量と割り当て回数の計測
+ *
+ * 使い方: bench_buffer [フレーム数]
+ *   デフォルトは10000フレーム、画面は50行×200桁
+ * ビルド例: gcc -O2 -std=c99 -Wl,--wrap=malloc -Wl,--wrap=realloc -Wl,--wrap=calloc \
+ *             -o bench_buffer bench_buffer.c test_main_stub.c \
+ *             $(ls ../src/[a-z]*.c | grep -v main.c)
+ */
+
+#include "../src/kiloe.h"
+
+/* 割り当て回数の計測（リンカの--wrapで差し替える） */
+static long allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_calloc(size_t n, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocs++;
+    return __real_realloc(ptr, size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 計測シナリオ */
+enum benchMode {
+    BENCH_FULL,       /* 毎回全体を再描画 */
+    BENCH_TYPE,       /* 1文字ずつ入力 */
+    BENCH_SCROLL      /* 1行ずつスクロール */
+};
+
+/**
+ * 1つのシナリオを計測
+ * reuseが真なら出力バッファを使い回す（editorRefreshScreenと同じ）
+ */
+static void run(const char *name, int mode, int reuse, int frames) {
+    struct abuf ab = ABUF_INIT;
+    long bytes = 0;
+
+    E.cx = E.cy = E.rowoff = E.coloff = 0;
+    editorScreenInvalidate();
+    editorRenderFrame(&ab);
+    abFree(&ab);
+
+    long allocs0 = allocs;
+    double t0 = now_sec();
+    for (int i = 0; i < frames; i++) {
+        switch (mode) {
+            case BENCH_FULL:
+                editorScreenInvalidate();
+                break;
+            case BENCH_TYPE:
+                // 入力で行が伸び続けないよう、挿入と削除を交互に行う
+                if (i % 2 == 0) editorRowInsertChar(editorRowAt(E.cy), E.cx, 'x');
+                else editorRowDelChar(editorRowAt(E.cy), E.cx);
+                break;
+            case BENCH_SCROLL:
+                E.cy = (E.cy + 1) % E.numrows;
+                break;
+        }
+
+        if (reuse) abReset(&ab);
+        editorRenderFrame(&ab);
+        bytes += ab.len;
+        if (!reuse) abFree(&ab);
+    }
+    double t = now_sec() - t0;
+    long n = allocs - allocs0;
+    abFree(&ab);
+
+    printf("%-8s %-7s %10.1f bytes/frame %8.2f allocs/frame %8.2f us/frame\n",
+           name, reuse ? "reuse" : "fresh", (double)bytes / frames, (double)n / frames,
+           t / frames * 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : 10000;
+
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    E.screenrows = 50;
+    E.screencols = 200;
+    E.filename = strdup("bench.c");
+    editorSelectSyntaxHighlight();
+
+    // ハイライトの色が混ざるC風のテキストを作成
+    for (int i = 0; i < 100000; i++) {
+        char line[160];
+        int len = snprintf(line, sizeof(line),
+                           "    int value%d = compute(%d, \"label\"); // comment %d", i, i * 7, i);
+        editorInsertRow(i, line, len);
+    }
+
+    printf("screen: %dx%d, %d frames\n", E.screencols, E.screenrows, frames);
+    for (int reuse = 0; reuse <= 1; reuse++) {
+        run("full", BENCH_FULL, reuse, frames);
+        run("type", BENCH_TYPE, reuse, frames);
+        run("scroll", BENCH_SCROLL, reuse, frames);
+    }
+
+    editorFreeRows();
+    free(E.filename);
+    return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * bench_find.c - 部分文字列検索カーネルのスループット計測
+ *
+ * 使い方: bench_find [サイズ(MB)] [検索語]
+ *   デフォルトは1024MB、検索語は短いもの・長いものの2種類
+ * 行ごとのstrstr（従来の検索方法）と、バッファ全体へのscanFindを比較する
+ * ビルド例: gcc -O2 -std=c99 -o bench_find bench_find.c ../src/scan.c
+ */
+
+#include "../src/kiloe.h"
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 行ごとにstrstrで検索（行はNUL終端済み） */
+static size_t find_strstr(char *buf, const size_t *starts, size_t nlines, const char *needle) {
+    size_t count = 0;
+    for (size_t k = 0; k < nlines; k++) {
+        for (char *p = strstr(buf + starts[k], needle); p; p = strstr(p + 1, needle)) count++;
+    }
+    return count;
+}
+
+/* バッファ全体をscanFindで検索 */
+static size_t find_scan(const char *buf, size_t len, const char *needle) {
+    size_t nlen = strlen(needle);
+    const char *end = buf + len;
+    size_t count = 0;
+    for (const char *p = scanFind(buf, len, needle, nlen); p; p = scanFind(p + 1, end - p - 1, needle, nlen)) {
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char *argv[]) {
+    size_t mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 1024;
+    const char *defaults[] = {"editorRefreshScreen", "static void editorDrawRows(struct abuf *ab, int frame)"};
+    const char **needles = argc > 2 ? (const char **)&argv[2] : defaults;
+    int nneedles = argc > 2 ? argc - 2 : 2;
+    size_t len = mb << 20;
+
+    char *buf = mmap(NULL, len + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    // 識別子風の単語を並べた平均60バイト程度の行を作成し、ときどき検索語を埋め込む
+    const char *words[] = {"int", "row", "editor", "static", "return", "char", "size", "E.cy",
+                           "for", "if", "render", "struct", "erow", "void", "while", "chars"};
+    size_t cap = len / 16 + 1, nlines = 0;
+    size_t *starts = malloc(sizeof(size_t) * cap);
+    unsigned int seed = 1;
+    size_t i = 0;
+    while (i < len) {
+        if (nlines == cap) starts = realloc(starts, sizeof(size_t) * (cap *= 2));
+        starts[nlines++] = i;
+        seed = seed * 1103515245 + 12345;
+        size_t linelen = 1 + (seed >> 16) % 120;
+        const char *w = (seed >> 8) % 4096 == 0 ? needles[(seed >> 4) % nneedles] : NULL;
+        for (size_t j = 0; j < linelen && i < len; ) {
+            seed = seed * 1103515245 + 12345;
+            if (!w) w = words[(seed >> 16) % 16];
+            for (; *w && i < len; j++, i++) buf[i] = *w++;
+            w = NULL;
+            if (i < len) buf[i++] = ' ', j++;
+        }
+        if (i < len) buf[i++] = '\n';
+    }
+    buf[len] = '\0';
+
+    printf("input: %zu MB, %zu lines\n", mb, nlines);
+
+    int kernels[] = {SCAN_KERNEL_SCALAR, SCAN_KERNEL_SSE2, SCAN_KERNEL_AVX2};
+    for (int n = 0; n < nneedles; n++) {
+        printf("needle: \"%s\" (%zu bytes)\n", needles[n], strlen(needles[n]));
+        for (int k = 0; k < 3; k++) {
+            if (scanUseKernel(kernels[k]) != 0) {
+                printf("  %-8s unsupported\n", scanKernelName(kernels[k]));
+                continue;
+            }
+            double t0 = now_sec();
+            size_t count = find_scan(buf, len, needles[n]);
+            double dt = now_sec() - t0;
+            printf("  %-8s %10zu matches  %8.3f s  %6.2f GB/s\n",
+                   scanKernelName(kernels[k]), count, dt, len / dt / 1e9);
+        }
+    }
+
+    // 従来の方法：行末をNUL終端にして行ごとにstrstr
+    for (size_t k = 0; k < len; k++) {
+        if (buf[k] == '\n') buf[k] = '\0';
+    }
+    for (int n = 0; n < nneedles; n++) {
+        double t0 = now_sec();
+        size_t count = find_strstr(buf, starts, nlines, needles[n]);
+        double dt = now_sec() - t0;
+        printf("strstr per row, \"%s\": %10zu matches  %8.3f s  %6.2f GB/s\n",
+               needles[n], count, dt, len / dt / 1e9);
+    }
+
+    free(starts);
+    munmap(buf, len + 1);
+    return 0;
+}
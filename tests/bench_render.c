@@ -0,0 +1,71 @@
+/**
+ * bench_render.c - 画面全体の描画時間の計測
+ *
+ * 使い方: bench_render [フレーム数] [桁数] [行数] [ファイル]
+ *   デフォルトは2000フレーム、画面は300桁×100行
+ *   ファイルを指定しない場合はハイライトが細かく切り替わるC風のテキストを作成する
+ *   毎フレーム全体を再描画し、画面作成から出力内容の作成までの時間を測る
+ * ビルド例: gcc -O2 -std=c99 -o bench_render bench_render.c test_main_stub.c \
+ *             $(ls ../src/[a-z]*.c | grep -v main.c)
+ */
+
+#include "../src/kiloe.h"
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : 2000;
+
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    Config.show_line_numbers = 1;
+    E.screencols = argc > 2 ? atoi(argv[2]) : 300;
+    E.screenrows = argc > 3 ? atoi(argv[3]) : 100;
+
+    if (argc > 4) {
+        // 指定されたファイルを読み込み、シンタックスはC固定で表示
+        Config.lazy_load = 0;
+        editorOpen(argv[4]);
+        free(E.filename);
+        E.filename = strdup("bench.c");
+    } else {
+        E.filename = strdup("bench.c");
+        // 画面幅いっぱいまでハイライトが細かく切り替わるC風のテキストを作成
+        for (int i = 0; i < E.screenrows * 2; i++) {
+            char line[1024];
+            int len = 0;
+            while (len < E.screencols && len < (int)sizeof(line) - 64) {
+                len += snprintf(line + len, sizeof(line) - len,
+                                "if (x%d == %d) return \"s\"; /* c */ ", i, len);
+            }
+            editorInsertRow(i, line, len);
+        }
+    }
+    editorSelectSyntaxHighlight();
+
+    struct abuf ab = ABUF_INIT;
+    editorScreenInvalidate();
+    editorRenderFrame(&ab);
+
+    long bytes = 0;
+    double t0 = now_sec();
+    for (int i = 0; i < frames; i++) {
+        editorScreenInvalidate();
+        abReset(&ab);
+        editorRenderFrame(&ab);
+        bytes += ab.len;
+    }
+    double t = now_sec() - t0;
+
+    printf("screen: %dx%d, %d frames\n", E.screencols, E.screenrows, frames);
+    printf("full redraw: %8.1f us/frame %10.1f bytes/frame\n", t / frames * 1e6, (double)bytes / frames);
+
+    abFree(&ab);
+    editorFreeRows();
+    free(E.filename);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/**
+ * bench_scan.c - 改行走査カーネルのスループット計測
+ *
+ * 使い方: bench_scan [サイズ(MB)] [平均行長]
+ *   デフォルトは2048MB、平均行長60バイト
+ * ビルド例: gcc -O2 -std=c99 -o bench_scan bench_scan.c ../src/scan.c
+ */
+
+#include "../src/kiloe.h"
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    size_t mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 2048;
+    int avg = argc > 2 ? atoi(argv[2]) : 60;
+    size_t len = mb << 20;
+
+    char *buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    // 行長が平均avgバイトで揺らぐテキストを作成
+    unsigned int seed = 1;
+    size_t i = 0;
+    while (i < len) {
+        seed = seed * 1103515245 + 12345;
+        size_t linelen = 1 + (seed >> 16) % (2 * avg);
+        for (size_t j = 0; j < linelen && i < len; j++, i++) buf[i] = 'a' + (i % 26);
+        if (i < len) buf[i++] = '\n';
+    }
+
+    printf("input: %zu MB, average line %d bytes\n", mb, avg);
+
+    static size_t ends[SCAN_BATCH];
+    int kernels[] = {SCAN_KERNEL_SCALAR, SCAN_KERNEL_SSE2, SCAN_KERNEL_AVX2};
+    for (int k = 0; k < 3; k++) {
+        if (scanUseKernel(kernels[k]) != 0) {
+            printf("%-8s unsupported\n", scanKernelName(kernels[k]));
+            continue;
+        }
+
+        double t0 = now_sec();
+        size_t lines = 0, base = 0;
+        for (;;) {
+            size_t n = scanLineEnds(buf + base, len - base, ends, SCAN_BATCH);
+            lines += n;
+            if (n < SCAN_BATCH) break;
+            base += ends[n - 1] + 1;
+        }
+        double dt = now_sec() - t0;
+
+        printf("%-8s %10zu lines  %8.3f s  %6.2f GB/s\n",
+               scanKernelName(kernels[k]), lines, dt, len / dt / 1e9);
+    }
+
+    munmap(buf, len);
+    return 0;
+}
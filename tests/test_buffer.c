@@ -162,6 +162,53 @@ void test_abAppend_stress() {
     abFree(&ab);
 }
 
+/* 容量の倍々拡張テスト */
+void test_abAppend_geometric_growth() {
+    struct abuf ab = ABUF_INIT;
+    int grows = 0;
+    int cap = ab.cap;
+
+    // 1バイトずつ追加しても再割り当ては対数回で済む
+    for (int i = 0; i < 100000; i++) {
+        abAppend(&ab, "x", 1);
+        if (ab.cap != cap) {
+            grows++;
+            cap = ab.cap;
+        }
+    }
+
+    TEST_ASSERT_EQ_INT(100000, ab.len);
+    TEST_ASSERT_TRUE(ab.cap >= ab.len);
+    TEST_ASSERT_TRUE(grows <= 10);
+
+    abFree(&ab);
+    TEST_ASSERT_EQ_INT(0, ab.cap);
+}
+
+/* 容量を保ったまま再利用するテスト */
+void test_abReset_keeps_capacity() {
+    struct abuf ab = ABUF_INIT;
+
+    char run[1000];
+    memset(run, ' ', sizeof(run));
+    abAppend(&ab, run, sizeof(run));
+    char *b = ab.b;
+    int cap = ab.cap;
+
+    abReset(&ab);
+    TEST_ASSERT_EQ_INT(0, ab.len);
+    TEST_ASSERT_EQ_INT(cap, ab.cap);
+
+    // 同じ量の追加では再割り当てしない
+    memset(run, '-', sizeof(run));
+    abAppend(&ab, run, sizeof(run));
+    TEST_ASSERT("Buffer should be reused", ab.b == b);
+    TEST_ASSERT_EQ_INT(1000, ab.len);
+    TEST_ASSERT("Contents should be replaced", ab.b[0] == '-' && ab.b[999] == '-');
+
+    abFree(&ab);
+}
+
 int main() {
     TEST_GROUP("Buffer Management (abuf)");
     
@@ -175,6 +222,8 @@ int main() {
     RUN_TEST(test_abAppend_null_handling);
     RUN_TEST(test_abAppend_escape_sequences);
     RUN_TEST(test_abAppend_stress);
+    RUN_TEST(test_abAppend_geometric_growth);
+    RUN_TEST(test_abReset_keeps_capacity);
     
     TEST_SUMMARY();
 }
\ No newline at end of file
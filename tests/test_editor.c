@@ -17,7 +17,7 @@ extern struct editorSettings Config;
 static void setup_editor() {
     memset(&E, 0, sizeof(E));
     E.numrows = 0;
-    E.row = NULL;
+    E.rowroot = NULL;
     E.dirty = 0;
     E.filename = NULL;
     E.syntax = NULL;
@@ -30,13 +30,8 @@ static void setup_editor() {
 
 /* テスト用のクリーンアップ */
 static void cleanup_editor() {
-    for (int i = 0; i < E.numrows; i++) {
-        editorFreeRow(&E.row[i]);
-    }
-    free(E.row);
+    editorFreeRows();
     free(E.filename);
-    E.row = NULL;
-    E.numrows = 0;
 }
 
 /* editorInsertCharのテスト - 空のエディタ */
@@ -49,7 +44,7 @@ void test_editorInsertChar_empty() {
     editorInsertChar('A');
     
     TEST_ASSERT_EQ_INT(1, E.numrows);
-    TEST_ASSERT_STR_EQ("A", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("A", editorRowText(editorRowAt(0)));
     TEST_ASSERT_EQ_INT(1, E.cx);  // カーソルが右に移動
     TEST_ASSERT_EQ_INT(2, E.dirty);  // ダーティフラグ（行作成1 + 文字挿入1）
     
@@ -67,7 +62,7 @@ void test_editorInsertChar_existing_line() {
     
     editorInsertChar('!');
     
-    TEST_ASSERT_STR_EQ("Hello!", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("Hello!", editorRowText(editorRowAt(0)));
     TEST_ASSERT_EQ_INT(6, E.cx);
     
     cleanup_editor();
@@ -83,7 +78,7 @@ void test_editorInsertChar_middle() {
     
     editorInsertChar('e');
     
-    TEST_ASSERT_STR_EQ("Hello", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("Hello", editorRowText(editorRowAt(0)));
     TEST_ASSERT_EQ_INT(2, E.cx);  // カーソルが挿入文字の後に移動
     
     cleanup_editor();
@@ -100,8 +95,8 @@ void test_editorInsertNewLine_beginning() {
     editorInsertNewLine();
     
     TEST_ASSERT_EQ_INT(2, E.numrows);
-    TEST_ASSERT_STR_EQ("", E.row[0].chars);     // 新しい空行
-    TEST_ASSERT_STR_EQ("Hello", E.row[1].chars); // 元の行
+    TEST_ASSERT_STR_EQ("", editorRowText(editorRowAt(0)));     // 新しい空行
+    TEST_ASSERT_STR_EQ("Hello", editorRowText(editorRowAt(1))); // 元の行
     TEST_ASSERT_EQ_INT(1, E.cy);  // 次の行に移動
     TEST_ASSERT_EQ_INT(0, E.cx);  // 行頭に移動
     
@@ -119,8 +114,8 @@ void test_editorInsertNewLine_middle() {
     editorInsertNewLine();
     
     TEST_ASSERT_EQ_INT(2, E.numrows);
-    TEST_ASSERT_STR_EQ("Hello", E.row[0].chars);   // 前半
-    TEST_ASSERT_STR_EQ(" World", E.row[1].chars);  // 後半
+    TEST_ASSERT_STR_EQ("Hello", editorRowText(editorRowAt(0)));   // 前半
+    TEST_ASSERT_STR_EQ(" World", editorRowText(editorRowAt(1)));  // 後半
     TEST_ASSERT_EQ_INT(1, E.cy);
     TEST_ASSERT_EQ_INT(0, E.cx);
     
@@ -137,7 +132,7 @@ void test_editorDelChar_character() {
     
     editorDelChar();  // '!'を削除
     
-    TEST_ASSERT_STR_EQ("Hello", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("Hello", editorRowText(editorRowAt(0)));
     TEST_ASSERT_EQ_INT(5, E.cx);  // カーソルが左に移動
     
     cleanup_editor();
@@ -155,7 +150,7 @@ void test_editorDelChar_line_join() {
     editorDelChar();  // 改行を削除して行を結合
     
     TEST_ASSERT_EQ_INT(1, E.numrows);
-    TEST_ASSERT_STR_EQ("HelloWorld", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("HelloWorld", editorRowText(editorRowAt(0)));
     TEST_ASSERT_EQ_INT(0, E.cy);  // 前の行に移動
     TEST_ASSERT_EQ_INT(5, E.cx);  // 結合位置に移動
     
@@ -169,11 +164,13 @@ void test_editorDelChar_multibyte() {
     editorInsertRow(0, "あいう", 9);  // 各文字3バイト
     E.cy = 0;
     E.cx = 9;  // 末尾
+    E.dirty = 0;
     
     editorDelChar();  // "う"を削除
     
-    TEST_ASSERT_STR_EQ("あい", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("あい", editorRowText(editorRowAt(0)));
     TEST_ASSERT_EQ_INT(6, E.cx);  // "う"の開始位置に移動
+    TEST_ASSERT_EQ_INT(1, E.dirty);  // 1文字の削除は1回の編集
     
     cleanup_editor();
 }
@@ -189,7 +186,7 @@ void test_editorDelChar_boundaries() {
     
     editorDelChar();
     
-    TEST_ASSERT_STR_EQ("Hello", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("Hello", editorRowText(editorRowAt(0)));
     TEST_ASSERT_EQ_INT(0, E.cx);
     TEST_ASSERT_EQ_INT(0, E.cy);
     
@@ -215,7 +212,7 @@ void test_combined_operations() {
     editorInsertChar('l');
     editorInsertChar('o');
     
-    TEST_ASSERT_STR_EQ("Hello", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("Hello", editorRowText(editorRowAt(0)));
     TEST_ASSERT_EQ_INT(5, E.cx);
     
     // 改行の挿入
@@ -232,18 +229,18 @@ void test_combined_operations() {
     editorInsertChar('l');
     editorInsertChar('d');
     
-    TEST_ASSERT_STR_EQ("World", E.row[1].chars);
+    TEST_ASSERT_STR_EQ("World", editorRowText(editorRowAt(1)));
     
     // 文字削除
     editorDelChar();  // 'd'を削除
-    TEST_ASSERT_STR_EQ("Worl", E.row[1].chars);
+    TEST_ASSERT_STR_EQ("Worl", editorRowText(editorRowAt(1)));
     
     // 行の結合（改行削除）
     E.cx = 0;  // 行頭に移動
     editorDelChar();
     
     TEST_ASSERT_EQ_INT(1, E.numrows);
-    TEST_ASSERT_STR_EQ("HelloWorl", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("HelloWorl", editorRowText(editorRowAt(0)));
     
     cleanup_editor();
 }
@@ -296,7 +293,101 @@ void test_utf8_tab_operations() {
     
     editorDelChar();  // 'A'を削除
     TEST_ASSERT_EQ_INT(0, E.cx);
-    TEST_ASSERT_STR_EQ("", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("", editorRowText(editorRowAt(0)));
+    
+    cleanup_editor();
+}
+
+/* editorInsertTextのテスト - 1行の文字列 */
+void test_editorInsertText_single_line() {
+    setup_editor();
+    
+    editorInsertRow(0, "Hd", 2);
+    E.cy = 0;
+    E.cx = 1;
+    
+    editorInsertText("ello Worl", 9);
+    
+    TEST_ASSERT_EQ_INT(1, E.numrows);
+    TEST_ASSERT_STR_EQ("Hello World", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_EQ_INT(0, E.cy);
+    TEST_ASSERT_EQ_INT(10, E.cx);  // 挿入した文字列の直後
+    
+    cleanup_editor();
+}
+
+/* editorInsertTextのテスト - 改行を含む文字列は行の途中を分割して挿入 */
+void test_editorInsertText_multi_line() {
+    setup_editor();
+    
+    editorInsertRow(0, "before", 6);
+    editorInsertRow(1, "head|tail", 9);
+    editorInsertRow(2, "after", 5);
+    E.cy = 1;
+    E.cx = 5;
+    
+    // LF・CR・CRLFのいずれも改行として扱う
+    editorInsertText("one\ntwo\rthree\r\nfour", 19);
+    
+    TEST_ASSERT_EQ_INT(6, E.numrows);
+    TEST_ASSERT_STR_EQ("before", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_STR_EQ("head|one", editorRowText(editorRowAt(1)));
+    TEST_ASSERT_STR_EQ("two", editorRowText(editorRowAt(2)));
+    TEST_ASSERT_STR_EQ("three", editorRowText(editorRowAt(3)));
+    TEST_ASSERT_STR_EQ("fourtail", editorRowText(editorRowAt(4)));
+    TEST_ASSERT_STR_EQ("after", editorRowText(editorRowAt(5)));
+    TEST_ASSERT_EQ_INT(4, E.cy);
+    TEST_ASSERT_EQ_INT(4, E.cx);
+
+    // 改行で終わる文字列は残りを次の行の先頭に送る
+    E.cy = 0;
+    E.cx = 0;
+    editorInsertText("new\r\n", 5);
+    TEST_ASSERT_EQ_INT(7, E.numrows);
+    TEST_ASSERT_STR_EQ("new", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_STR_EQ("before", editorRowText(editorRowAt(1)));
+    TEST_ASSERT_EQ_INT(1, E.cy);
+    TEST_ASSERT_EQ_INT(0, E.cx);
+    
+    cleanup_editor();
+}
+
+/* editorInsertTextのテスト - 複数チャンクにまたがる大量の行 */
+void test_editorInsertText_many_lines() {
+    setup_editor();
+    
+    for (int i = 0; i < 100; i++) {
+        char line[16];
+        int len = snprintf(line, sizeof(line), "old %d", i);
+        editorInsertRow(i, line, len);
+    }
+    
+    // 1000行の文字列（末尾の改行の後は空行）
+    int len = 0;
+    char *text = malloc(1000 * 16);
+    for (int i = 0; i < 1000; i++) {
+        len += sprintf(text + len, "new %d\n", i);
+    }
+    E.cy = 50;
+    E.cx = 0;
+    editorInsertText(text, len);
+    free(text);
+    
+    TEST_ASSERT_EQ_INT(1100, E.numrows);
+    TEST_ASSERT_STR_EQ("old 49", editorRowText(editorRowAt(49)));
+    TEST_ASSERT_STR_EQ("new 0", editorRowText(editorRowAt(50)));
+    TEST_ASSERT_STR_EQ("new 999", editorRowText(editorRowAt(1049)));
+    TEST_ASSERT_STR_EQ("old 50", editorRowText(editorRowAt(1050)));
+    TEST_ASSERT_STR_EQ("old 99", editorRowText(editorRowAt(1099)));
+    TEST_ASSERT_EQ_INT(1050, E.cy);
+    TEST_ASSERT_EQ_INT(0, E.cx);
+    
+    // 行インデックスがロープ全体で一貫していること
+    int ok = 1;
+    for (int i = 0; i < E.numrows; i++) {
+        if (editorRowIndex(editorRowAt(i)) != i) ok = 0;
+    }
+    TEST_ASSERT("Row indices should be consistent", ok);
     
     cleanup_editor();
 }
@@ -316,6 +407,9 @@ int main() {
     RUN_TEST(test_combined_operations);
     RUN_TEST(test_dirty_flag);
     RUN_TEST(test_utf8_tab_operations);
+    RUN_TEST(test_editorInsertText_single_line);
+    RUN_TEST(test_editorInsertText_multi_line);
+    RUN_TEST(test_editorInsertText_many_lines);
     
     TEST_SUMMARY();
 }
\ No newline at end of file
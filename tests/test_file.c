@@ -0,0 +1,478 @@
+/**
+ * test_file.c - ファイル入出力関数のテスト
+ */
+
+#define _GNU_SOURCE
+#include "minunit.h"
+#include "../src/kiloe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+/* 外部変数 */
+extern struct editorConfig E;
+extern struct editorSettings Config;
+
+static const char *test_file = "test_file_tmp.txt";
+
+/* テスト用のセットアップ */
+static void setup_editor() {
+    memset(&E, 0, sizeof(E));
+    E.numrows = 0;
+    E.rowroot = NULL;
+    E.dirty = 0;
+    E.filename = NULL;
+    E.syntax = NULL;
+
+    initDefaultConfig();
+    // ジャーナルはtest_journal.cで確認する
+    Config.journal = 0;
+}
+
+/* テスト用のクリーンアップ */
+static void cleanup_editor() {
+    editorFreeRows();
+    free(E.filename);
+    E.filename = NULL;
+    unlink(test_file);
+}
+
+/* テスト用ファイルを作成 */
+static void write_test_file(const char *content, size_t len) {
+    FILE *fp = fopen(test_file, "w");
+    if (fp) {
+        fwrite(content, 1, len, fp);
+        fclose(fp);
+    }
+}
+
+/* 遅延読み込みのテスト - 改行コードと末尾改行なし */
+void test_editorOpen_lazy_line_endings() {
+    setup_editor();
+
+    const char *content = "first\r\nsecond\n\nlast";
+    write_test_file(content, strlen(content));
+
+    Config.lazy_load = 1;
+    editorOpen((char *)test_file);
+
+    TEST_ASSERT_NOT_NULL(E.map);
+    TEST_ASSERT_EQ_INT(4, E.numrows);
+    TEST_ASSERT_EQ_INT(0, E.dirty);
+    TEST_ASSERT_STR_EQ("first", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_STR_EQ("second", editorRowText(editorRowAt(1)));
+    TEST_ASSERT_STR_EQ("", editorRowText(editorRowAt(2)));
+    TEST_ASSERT_STR_EQ("last", editorRowText(editorRowAt(3)));
+
+    cleanup_editor();
+}
+
+/* 遅延読み込みのテスト - 参照されたチャンクだけが展開される */
+void test_editorOpen_lazy_materialize() {
+    setup_editor();
+
+    // チャンク10個分の行を作成
+    int nlines = ROW_CHUNK_MAX * 10;
+    char *content = malloc(nlines * 16);
+    size_t len = 0;
+    for (int i = 0; i < nlines; i++) {
+        len += sprintf(content + len, "line %d\n", i);
+    }
+    write_test_file(content, len);
+    free(content);
+
+    Config.lazy_load = 1;
+    editorOpen((char *)test_file);
+    TEST_ASSERT_EQ_INT(nlines, E.numrows);
+
+    // 中央の行だけを参照
+    int at = ROW_CHUNK_MAX * 5 + 3;
+    erow *row = editorRowAt(at);
+    TEST_ASSERT_STR_EQ("line 323", editorRowText(row));
+    TEST_ASSERT_EQ_INT(at, editorRowIndex(row));
+
+    // 前後のチャンクは未展開のまま
+    TEST_ASSERT("Previous chunk should stay lazy", ropePeekPrev(editorRowAt(ROW_CHUNK_MAX * 5)) == NULL);
+    TEST_ASSERT("Next chunk should stay lazy", ropePeekNext(editorRowAt(ROW_CHUNK_MAX * 6 - 1)) == NULL);
+
+    // 未展開チャンクの中で編集
+    editorInsertRow(10, "inserted", 8);
+    editorDelRow(ROW_CHUNK_MAX * 9);
+    TEST_ASSERT_EQ_INT(nlines, E.numrows);
+    TEST_ASSERT_STR_EQ("inserted", editorRowText(editorRowAt(10)));
+    TEST_ASSERT_STR_EQ("line 10", editorRowText(editorRowAt(11)));
+    TEST_ASSERT_STR_EQ("line 576", editorRowText(editorRowAt(ROW_CHUNK_MAX * 9)));
+    TEST_ASSERT_STR_EQ("line 639", editorRowText(editorRowAt(nlines - 1)));
+
+    cleanup_editor();
+}
+
+/* 遅延読み込み無効時は従来通り全行を読み込む */
+void test_editorOpen_eager() {
+    setup_editor();
+
+    const char *content = "a\nb\r\nc\n";
+    write_test_file(content, strlen(content));
+
+    Config.lazy_load = 0;
+    editorOpen((char *)test_file);
+
+    TEST_ASSERT("Eager load should not map the file", E.map == NULL);
+    TEST_ASSERT_EQ_INT(3, E.numrows);
+    TEST_ASSERT_STR_EQ("b", editorRowText(editorRowAt(1)));
+
+    cleanup_editor();
+}
+
+/* ファイルの内容を読み込む（NUL終端、呼び出し側で解放） */
+static char *read_test_file(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return NULL;
+    char *buf = calloc(1, 4096);
+    fread(buf, 1, 4095, fp);
+    fclose(fp);
+    return buf;
+}
+
+/* 保存内容は遅延読み込みでも同じになる */
+void test_editorWriteFile_lazy() {
+    setup_editor();
+
+    const char *content = "x\ny\r\nz";
+    write_test_file(content, strlen(content));
+
+    editorOpen((char *)test_file);
+
+    const char *path = "test_file_out_tmp.txt";
+    size_t len = 0;
+    TEST_ASSERT_EQ_INT(0, editorWriteFile(path, &len));
+    TEST_ASSERT_EQ_INT(6, (int)len);
+    char *buf = read_test_file(path);
+    TEST_ASSERT_STR_EQ("x\ny\nz\n", buf);
+    free(buf);
+    unlink(path);
+
+    cleanup_editor();
+}
+
+/* 保存用の一時ファイルが残っていないか */
+static int temp_files_left() {
+    DIR *dir = opendir(".");
+    struct dirent *ent;
+    int n = 0;
+    while ((ent = readdir(dir))) {
+        if (strncmp(ent->d_name, ".test_file_tmp.txt.", 19) == 0) n++;
+    }
+    closedir(dir);
+    return n;
+}
+
+/* 保存は内容を置き換え、パーミッションを引き継ぐ */
+void test_editorSave_replace() {
+    setup_editor();
+
+    const char *content = "a\nb\n";
+    write_test_file(content, strlen(content));
+    chmod(test_file, 0600);
+    Config.lazy_load = 0;
+    editorOpen((char *)test_file);
+
+    editorInsertRow(1, "new", 3);
+    editorSave();
+    editorSaveWait();
+
+    char *saved = read_test_file(test_file);
+    TEST_ASSERT_STR_EQ("a\nnew\nb\n", saved);
+    free(saved);
+    TEST_ASSERT_EQ_INT(0, E.dirty);
+    TEST_ASSERT("Status should report bytes written",
+                strncmp(E.statusmsg, "8 bytes written to disk in ", 27) == 0);
+
+    struct stat st;
+    stat(test_file, &st);
+    TEST_ASSERT_EQ_INT(0600, st.st_mode & 07777);
+    TEST_ASSERT_EQ_INT(0, temp_files_left());
+
+    cleanup_editor();
+}
+
+/* 新しいファイルは起動時のumaskに従ったパーミッションで作る */
+void test_editorSave_new_file_umask() {
+    setup_editor();
+    unlink(test_file);
+    E.umask = 027;
+    E.filename = strdup(test_file);
+
+    editorInsertRow(0, "new", 3);
+    editorSave();
+    editorSaveWait();
+
+    struct stat st;
+    TEST_ASSERT_EQ_INT(0, stat(test_file, &st));
+    TEST_ASSERT_EQ_INT(0640, st.st_mode & 07777);
+
+    cleanup_editor();
+}
+
+/* 遅延読み込み中のファイルも保存でき、マッピングは元の内容のまま使える */
+void test_editorSave_lazy() {
+    setup_editor();
+
+    int nlines = ROW_CHUNK_MAX * 3;
+    char *content = malloc(nlines * 16);
+    size_t len = 0;
+    for (int i = 0; i < nlines; i++) len += sprintf(content + len, "line %d\n", i);
+    write_test_file(content, len);
+    free(content);
+
+    Config.lazy_load = 1;
+    editorOpen((char *)test_file);
+    TEST_ASSERT_NOT_NULL(E.map);
+    editorRowAppendString(editorRowAt(0), "!", 1);
+    editorSave();
+    editorSaveWait();
+    TEST_ASSERT_EQ_INT(0, E.dirty);
+    TEST_ASSERT("Mapping should still hold the old content", memcmp(E.map, "line 0\n", 7) == 0);
+
+    char *saved = read_test_file(test_file);
+    TEST_ASSERT("Saved file should contain the edit", strncmp(saved, "line 0!\nline 1\n", 15) == 0);
+    free(saved);
+
+    cleanup_editor();
+}
+
+/* シンボリックリンク越しの保存はリンク先を置き換える */
+void test_editorSave_symlink() {
+    setup_editor();
+
+    const char *link = "test_file_link.txt";
+    write_test_file("old\n", 4);
+    unlink(link);
+    TEST_ASSERT_EQ_INT(0, symlink(test_file, link));
+
+    Config.lazy_load = 0;
+    editorOpen((char *)link);
+    editorRowAppendString(editorRowAt(0), "er", 2);
+    editorSave();
+    editorSaveWait();
+
+    struct stat st;
+    lstat(link, &st);
+    TEST_ASSERT("Link should remain a symlink", S_ISLNK(st.st_mode));
+    char *saved = read_test_file(test_file);
+    TEST_ASSERT_STR_EQ("older\n", saved);
+    free(saved);
+
+    unlink(link);
+    cleanup_editor();
+}
+
+/* 保存は未展開のチャンクもギャップのある行も、行を連結した内容と同じになる */
+void test_editorSave_streamed() {
+    setup_editor();
+
+    // writevを何回かに分ける行数で、CRLFの行と改行で終わらない最終行を含める
+    int nlines = ROW_CHUNK_MAX * 40;
+    char *content = malloc(nlines * 16);
+    size_t len = 0;
+    for (int i = 0; i < nlines; i++) {
+        const char *eol = i / ROW_CHUNK_MAX == 5 ? "\r\n" : i == nlines - 1 ? "" : "\n";
+        len += sprintf(content + len, "row %d%s", i, eol);
+    }
+    write_test_file(content, len);
+    free(content);
+
+    Config.lazy_load = 1;
+    editorOpen((char *)test_file);
+    TEST_ASSERT_NOT_NULL(E.map);
+
+    // 行の途中に挿入してギャップを残す
+    erow *row = editorRowAt(ROW_CHUNK_MAX * 2 + 1);
+    editorRowInsertChar(row, 1, 'X');
+    TEST_ASSERT("Row should keep its gap", row->gap >= 0);
+    TEST_ASSERT("Other chunks should stay lazy", ropePeekPrev(editorRowAt(ROW_CHUNK_MAX * 2)) == NULL);
+
+    editorSave();
+    editorSaveWait();
+    TEST_ASSERT("Saving should not close the gap", row->gap >= 0);
+
+    // 改行はLFに揃え、挿入した文字を含む
+    char *expect = malloc(nlines * 16);
+    size_t expect_len = 0;
+    for (int i = 0; i < nlines; i++) {
+        expect_len += sprintf(expect + expect_len, i == ROW_CHUNK_MAX * 2 + 1 ? "rXow %d\n" : "row %d\n", i);
+    }
+    FILE *fp = fopen(test_file, "r");
+    char *saved = malloc(expect_len + 1);
+    size_t saved_len = fread(saved, 1, expect_len + 1, fp);
+    fclose(fp);
+    TEST_ASSERT_EQ_INT((int)expect_len, (int)saved_len);
+    TEST_ASSERT("Saved file should match the edited rows", memcmp(saved, expect, expect_len) == 0);
+    free(saved);
+    free(expect);
+
+    cleanup_editor();
+}
+
+/* 保存後の編集と再保存でも、未変更の範囲は開いた時点の内容からコピーされる */
+void test_editorSave_twice() {
+    setup_editor();
+
+    int nlines = ROW_CHUNK_MAX * 10;
+    char *content = malloc(nlines * 16);
+    size_t len = 0;
+    for (int i = 0; i < nlines; i++) len += sprintf(content + len, "line %d\n", i);
+    write_test_file(content, len);
+
+    Config.lazy_load = 1;
+    editorOpen((char *)test_file);
+    editorRowAppendString(editorRowAt(ROW_CHUNK_MAX * 3), "!", 1);
+    editorSave();
+    editorSaveWait();
+    editorDelRow(ROW_CHUNK_MAX * 7);
+    editorInsertRow(0, "top", 3);
+    editorSave();
+    editorSaveWait();
+
+    char *expect = malloc(len + 16);
+    char *p = expect + sprintf(expect, "top\n");
+    for (int i = 0; i < nlines; i++) {
+        if (i == ROW_CHUNK_MAX * 7) continue;
+        p += sprintf(p, "line %d%s\n", i, i == ROW_CHUNK_MAX * 3 ? "!" : "");
+    }
+    FILE *fp = fopen(test_file, "r");
+    char *saved = malloc(len + 16);
+    size_t saved_len = fread(saved, 1, len + 16, fp);
+    fclose(fp);
+    TEST_ASSERT_EQ_INT((int)(p - expect), (int)saved_len);
+    TEST_ASSERT("Second save should keep both edits", memcmp(saved, expect, saved_len) == 0);
+    free(saved);
+    free(expect);
+    free(content);
+
+    cleanup_editor();
+}
+
+/* 保存中の編集はスナップショットに影響せず、未保存の変更として残る */
+void test_editorSave_background() {
+    setup_editor();
+
+    const char *content = "alpha\nbeta gamma\ndelta\nepsilon\n";
+    write_test_file(content, strlen(content));
+    Config.lazy_load = 0;
+    editorOpen((char *)test_file);
+    // ギャップのある行も含める
+    editorRowInsertChar(editorRowAt(3), 0, '>');
+    E.dirty = 1;
+
+    editorSave();
+    TEST_ASSERT_STR_EQ("Saving...", E.statusmsg);
+
+    // 保存の完了を待たずに、参照されている行を書き換え・分割・削除する
+    editorRowInsertChar(editorRowAt(0), 5, '!');
+    editorRowAppendString(editorRowAt(3), "?", 1);
+    E.cy = 1;
+    E.cx = 4;
+    editorInsertNewLine();
+    editorDelRow(3);
+    TEST_ASSERT_STR_EQ("alpha!", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_STR_EQ("beta", editorRowText(editorRowAt(1)));
+
+    editorSaveWait();
+    char *saved = read_test_file(test_file);
+    TEST_ASSERT_STR_EQ("alpha\nbeta gamma\ndelta\n>epsilon\n", saved);
+    free(saved);
+    TEST_ASSERT("Status should report bytes written", strncmp(E.statusmsg, "32 bytes written", 16) == 0);
+    TEST_ASSERT("Edits made during the save should stay unsaved", E.dirty > 0);
+    TEST_ASSERT_STR_EQ(">epsilon?", editorRowText(editorRowAt(3)));
+
+    // 次の保存で残りの変更も書き込まれる
+    editorSave();
+    editorSaveWait();
+    TEST_ASSERT_EQ_INT(0, E.dirty);
+    saved = read_test_file(test_file);
+    TEST_ASSERT_STR_EQ("alpha!\nbeta\n gamma\n>epsilon?\n", saved);
+    free(saved);
+
+    cleanup_editor();
+}
+
+/* 保存後の変更フラグは編集の回数ではなく、保存した時点の内容に戻ったかどうかで決まる */
+void test_editorSave_dirty_undo() {
+    setup_editor();
+
+    write_test_file("alpha\n", 6);
+    Config.lazy_load = 0;
+    editorOpen((char *)test_file);
+    E.cy = 0;
+    E.cx = 5;
+    editorInsertChar('1');
+
+    // 保存中に入力して取り消すと、保存した内容と同じなので変更なし
+    editorSave();
+    editorInsertChar('2');
+    editorInsertChar('3');
+    editorUndo();
+    editorSaveWait();
+    TEST_ASSERT_EQ_INT(0, E.dirty);
+
+    // 保存中に保存済みの編集を取り消すと、編集の回数によらず変更ありのまま
+    editorSave();
+    editorUndo();
+    editorSaveWait();
+    TEST_ASSERT("Undoing a saved edit should leave the buffer modified", E.dirty > 0);
+    char *saved = read_test_file(test_file);
+    TEST_ASSERT_STR_EQ("alpha1\n", saved);
+    free(saved);
+
+    // やり直して保存した内容に戻れば変更なし
+    editorRedo();
+    editorSave();
+    editorSaveWait();
+    TEST_ASSERT_EQ_INT(0, E.dirty);
+    // 保存した時点の入力には続けてまとめず、取り消すと保存した内容に戻る
+    editorInsertChar('4');
+    TEST_ASSERT("Typing after a save should be modified", E.dirty > 0);
+    editorUndo();
+    TEST_ASSERT_STR_EQ("alpha1", editorRowText(editorRowAt(0)));
+
+    cleanup_editor();
+}
+
+/* 保存に失敗したら変更フラグを残し、元のファイルには触れない */
+void test_editorSave_failure() {
+    setup_editor();
+
+    editorInsertRow(0, "text", 4);
+    E.dirty = 1;
+    E.filename = strdup("no_such_dir/test_file_tmp.txt");
+    editorSave();
+    editorSaveWait();
+
+    TEST_ASSERT_EQ_INT(1, E.dirty);
+    TEST_ASSERT("Status should report the error", strncmp(E.statusmsg, "Can't save!", 11) == 0);
+
+    cleanup_editor();
+}
+
+int main() {
+    TEST_GROUP("File I/O");
+
+    RUN_TEST(test_editorOpen_lazy_line_endings);
+    RUN_TEST(test_editorOpen_lazy_materialize);
+    RUN_TEST(test_editorOpen_eager);
+    RUN_TEST(test_editorWriteFile_lazy);
+    RUN_TEST(test_editorSave_replace);
+    RUN_TEST(test_editorSave_new_file_umask);
+    RUN_TEST(test_editorSave_lazy);
+    RUN_TEST(test_editorSave_symlink);
+    RUN_TEST(test_editorSave_streamed);
+    RUN_TEST(test_editorSave_twice);
+    RUN_TEST(test_editorSave_background);
+    RUN_TEST(test_editorSave_dirty_undo);
+    RUN_TEST(test_editorSave_failure);
+
+    TEST_SUMMARY();
+}
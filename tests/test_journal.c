@@ -0,0 +1,359 @@
+/**
+ * test_journal.c - 障害復旧用ジャーナルのテスト
+ */
+
+#define _GNU_SOURCE
+#include "minunit.h"
+#include "../src/kiloe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* 外部変数 */
+extern struct editorConfig E;
+extern struct editorSettings Config;
+
+static const char *test_file = "test_journal_tmp.txt";
+static const char *journal_file = ".test_journal_tmp.txt.kiloe-journal";
+
+/* テスト用のセットアップ（ファイルを開き、ジャーナルが残っていれば復元する） */
+static void open_editor(int lazy) {
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    Config.lazy_load = lazy;
+    // 書き込みは閉じる時か操作数の上限に達した時だけにする
+    Config.journal_delay = 1000000;
+    editorOpen((char *)test_file);
+}
+
+/* 異常終了を模擬（記録済みの操作は書き込むが、ジャーナルは残す） */
+static void crash_editor() {
+    editorJournalClose(0);
+    editorFreeRows();
+    free(E.filename);
+    E.filename = NULL;
+}
+
+/* テスト用のクリーンアップ */
+static void cleanup_editor() {
+    editorJournalClose(1);
+    editorFreeRows();
+    free(E.filename);
+    E.filename = NULL;
+    unlink(test_file);
+    unlink(journal_file);
+}
+
+/* テスト用ファイルを作成 */
+static void write_test_file(const char *content) {
+    FILE *fp = fopen(test_file, "w");
+    if (fp) {
+        fputs(content, fp);
+        fclose(fp);
+    }
+}
+
+/* ファイルの大きさ（なければ-1） */
+static long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+/* 全行を保存と同じ経路で書き出し、改行区切りの文字列として読み戻す（呼び出し側で解放） */
+static char *buffer_text() {
+    const char *path = "test_journal_text_tmp.txt";
+    size_t len = 0;
+    editorWriteFile(path, &len);
+    char *buf = malloc(len + 1);
+    FILE *fp = fopen(path, "r");
+    size_t n = fp ? fread(buf, 1, len, fp) : 0;
+    if (fp) fclose(fp);
+    buf[n] = '\0';
+    unlink(path);
+    return buf;
+}
+
+/* ファイルの内容を読み込む（呼び出し側で解放） */
+static char *read_test_file() {
+    FILE *fp = fopen(test_file, "r");
+    if (!fp) return strdup("");
+    char *buf = malloc(1 << 16);
+    size_t n = fread(buf, 1, (1 << 16) - 1, fp);
+    buf[n] = '\0';
+    fclose(fp);
+    return buf;
+}
+
+/* 文字列を1文字ずつ入力する */
+static void type(const char *s) {
+    for (; *s; s++) {
+        if (*s == '\n') editorInsertNewLine();
+        else editorInsertChar(*s);
+    }
+}
+
+/* ジャーナルバッファ中の編集を一通り行う */
+static void edit_some() {
+    E.cy = 0;
+    E.cx = 5;
+    type("XY");
+    E.cy = 1;
+    E.cx = 2;
+    editorInsertNewLine();
+    editorDelChar();
+    editorDelChar();
+    E.cy = 3;
+    E.cx = 0;
+    editorInsertText("p\r\nq", 4);
+    editorUndo();
+    editorUndo();
+    editorRedo();
+    E.cy = E.numrows;
+    E.cx = 0;
+    type("end");
+}
+
+/* 保存せずに終了した編集を、開き直した時に復元する */
+void test_journal_recover() {
+    write_test_file("alpha\nbeta\ngamma\n");
+    open_editor(0);
+    edit_some();
+    char *expect = buffer_text();
+    TEST_ASSERT_STR_EQ("alphaXY\nbta\ngamma\nend\n", expect);
+    crash_editor();
+
+    TEST_ASSERT("Journal should be left", file_size(journal_file) > 0);
+    open_editor(0);
+    char *text = buffer_text();
+    TEST_ASSERT_STR_EQ(expect, text);
+    free(text);
+    TEST_ASSERT("Recovered buffer should be dirty", E.dirty > 0);
+    TEST_ASSERT("Status should report recovery", strstr(E.statusmsg, "Recovered") != NULL);
+
+    // 復元後の編集は同じジャーナルに続けて記録する
+    E.cy = 0;
+    E.cx = 0;
+    type(">");
+    crash_editor();
+    open_editor(0);
+    text = buffer_text();
+    TEST_ASSERT_STR_EQ(">alphaXY\nbta\ngamma\nend\n", text);
+    free(text);
+
+    // 保存したらジャーナルは不要になる
+    editorSave();
+    editorSaveWait();
+    TEST_ASSERT_EQ_INT(-1, (int)file_size(journal_file));
+    text = read_test_file();
+    TEST_ASSERT_STR_EQ(">alphaXY\nbta\ngamma\nend\n", text);
+    free(text);
+
+    free(expect);
+    cleanup_editor();
+}
+
+/* 遅延読み込みしたファイルでも、編集した行だけを展開して復元する */
+void test_journal_recover_lazy() {
+    int nlines = ROW_CHUNK_MAX * 10;
+    char *content = malloc(nlines * 16);
+    size_t len = 0;
+    for (int i = 0; i < nlines; i++) len += sprintf(content + len, "line %d\n", i);
+    write_test_file(content);
+    free(content);
+
+    open_editor(1);
+    E.cy = 500;
+    E.cx = 0;
+    type("edited ");
+    E.cy = 100;
+    E.cx = 4;
+    editorInsertNewLine();
+    crash_editor();
+
+    open_editor(1);
+    TEST_ASSERT_EQ_INT(nlines + 1, E.numrows);
+    TEST_ASSERT("Chunks before the edited rows should stay lazy",
+                ropePeekPrev(editorRowAt(ROW_CHUNK_MAX)) == NULL);
+    TEST_ASSERT("Chunks after the edited rows should stay lazy",
+                ropePeekNext(editorRowAt(ROW_CHUNK_MAX * 8)) == NULL);
+    TEST_ASSERT_STR_EQ("line", editorRowText(editorRowAt(100)));
+    TEST_ASSERT_STR_EQ(" 100", editorRowText(editorRowAt(101)));
+    TEST_ASSERT_STR_EQ("line 499", editorRowText(editorRowAt(500)));
+    TEST_ASSERT_STR_EQ("edited line 500", editorRowText(editorRowAt(501)));
+    TEST_ASSERT_STR_EQ("line 639", editorRowText(editorRowAt(nlines)));
+
+    cleanup_editor();
+}
+
+/* 前後に離れた位置の編集や、大きな貼り付けも順に適用して復元する */
+void test_journal_recover_scattered() {
+    write_test_file("alpha\nbeta\ngamma\ndelta\n");
+    open_editor(0);
+    char big[8192];
+    for (size_t i = 0; i < sizeof(big); i++) big[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+    for (int i = 0; i < 20; i++) {
+        E.cy = (i * 7) % E.numrows;
+        E.cx = 0;
+        type(i % 2 ? "<" : "\n");
+        E.cy = E.numrows - 1 - (i * 3) % E.numrows;
+        E.cx = editorRowAt(E.cy)->size;
+        editorDelChar();
+        if (i % 5 == 0) editorInsertText(big, sizeof(big) - 1);
+    }
+    char *expect = buffer_text();
+    int cy = E.cy, cx = E.cx;
+    crash_editor();
+
+    open_editor(0);
+    char *text = buffer_text();
+    TEST_ASSERT_STR_EQ(expect, text);
+    TEST_ASSERT_EQ_INT(cy, E.cy);
+    TEST_ASSERT_EQ_INT(cx, E.cx);
+    free(text);
+
+    free(expect);
+    cleanup_editor();
+}
+
+/* 書き込み途中で壊れた末尾は捨て、そこまでのレコードを復元する */
+void test_journal_torn_tail() {
+    write_test_file("alpha\nbeta\ngamma\n");
+    open_editor(0);
+    edit_some();
+    char *expect = buffer_text();
+    crash_editor();
+
+    long size = file_size(journal_file);
+    FILE *fp = fopen(journal_file, "a");
+    fwrite("\x01\x02\x03\x04\x00\x00\x00\x00\x00\x00\x00\x00\x05\x00\x00\x00", 1, 16, fp);
+    fclose(fp);
+
+    open_editor(0);
+    char *text = buffer_text();
+    TEST_ASSERT_STR_EQ(expect, text);
+    free(text);
+    TEST_ASSERT_EQ_INT((int)size, (int)file_size(journal_file));
+
+    free(expect);
+    cleanup_editor();
+}
+
+/* 書き換えられたファイルにはジャーナルを適用せず、そのまま残す */
+void test_journal_stale() {
+    write_test_file("alpha\nbeta\ngamma\n");
+    open_editor(0);
+    edit_some();
+    crash_editor();
+    long size = file_size(journal_file);
+
+    write_test_file("changed elsewhere\n");
+    open_editor(0);
+    char *text = buffer_text();
+    TEST_ASSERT_STR_EQ("changed elsewhere\n", text);
+    free(text);
+    TEST_ASSERT("Status should report the mismatch", strstr(E.statusmsg, "does not match") != NULL);
+
+    // このセッションの編集では上書きしない
+    type("x");
+    editorJournalClose(0);
+    TEST_ASSERT_EQ_INT((int)size, (int)file_size(journal_file));
+
+    cleanup_editor();
+}
+
+/* 書き込みは操作数の上限に達するか、入力が止まった時にまとめて行う */
+void test_journal_group_commit() {
+    write_test_file("alpha\nbeta\ngamma\n");
+    open_editor(0);
+    Config.journal_ops = 4;
+
+    // journal_ops件たまるまでは書き込まない
+    E.cy = 0;
+    E.cx = 0;
+    editorInsertNewLine();
+    editorInsertNewLine();
+    editorInsertNewLine();
+    TEST_ASSERT_EQ_INT(0, (int)file_size(journal_file));
+    editorInsertNewLine();
+    for (int i = 0; i < 200 && file_size(journal_file) == 0; i++) usleep(10000);
+    long size = file_size(journal_file);
+    TEST_ASSERT("Journal should be written after journal_ops edits", size > 0);
+
+    // 入力が止まったらjournal_delay後に書き込む（続けて入力した文字は1つのレコードにまとめる）
+    Config.journal_ops = 1000;
+    Config.journal_delay = 20;
+    type("abcdefghij");
+    for (int i = 0; i < 200 && file_size(journal_file) == size; i++) usleep(10000);
+    long typed = file_size(journal_file);
+    TEST_ASSERT("Journal should be written when input stops", typed > size);
+    type("klmnopqrst");
+    for (int i = 0; i < 200 && file_size(journal_file) == typed; i++) usleep(10000);
+    // 書き込み済みのレコードにはまとめないので、同じ大きさのレコードがもう1つ増える
+    TEST_ASSERT_EQ_INT((int)(typed - size), (int)(file_size(journal_file) - typed));
+
+    crash_editor();
+    open_editor(0);
+    char *text = buffer_text();
+    TEST_ASSERT_STR_EQ("\n\n\n\nabcdefghijklmnopqrstalpha\nbeta\ngamma\n", text);
+    free(text);
+
+    cleanup_editor();
+}
+
+/* 保存中の編集はジャーナルに残り、保存したファイルに対して復元できる */
+void test_journal_save_in_progress() {
+    write_test_file("alpha\nbeta\ngamma\n");
+    open_editor(0);
+    E.cy = 0;
+    E.cx = 0;
+    type("saved ");
+    editorSave();
+    E.cy = 2;
+    E.cx = 5;
+    type(" unsaved");
+    editorSaveWait();
+    TEST_ASSERT("Journal should keep edits made during the save", file_size(journal_file) > 0);
+    char *text = read_test_file();
+    TEST_ASSERT_STR_EQ("saved alpha\nbeta\ngamma\n", text);
+    free(text);
+    crash_editor();
+
+    open_editor(0);
+    text = buffer_text();
+    TEST_ASSERT_STR_EQ("saved alpha\nbeta\ngamma unsaved\n", text);
+    free(text);
+
+    // 保存せずに変更を破棄して終了するとジャーナルは削除する
+    editorJournalClose(1);
+    TEST_ASSERT_EQ_INT(-1, (int)file_size(journal_file));
+
+    cleanup_editor();
+}
+
+/* 無効にした場合は記録しない */
+void test_journal_disabled() {
+    write_test_file("alpha\n");
+    open_editor(0);
+    Config.journal = 0;
+    type("x");
+    editorJournalClose(0);
+    TEST_ASSERT_EQ_INT(-1, (int)file_size(journal_file));
+
+    cleanup_editor();
+}
+
+int main() {
+    TEST_GROUP("Journal");
+
+    RUN_TEST(test_journal_recover);
+    RUN_TEST(test_journal_recover_lazy);
+    RUN_TEST(test_journal_recover_scattered);
+    RUN_TEST(test_journal_torn_tail);
+    RUN_TEST(test_journal_stale);
+    RUN_TEST(test_journal_group_commit);
+    RUN_TEST(test_journal_save_in_progress);
+    RUN_TEST(test_journal_disabled);
+
+    TEST_SUMMARY();
+}
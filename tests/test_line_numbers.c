@@ -17,7 +17,7 @@ extern struct editorSettings Config;
 static void setup_editor() {
     memset(&E, 0, sizeof(E));
     E.numrows = 0;
-    E.row = NULL;
+    E.rowroot = NULL;
     E.dirty = 0;
     E.filename = NULL;
     E.syntax = NULL;
@@ -31,13 +31,8 @@ static void setup_editor() {
 
 /* テスト用のクリーンアップ */
 static void cleanup_editor() {
-    for (int i = 0; i < E.numrows; i++) {
-        editorFreeRow(&E.row[i]);
-    }
-    free(E.row);
+    editorFreeRows();
     free(E.filename);
-    E.row = NULL;
-    E.numrows = 0;
 }
 
 /* 行番号表示無効時のテスト */
@@ -51,8 +46,8 @@ void test_line_numbers_disabled() {
     
     // 行番号表示が無効の場合、通常通り動作することを確認
     TEST_ASSERT_EQ_INT(2, E.numrows);
-    TEST_ASSERT_STR_EQ("Line 1", E.row[0].chars);
-    TEST_ASSERT_STR_EQ("Line 2", E.row[1].chars);
+    TEST_ASSERT_STR_EQ("Line 1", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_STR_EQ("Line 2", editorRowText(editorRowAt(1)));
     
     cleanup_editor();
 }
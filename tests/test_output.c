@@ -0,0 +1,151 @@
+/**
+ * test_output.c - 画面出力関数のテスト
+ */
+
+#define _GNU_SOURCE
+#include "minunit.h"
+#include "../src/kiloe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 外部変数 */
+extern struct editorConfig E;
+extern struct editorSettings Config;
+
+/* テスト用のセットアップ */
+static void setup_editor(int nrows) {
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    Config.show_line_numbers = 0;
+    E.screenrows = 5;
+    E.screencols = 20;
+
+    for (int i = 0; i < nrows; i++) {
+        char line[16];
+        int len = snprintf(line, sizeof(line), "line %d", i);
+        editorInsertRow(i, line, len);
+    }
+    E.dirty = 0;
+    editorScreenInvalidate();
+}
+
+/* テスト用のクリーンアップ */
+static void cleanup_editor() {
+    editorFreeRows();
+    free(E.filename);
+    E.filename = NULL;
+}
+
+/* 出力に文字列が含まれるか */
+static int contains(struct abuf *ab, const char *s) {
+    return memmem(ab->b, ab->len, s, strlen(s)) != NULL;
+}
+
+/* 最初の描画は全体、変化がなければ本文を出力しない */
+void test_render_full_then_idle() {
+    setup_editor(10);
+
+    struct abuf ab = ABUF_INIT;
+    editorRenderFrame(&ab);
+    TEST_ASSERT("First frame should clear the screen", contains(&ab, "\x1b[2J"));
+    TEST_ASSERT("First frame should draw every row", contains(&ab, "line 0") && contains(&ab, "line 4"));
+    abFree(&ab);
+
+    editorRenderFrame(&ab);
+    TEST_ASSERT("Idle frame should not redraw text", !contains(&ab, "line"));
+    TEST_ASSERT("Idle frame should be tiny", ab.len < 32);
+    abFree(&ab);
+
+    cleanup_editor();
+}
+
+/* 1文字の変更は変化した区間だけを出力する */
+void test_render_single_change() {
+    setup_editor(10);
+
+    struct abuf ab = ABUF_INIT;
+    editorRenderFrame(&ab);
+    abFree(&ab);
+
+    editorRowInsertChar(editorRowAt(2), 4, 'X');
+    E.dirty = 0;
+    editorRenderFrame(&ab);
+    TEST_ASSERT("Changed span should start at the edit", contains(&ab, "\x1b[3;5HX 2"));
+    TEST_ASSERT("Unchanged rows should not be redrawn", !contains(&ab, "line 1") && !contains(&ab, "line 3"));
+    abFree(&ab);
+
+    // 行が短くなった場合は行末消去を使う
+    editorRowDelChar(editorRowAt(2), 6);
+    editorRowDelChar(editorRowAt(2), 5);
+    E.dirty = 0;
+    editorRenderFrame(&ab);
+    TEST_ASSERT("Shortened row should be cleared", contains(&ab, "\x1b[3;7H\x1b[K"));
+    abFree(&ab);
+
+    cleanup_editor();
+}
+
+/* 垂直スクロールはスクロール領域で行い、新しく見えた行だけを出力する */
+void test_render_scroll_region() {
+    setup_editor(30);
+
+    struct abuf ab = ABUF_INIT;
+    editorRenderFrame(&ab);
+    abFree(&ab);
+
+    E.cy = 5;
+    editorRenderFrame(&ab);
+    TEST_ASSERT_EQ_INT(1, E.rowoff);
+    TEST_ASSERT("Scroll should use a scroll region", contains(&ab, "\x1b[1;5r\x1b[1S\x1b[r"));
+    TEST_ASSERT("New row should be drawn", contains(&ab, "line 5"));
+    TEST_ASSERT("Scrolled rows should not be redrawn", !contains(&ab, "line 2"));
+    abFree(&ab);
+
+    // 無効時は差分だけで描画する
+    Config.scroll_region = 0;
+    E.cy = 0;
+    editorRenderFrame(&ab);
+    TEST_ASSERT_EQ_INT(0, E.rowoff);
+    TEST_ASSERT("Scroll region should not be used", !contains(&ab, "\x1b[r"));
+    TEST_ASSERT("Only differing cells should be redrawn", contains(&ab, "\x1b[1;6H0"));
+    abFree(&ab);
+
+    cleanup_editor();
+}
+
+/* 全角文字は2桁を占め、途中で区切られない */
+void test_render_wide_chars() {
+    setup_editor(0);
+
+    editorInsertRow(0, "あいう", 9);
+    E.dirty = 0;
+    struct abuf ab = ABUF_INIT;
+    editorRenderFrame(&ab);
+    abFree(&ab);
+
+    // 「い」だけを置き換える
+    editorRowDelChar(editorRowAt(0), 3);
+    editorRowDelChar(editorRowAt(0), 3);
+    editorRowDelChar(editorRowAt(0), 3);
+    editorRowInsertChar(editorRowAt(0), 3, 'x');
+    editorRowInsertChar(editorRowAt(0), 4, 'y');
+    E.dirty = 0;
+    editorRenderFrame(&ab);
+    TEST_ASSERT("Span should start at the wide char column", contains(&ab, "\x1b[1;3Hxy"));
+    TEST_ASSERT("Unchanged wide chars should not be redrawn", !contains(&ab, "あ") && !contains(&ab, "う"));
+    abFree(&ab);
+
+    cleanup_editor();
+}
+
+int main() {
+    TEST_GROUP("Screen Output");
+
+    RUN_TEST(test_render_full_then_idle);
+    RUN_TEST(test_render_single_change);
+    RUN_TEST(test_render_scroll_region);
+    RUN_TEST(test_render_wide_chars);
+
+    TEST_SUMMARY();
+}
@@ -0,0 +1,241 @@
+/**
+ * test_regex.c - 正規表現エンジンのテスト
+ */
+
+#define _GNU_SOURCE
+#include "minunit.h"
+#include "../src/kiloe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* マッチを「開始:長さ」のカンマ区切りで記録する */
+static void collect(int start, int len, void *arg) {
+    char *out = arg;
+    size_t n = strlen(out);
+    snprintf(out + n, 256 - n, "%s%d:%d", n ? "," : "", start, len);
+}
+
+/* マッチを数えるだけ */
+static void collect_none(int start, int len, void *arg) {
+    (void)start;
+    (void)len;
+    (void)arg;
+}
+
+/* パターンを行に照合し、マッチ一覧の文字列を返す（コンパイル失敗なら"error"） */
+static const char *matches(const char *pattern, const char *line) {
+    static char out[256];
+    const char *err;
+    struct regex *re = regexCompile(pattern, &err);
+    if (!re) return "error";
+    out[0] = '\0';
+    regexMatchLine(re, line, strlen(line), collect, out);
+    regexFree(re);
+    return out;
+}
+
+/* 固定文字列と連接・選択 */
+void test_regex_literal_alt() {
+    TEST_ASSERT_STR_EQ("2:3", matches("cde", "abcdefg"));
+    TEST_ASSERT_STR_EQ("0:2,4:2", matches("ab", "abxxab"));
+    TEST_ASSERT_STR_EQ("", matches("xyz", "abcdefg"));
+    // 最左のマッチを選び、その中で最長のものを取る
+    TEST_ASSERT_STR_EQ("0:4", matches("abcd|c", "abcd"));
+    TEST_ASSERT_STR_EQ("0:3", matches("a|ab|abc", "abc"));
+    TEST_ASSERT_STR_EQ("1:4,6:1", matches("(foo|ba)r|z", "xfoor z"));
+}
+
+/* 繰り返し */
+void test_regex_repeat() {
+    TEST_ASSERT_STR_EQ("1:3", matches("a+", "baaab"));
+    TEST_ASSERT_STR_EQ("0:2,3:1", matches("ab?", "ab a"));
+    TEST_ASSERT_STR_EQ("0:6", matches("(ab)*c?d*", "ababcd"));
+    TEST_ASSERT_STR_EQ("0:3,3:3,6:1", matches("a{1,3}", "aaaaaaa"));
+    TEST_ASSERT_STR_EQ("0:4", matches("x{2,}", "xxxx"));
+    TEST_ASSERT_STR_EQ("", matches("x{3}", "xx"));
+    // 空文字列のマッチは行の最初のマッチだけ
+    TEST_ASSERT_STR_EQ("0:0,2:2", matches("x*", "abxx"));
+}
+
+/* 文字クラスとエスケープ */
+void test_regex_classes() {
+    TEST_ASSERT_STR_EQ("3:3", matches("[0-9]+", "abc123def"));
+    TEST_ASSERT_STR_EQ("3:3", matches("\\d+", "abc123def"));
+    TEST_ASSERT_STR_EQ("0:3,4:3", matches("\\w+", "foo bar"));
+    TEST_ASSERT_STR_EQ("3:1", matches("\\s", "foo bar"));
+    TEST_ASSERT_STR_EQ("0:3,4:3", matches("[^ ]+", "foo bar"));
+    TEST_ASSERT_STR_EQ("0:1,2:1", matches("[]x]", "]ax"));
+    TEST_ASSERT_STR_EQ("1:1", matches("[a\\-z]", "b-y"));
+    TEST_ASSERT_STR_EQ("1:3", matches("a\\.b", "xa.bab"));
+    TEST_ASSERT_STR_EQ("0:3", matches("\\D+", "abc123"));
+}
+
+/* 行頭・行末 */
+void test_regex_anchors() {
+    TEST_ASSERT_STR_EQ("0:3", matches("^foo", "foofoo"));
+    TEST_ASSERT_STR_EQ("3:3", matches("foo$", "foofoo"));
+    TEST_ASSERT_STR_EQ("", matches("^bar", "foobar"));
+    TEST_ASSERT_STR_EQ("0:6", matches("^foobar$", "foobar"));
+    TEST_ASSERT_STR_EQ("0:0", matches("^$", ""));
+    TEST_ASSERT_STR_EQ("", matches("^$", "x"));
+    TEST_ASSERT_STR_EQ("0:1,4:1", matches("^a|b$", "axxab"));
+}
+
+/* UTF-8の文字は1文字単位で一致する */
+void test_regex_utf8() {
+    TEST_ASSERT_STR_EQ("0:6", matches("あ.", "あいx"));
+    TEST_ASSERT_STR_EQ("3:6", matches("[いう]+", "あいうx"));
+    TEST_ASSERT_STR_EQ("0:3,3:3", matches(".", "あい"));
+    TEST_ASSERT_STR_EQ("0:6", matches("[^x]+", "あいxx"));
+    TEST_ASSERT_STR_EQ("0:6", matches("(あい)+", "あいxx"));
+}
+
+/* 不正なパターン */
+void test_regex_errors() {
+    TEST_ASSERT_STR_EQ("error", matches("(ab", "ab"));
+    TEST_ASSERT_STR_EQ("error", matches("ab)", "ab"));
+    TEST_ASSERT_STR_EQ("error", matches("[ab", "ab"));
+    TEST_ASSERT_STR_EQ("error", matches("*a", "a"));
+    TEST_ASSERT_STR_EQ("error", matches("a{2,1}", "a"));
+    TEST_ASSERT_STR_EQ("error", matches("[z-a]", "a"));
+    TEST_ASSERT_STR_EQ("error", matches("ab\\", "a"));
+}
+
+/* 先頭の固定文字列の取り出し */
+void test_regex_prefix() {
+    const char *err;
+    int len, literal;
+
+    struct regex *re = regexCompile("foo(bar|baz)", &err);
+    const char *prefix = regexPrefix(re, &len, &literal);
+    TEST_ASSERT_EQ_INT(3, len);
+    TEST_ASSERT("Prefix should be foo", memcmp(prefix, "foo", 3) == 0);
+    TEST_ASSERT_EQ_INT(0, literal);
+    regexFree(re);
+
+    re = regexCompile("a\\.b", &err);
+    prefix = regexPrefix(re, &len, &literal);
+    TEST_ASSERT_EQ_INT(3, len);
+    TEST_ASSERT("Escaped pattern should be literal", literal && memcmp(prefix, "a.b", 3) == 0);
+    regexFree(re);
+
+    re = regexCompile("^abc", &err);
+    regexPrefix(re, &len, &literal);
+    TEST_ASSERT_EQ_INT(3, len);
+    TEST_ASSERT_EQ_INT(0, literal);
+    regexFree(re);
+
+    re = regexCompile("[ab]c", &err);
+    regexPrefix(re, &len, &literal);
+    TEST_ASSERT_EQ_INT(0, len);
+    regexFree(re);
+}
+
+/* バックトラックでは指数時間になるパターンも行長に比例した時間で終わる */
+void test_regex_pathological() {
+    int n = 100000;
+    char *line = malloc(n + 1);
+    memset(line, 'a', n);
+    line[n] = '\0';
+
+    TEST_ASSERT_STR_EQ("", matches("(a*)*b", line));
+    TEST_ASSERT_STR_EQ("", matches("(a|aa)+$x", line));
+
+    const char *err;
+    struct regex *re = regexCompile("(a|a?)+b", &err);
+    TEST_ASSERT_EQ_INT(0, regexMatchLine(re, line, n, collect_none, NULL));
+    regexFree(re);
+
+    // 状態数の上限を超えるパターンでもキャッシュを作り直して続行する
+    unsigned int seed = 3;
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        line[i] = (seed >> 16) & 1 ? 'a' : 'b';
+    }
+    int expect = 0;
+    for (int i = 0; i + 13 <= n; ) {
+        if (line[i] == 'a') {
+            expect++;
+            i += 13;
+        } else {
+            i++;
+        }
+    }
+    re = regexCompile("a[ab]{12}", &err);
+    TEST_ASSERT_EQ_INT(expect, regexMatchLine(re, line, n, collect_none, NULL));
+    regexFree(re);
+    free(line);
+}
+
+/* マッチごとの前向きの走査が行末まで続くパターンでも、行全体で行長に比例した時間で終わる */
+void test_regex_many_long_scans() {
+    int n = 200000;
+    char *line = malloc(n + 1);
+    memset(line, 'x', n);
+    line[n] = '\0';
+
+    const char *err;
+    struct regex *re = regexCompile("x|x.*y", &err);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    TEST_ASSERT_EQ_INT(n, regexMatchLine(re, line, n, collect_none, NULL));
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+    // 各マッチから行末まで読み直すと数十秒かかる
+    TEST_ASSERT("Matching should take time linear in the line length", ms < 1000);
+
+    // 最後にyがあれば先頭からの1つのマッチになる
+    line[n - 1] = 'y';
+    TEST_ASSERT_EQ_INT(1, regexMatchLine(re, line, n, collect_none, NULL));
+    regexFree(re);
+
+    // 合流した走査の結果を使っても最長一致が変わらない
+    TEST_ASSERT_STR_EQ("0:3,3:1,4:1", matches("ab|a.*c|b", "abcbb"));
+    TEST_ASSERT_STR_EQ("0:5,5:1", matches("a(b|c)*d|b", "abcbdb"));
+    TEST_ASSERT_STR_EQ("0:1,1:4", matches("a|ab*c", "aabbc"));
+    free(line);
+}
+
+/* 中断要求があれば長い1行の照合の途中でも打ち切る */
+void test_regex_cancel() {
+    int n = 1 << 20;
+    char *line = malloc(n + 1);
+    memset(line, 'x', n);
+    line[n] = '\0';
+
+    const char *err;
+    struct regex *re = regexCompile("x+y|x", &err);
+    int cancel = 0;
+    regexSetCancel(re, &cancel);
+    TEST_ASSERT_EQ_INT(n, regexMatchLine(re, line, n, collect_none, NULL));
+    cancel = 1;
+    TEST_ASSERT_EQ_INT(-1, regexMatchLine(re, line, n, collect_none, NULL));
+
+    // 短い行は確認する前に照合し終える
+    TEST_ASSERT_EQ_INT(3, regexMatchLine(re, "xxx", 3, collect_none, NULL));
+
+    // 解除すれば再び照合できる
+    regexSetCancel(re, NULL);
+    line[n - 1] = 'y';
+    TEST_ASSERT_EQ_INT(1, regexMatchLine(re, line, n, collect_none, NULL));
+    regexFree(re);
+    free(line);
+}
+
+int main() {
+    TEST_GROUP("Regex");
+
+    RUN_TEST(test_regex_literal_alt);
+    RUN_TEST(test_regex_repeat);
+    RUN_TEST(test_regex_classes);
+    RUN_TEST(test_regex_anchors);
+    RUN_TEST(test_regex_utf8);
+    RUN_TEST(test_regex_errors);
+    RUN_TEST(test_regex_prefix);
+    RUN_TEST(test_regex_pathological);
+    RUN_TEST(test_regex_many_long_scans);
+    RUN_TEST(test_regex_cancel);
+
+    TEST_SUMMARY();
+}
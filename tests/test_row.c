@@ -17,7 +17,7 @@ extern struct editorSettings Config;
 static void setup_editor() {
     memset(&E, 0, sizeof(E));
     E.numrows = 0;
-    E.row = NULL;
+    E.rowroot = NULL;
     E.dirty = 0;
     E.filename = NULL;
     E.syntax = NULL;
@@ -28,13 +28,8 @@ static void setup_editor() {
 
 /* テスト用のクリーンアップ */
 static void cleanup_editor() {
-    for (int i = 0; i < E.numrows; i++) {
-        editorFreeRow(&E.row[i]);
-    }
-    free(E.row);
+    editorFreeRows();
     free(E.filename);
-    E.row = NULL;
-    E.numrows = 0;
 }
 
 /* editorRowCxToRxのテスト - ASCII文字のみ */
@@ -42,7 +37,7 @@ void test_editorRowCxToRx_ascii() {
     setup_editor();
     
     editorInsertRow(0, "Hello World", 11);
-    erow *row = &E.row[0];
+    erow *row = editorRowAt(0);
     
     TEST_ASSERT_EQ_INT(0, editorRowCxToRx(row, 0));   // 先頭
     TEST_ASSERT_EQ_INT(5, editorRowCxToRx(row, 5));   // "Hello"の後
@@ -56,7 +51,7 @@ void test_editorRowCxToRx_with_tabs() {
     setup_editor();
     
     editorInsertRow(0, "\tHello\tWorld", 12);
-    erow *row = &E.row[0];
+    erow *row = editorRowAt(0);
     
     // タブは8列に展開される（デフォルト）
     TEST_ASSERT_EQ_INT(0, editorRowCxToRx(row, 0));   // 先頭
@@ -72,7 +67,7 @@ void test_editorRowCxToRx_multibyte() {
     setup_editor();
     
     editorInsertRow(0, "あいう", 9);  // 各文字3バイト
-    erow *row = &E.row[0];
+    erow *row = editorRowAt(0);
     
     TEST_ASSERT_EQ_INT(0, editorRowCxToRx(row, 0));  // 先頭
     TEST_ASSERT_EQ_INT(2, editorRowCxToRx(row, 3));  // "あ"の後（表示幅2）
@@ -87,7 +82,7 @@ void test_editorRowRxToCx_ascii() {
     setup_editor();
     
     editorInsertRow(0, "Hello World", 11);
-    erow *row = &E.row[0];
+    erow *row = editorRowAt(0);
     
     TEST_ASSERT_EQ_INT(0, editorRowRxToCx(row, 0));   // 先頭
     TEST_ASSERT_EQ_INT(5, editorRowRxToCx(row, 5));   // 表示位置5
@@ -102,7 +97,7 @@ void test_editorUpdateRow_tabs() {
     setup_editor();
     
     editorInsertRow(0, "a\tb\tc", 5);
-    erow *row = &E.row[0];
+    erow *row = editorRowAt(0);
     
     // renderバッファが正しく作成されているか確認
     TEST_ASSERT_NOT_NULL(row->render);
@@ -122,19 +117,19 @@ void test_editorInsertRow() {
     // 最初の行を挿入
     editorInsertRow(0, "First line", 10);
     TEST_ASSERT_EQ_INT(1, E.numrows);
-    TEST_ASSERT_STR_EQ("First line", E.row[0].chars);
-    TEST_ASSERT_EQ_INT(10, E.row[0].size);
+    TEST_ASSERT_STR_EQ("First line", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_EQ_INT(10, editorRowAt(0)->size);
     
     // 先頭に挿入
     editorInsertRow(0, "New first", 9);
     TEST_ASSERT_EQ_INT(2, E.numrows);
-    TEST_ASSERT_STR_EQ("New first", E.row[0].chars);
-    TEST_ASSERT_STR_EQ("First line", E.row[1].chars);
+    TEST_ASSERT_STR_EQ("New first", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_STR_EQ("First line", editorRowText(editorRowAt(1)));
     
     // 末尾に挿入
     editorInsertRow(2, "Last line", 9);
     TEST_ASSERT_EQ_INT(3, E.numrows);
-    TEST_ASSERT_STR_EQ("Last line", E.row[2].chars);
+    TEST_ASSERT_STR_EQ("Last line", editorRowText(editorRowAt(2)));
     
     cleanup_editor();
 }
@@ -152,13 +147,13 @@ void test_editorDelRow() {
     // 中間の行を削除
     editorDelRow(1);
     TEST_ASSERT_EQ_INT(2, E.numrows);
-    TEST_ASSERT_STR_EQ("Line 1", E.row[0].chars);
-    TEST_ASSERT_STR_EQ("Line 3", E.row[1].chars);
+    TEST_ASSERT_STR_EQ("Line 1", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_STR_EQ("Line 3", editorRowText(editorRowAt(1)));
     
     // 先頭の行を削除
     editorDelRow(0);
     TEST_ASSERT_EQ_INT(1, E.numrows);
-    TEST_ASSERT_STR_EQ("Line 3", E.row[0].chars);
+    TEST_ASSERT_STR_EQ("Line 3", editorRowText(editorRowAt(0)));
     
     cleanup_editor();
 }
@@ -168,42 +163,64 @@ void test_editorRowInsertChar() {
     setup_editor();
     
     editorInsertRow(0, "Hello", 5);
-    erow *row = &E.row[0];
+    erow *row = editorRowAt(0);
     
     // 末尾に文字を挿入
     editorRowInsertChar(row, 5, '!');
     TEST_ASSERT_EQ_INT(6, row->size);
-    TEST_ASSERT_STR_EQ("Hello!", row->chars);
+    TEST_ASSERT_STR_EQ("Hello!", editorRowText(row));
     
     // 先頭に文字を挿入
     editorRowInsertChar(row, 0, '>');
     TEST_ASSERT_EQ_INT(7, row->size);
-    TEST_ASSERT_STR_EQ(">Hello!", row->chars);
+    TEST_ASSERT_STR_EQ(">Hello!", editorRowText(row));
     
     // 中間に文字を挿入
     editorRowInsertChar(row, 1, '<');
     TEST_ASSERT_EQ_INT(8, row->size);
-    TEST_ASSERT_STR_EQ("><Hello!", row->chars);
+    TEST_ASSERT_STR_EQ("><Hello!", editorRowText(row));
     
     cleanup_editor();
 }
 
+/* editorRowInsertStringのテスト */
+void test_editorRowInsertString() {
+    setup_editor();
+
+    editorInsertRow(0, "Hello", 5);
+    erow *row = editorRowAt(0);
+
+    editorRowInsertString(row, 5, " World", 6);
+    TEST_ASSERT_EQ_INT(11, row->size);
+    editorRowInsertString(row, 0, ">> ", 3);
+    editorRowInsertString(row, 8, ",", 1);
+    TEST_ASSERT_STR_EQ(">> Hello, World", editorRowText(row));
+
+    // 空の文字列では変更しない
+    E.dirty = 0;
+    editorRowInsertString(row, 3, "", 0);
+    TEST_ASSERT_EQ_INT(0, E.dirty);
+    TEST_ASSERT_EQ_INT(15, row->size);
+
+    cleanup_editor();
+}
+
 /* editorRowDelCharのテスト */
 void test_editorRowDelChar() {
     setup_editor();
     
     editorInsertRow(0, "Hello!", 6);
-    erow *row = &E.row[0];
+    erow *row = editorRowAt(0);
     
     // 末尾の文字を削除
     editorRowDelChar(row, 5);
     TEST_ASSERT_EQ_INT(5, row->size);
-    TEST_ASSERT_STR_EQ("Hello", row->chars);
+    TEST_ASSERT_STR_EQ("Hello", editorRowText(row));
     
     // 先頭の文字を削除
     editorRowDelChar(row, 0);
     TEST_ASSERT_EQ_INT(4, row->size);
-    TEST_ASSERT_STR_EQ("ello", row->chars);
+    TEST_ASSERT_STR_EQ("ello", editorRowText(row));
     
     // 範囲外の削除（何も起こらない）
     editorRowDelChar(row, 10);
@@ -212,17 +229,44 @@ void test_editorRowDelChar() {
     cleanup_editor();
 }
 
+/* editorRowDelRangeのテスト */
+void test_editorRowDelRange() {
+    setup_editor();
+    
+    editorInsertRow(0, "Hello, 世界!", 14);
+    erow *row = editorRowAt(0);
+    E.dirty = 0;
+    
+    // マルチバイト文字をまとめて削除
+    editorRowDelRange(row, 7, 10);
+    TEST_ASSERT_EQ_INT(11, row->size);
+    TEST_ASSERT_STR_EQ("Hello, 界!", editorRowText(row));
+    TEST_ASSERT_EQ_INT(1, E.dirty);
+    
+    // 行末を超える範囲は行末までに切り詰める
+    editorRowDelRange(row, 5, 100);
+    TEST_ASSERT_STR_EQ("Hello", editorRowText(row));
+    
+    // 空の範囲・逆順の範囲は何もしない
+    editorRowDelRange(row, 3, 3);
+    editorRowDelRange(row, 4, 2);
+    TEST_ASSERT_STR_EQ("Hello", editorRowText(row));
+    TEST_ASSERT_EQ_INT(2, E.dirty);
+    
+    cleanup_editor();
+}
+
 /* editorRowAppendStringのテスト */
 void test_editorRowAppendString() {
     setup_editor();
     
     editorInsertRow(0, "Hello", 5);
-    erow *row = &E.row[0];
+    erow *row = editorRowAt(0);
     
     // 文字列を追加
     editorRowAppendString(row, " World", 6);
     TEST_ASSERT_EQ_INT(11, row->size);
-    TEST_ASSERT_STR_EQ("Hello World", row->chars);
+    TEST_ASSERT_STR_EQ("Hello World", editorRowText(row));
     
     // 空文字列を追加（変化なし）
     editorRowAppendString(row, "", 0);
@@ -240,7 +284,7 @@ void test_mixed_tab_multibyte() {
     setup_editor();
     
     editorInsertRow(0, "日本語\tタブ", 15);  // 日本語(9) + タブ(1) + タブ(6) = 16?
-    erow *row = &E.row[0];
+    erow *row = editorRowAt(0);
     
     // タブ位置の計算が正しいか確認
     int rx_after_japanese = editorRowCxToRx(row, 9);  // "日本語"の後
@@ -252,6 +296,246 @@ void test_mixed_tab_multibyte() {
     cleanup_editor();
 }
 
+/* 行ロープのテスト - チャンク分割をまたぐ挿入・削除 */
+void test_row_rope_insert_delete() {
+    setup_editor();
+    
+    // 参照用の行番号配列と同じ操作を行ロープに適用する
+    int expect[1000];
+    int n = 0;
+    unsigned int seed = 12345;
+    for (int i = 0; i < 1000; i++) {
+        seed = seed * 1103515245 + 12345;
+        int at = (seed >> 16) % (n + 1);
+        char line[16];
+        int len = snprintf(line, sizeof(line), "%d", i);
+        editorInsertRow(at, line, len);
+        memmove(&expect[at + 1], &expect[at], sizeof(int) * (n - at));
+        expect[at] = i;
+        n++;
+    }
+    for (int i = 0; i < 400; i++) {
+        seed = seed * 1103515245 + 12345;
+        int at = (seed >> 16) % n;
+        editorDelRow(at);
+        memmove(&expect[at], &expect[at + 1], sizeof(int) * (n - at - 1));
+        n--;
+    }
+    
+    TEST_ASSERT_EQ_INT(n, E.numrows);
+    
+    // 全行の内容とインデックスが一致するか確認
+    int mismatch = 0;
+    int j = 0;
+    for (erow *row = editorRowAt(0); row; row = editorRowNext(row), j++) {
+        char line[16];
+        snprintf(line, sizeof(line), "%d", expect[j]);
+        if (strcmp(line, editorRowText(row)) != 0) mismatch++;
+        if (editorRowIndex(row) != j) mismatch++;
+        if (editorRowAt(j) != row) mismatch++;
+    }
+    TEST_ASSERT_EQ_INT(n, j);
+    TEST_ASSERT_EQ_INT(0, mismatch);
+    
+    // 前後の行の取得
+    TEST_ASSERT("First row has no previous row", editorRowPrev(editorRowAt(0)) == NULL);
+    TEST_ASSERT("Last row has no next row", editorRowNext(editorRowAt(n - 1)) == NULL);
+    TEST_ASSERT("Previous row across chunks", 
+               editorRowPrev(editorRowAt(ROW_CHUNK_MAX)) == editorRowAt(ROW_CHUNK_MAX - 1));
+    
+    // 範囲外の取得
+    TEST_ASSERT("Out of range row should be NULL", editorRowAt(n) == NULL);
+    TEST_ASSERT("Negative row should be NULL", editorRowAt(-1) == NULL);
+    
+    // 全行削除
+    while (E.numrows > 0) editorDelRow(0);
+    TEST_ASSERT("Rope should be empty", E.rowroot == NULL);
+    
+    cleanup_editor();
+}
+
+/* 削除で行が減ったチャンクは隣と統合し、行配列は行数に合わせて確保する */
+void test_row_rope_merge() {
+    setup_editor();
+
+    int n = ROW_CHUNK_MAX * 16;
+    char line[16];
+    for (int i = 0; i < n; i++) {
+        int len = snprintf(line, sizeof(line), "%d", i);
+        editorInsertRow(i, line, len);
+    }
+    // 満杯のチャンクを途中で分けてから、各チャンクの大半の行を削除する
+    editorInsertRows(ROW_CHUNK_MAX / 2, "x\ny", 3);
+    editorDelRow(ROW_CHUNK_MAX / 2);
+    editorDelRow(ROW_CHUNK_MAX / 2);
+    for (int at = 0; at < E.numrows; at++) {
+        for (int k = 0; k < ROW_CHUNK_MAX - 8 && at + 1 < E.numrows; k++) editorDelRow(at + 1);
+    }
+
+    int chunks = 0, rows = 0, oversized = 0;
+    int start;
+    for (struct rowChunk *c = ropeChunkAt(0, &start); c; c = ropeChunkAt(start + c->n, &start)) {
+        chunks++;
+        rows += c->n;
+        if (c->cap > c->n * 4 || c->cap > ROW_CHUNK_MAX) oversized++;
+    }
+    TEST_ASSERT_EQ_INT(E.numrows, rows);
+    TEST_ASSERT("Underfull chunks should be merged", chunks <= E.numrows / (ROW_CHUNK_MAX / 4) + 1);
+    TEST_ASSERT_EQ_INT(0, oversized);
+
+    // 残った行の内容と順序
+    int mismatch = 0, prev = -1;
+    for (erow *row = editorRowAt(0); row; row = editorRowNext(row)) {
+        int v = atoi(editorRowText(row));
+        if (v <= prev) mismatch++;
+        prev = v;
+    }
+    TEST_ASSERT_EQ_INT(0, mismatch);
+
+    cleanup_editor();
+}
+
+/* 行内ギャップのテスト - 位置を変えながらの挿入・削除 */
+void test_row_gap_edits() {
+    setup_editor();
+    
+    editorInsertRow(0, "", 0);
+    erow *row = editorRowAt(0);
+    
+    // 参照用の文字列と同じ操作を行に適用する
+    char expect[4096];
+    int n = 0;
+    unsigned int seed = 4321;
+    for (int i = 0; i < 3000; i++) {
+        seed = seed * 1103515245 + 12345;
+        int op = (seed >> 16) % 4;
+        seed = seed * 1103515245 + 12345;
+        int at = (seed >> 16) % (n + 1);
+        if (op == 0 && n > 0) {
+            if (at == n) at--;
+            editorRowDelChar(row, at);
+            memmove(&expect[at], &expect[at + 1], n - at - 1);
+            n--;
+        } else if (n < (int)sizeof(expect) - 1) {
+            char c = 'a' + i % 26;
+            editorRowInsertChar(row, at, c);
+            memmove(&expect[at + 1], &expect[at], n - at);
+            expect[at] = c;
+            n++;
+        }
+    }
+    expect[n] = '\0';
+    
+    TEST_ASSERT_EQ_INT(n, row->size);
+    TEST_ASSERT_STR_EQ(expect, editorRowText(row));
+    
+    cleanup_editor();
+}
+
+/* 行内ギャップのテスト - 連続入力で容量が倍々に増え、renderは必要な時に作り直す */
+void test_row_gap_typing() {
+    setup_editor();
+    
+    editorInsertRow(0, "ab", 2);
+    erow *row = editorRowAt(0);
+    
+    for (int i = 0; i < 1000; i++) {
+        editorRowInsertChar(row, 1 + i, 'x');
+    }
+    TEST_ASSERT_EQ_INT(1002, row->size);
+    TEST_ASSERT("Capacity should grow geometrically", row->cap < 4 * row->size);
+    TEST_ASSERT("Gap should stay open while typing", row->gap == 1001);
+    TEST_ASSERT("Render should be rebuilt lazily", row->render == NULL);
+    
+    editorRowEnsureRender(row);
+    TEST_ASSERT_EQ_INT(1002, row->rsize);
+    TEST_ASSERT("Render should match text", row->render[0] == 'a' && row->render[1001] == 'b');
+    TEST_ASSERT("Rendering should close the gap", row->gap == -1);
+    
+    cleanup_editor();
+}
+
+/* 行内ギャップのテスト - ギャップを閉じずにUTF-8文字単位で移動 */
+void test_row_gap_char_moves() {
+    setup_editor();
+    
+    editorInsertRow(0, "あい", 6);
+    erow *row = editorRowAt(0);
+    editorRowInsertChar(row, 3, 'x');  // "あxい"
+    
+    TEST_ASSERT_EQ_INT(0, editorRowPrevChar(row, 3));
+    TEST_ASSERT_EQ_INT(4, editorRowNextChar(row, 3));
+    TEST_ASSERT_EQ_INT(7, editorRowNextChar(row, 4));
+    TEST_ASSERT_EQ_INT(4, editorRowPrevChar(row, 7));
+    TEST_ASSERT("Moves should keep the gap open", row->gap >= 0);
+    TEST_ASSERT_STR_EQ("あxい", editorRowText(row));
+    
+    cleanup_editor();
+}
+
+/* チェックポイントを使わずに先頭から計算した表示位置 */
+static int naive_cx_to_rx(const char *s, int cx) {
+    int rx = 0;
+    for (int j = 0; j < cx; ) {
+        if (s[j] == '\t') {
+            rx += Config.tab_stop - rx % Config.tab_stop;
+            j++;
+        } else {
+            rx += get_char_width((char *)s, j);
+            j = move_to_next_char((char *)s, j, strlen(s));
+        }
+    }
+    return rx;
+}
+
+/* 長い行のcx⇔rx変換 - チェックポイントを使っても先頭からの計算と一致する */
+void test_row_long_line_checkpoints() {
+    setup_editor();
+    
+    // タブと全角文字を含む長い行
+    char *line = malloc(20000);
+    int len = 0;
+    for (int i = 0; len < 19000; i++) {
+        if (i % 7 == 0) len += sprintf(line + len, "\t");
+        else if (i % 5 == 0) len += sprintf(line + len, "日本");
+        else len += sprintf(line + len, "abc");
+    }
+    editorInsertRow(0, line, len);
+    erow *row = editorRowAt(0);
+    
+    int mismatch = 0;
+    for (int cx = 0; cx <= len; cx += 37) {
+        int c = cx == 0 ? 0 : move_to_next_char(line, cx - 1, len);
+        int rx = naive_cx_to_rx(line, c);
+        if (editorRowCxToRx(row, c) != rx) mismatch++;
+        if (editorRowRxToCx(row, rx) != c) mismatch++;
+    }
+    TEST_ASSERT_EQ_INT(0, mismatch);
+    TEST_ASSERT("Checkpoints should be built", row->nckpt > 1);
+    
+    // 行の途中の編集以降のチェックポイントだけを捨てる
+    int before = row->nckpt;
+    editorRowInsertChar(row, 10000, '\t');
+    TEST_ASSERT("Checkpoints before the edit should be kept",
+                row->nckpt > 0 && row->nckpt < before);
+    
+    char *text = editorRowText(row);
+    mismatch = 0;
+    for (int cx = 0; cx <= row->size; cx += 41) {
+        int c = cx == 0 ? 0 : move_to_next_char(text, cx - 1, row->size);
+        int rx = naive_cx_to_rx(text, c);
+        if (editorRowCxToRx(row, c) != rx) mismatch++;
+        if (editorRowRxToCx(row, rx) != c) mismatch++;
+    }
+    TEST_ASSERT_EQ_INT(0, mismatch);
+    
+    // 表示位置が行末を超える場合は行末
+    TEST_ASSERT_EQ_INT(row->size, editorRowRxToCx(row, 1 << 30));
+    
+    free(line);
+    cleanup_editor();
+}
+
 int main() {
     TEST_GROUP("Row Operations");
     
@@ -263,9 +547,17 @@ int main() {
     RUN_TEST(test_editorInsertRow);
     RUN_TEST(test_editorDelRow);
     RUN_TEST(test_editorRowInsertChar);
+    RUN_TEST(test_editorRowInsertString);
     RUN_TEST(test_editorRowDelChar);
+    RUN_TEST(test_editorRowDelRange);
     RUN_TEST(test_editorRowAppendString);
     RUN_TEST(test_mixed_tab_multibyte);
+    RUN_TEST(test_row_rope_insert_delete);
+    RUN_TEST(test_row_rope_merge);
+    RUN_TEST(test_row_gap_edits);
+    RUN_TEST(test_row_gap_typing);
+    RUN_TEST(test_row_gap_char_moves);
+    RUN_TEST(test_row_long_line_checkpoints);
     
     TEST_SUMMARY();
 }
\ No newline at end of file
@@ -0,0 +1,221 @@
+/**
+ * test_scan.c - バイト走査カーネルのテスト
+ */
+
+#define _GNU_SOURCE
+#include "minunit.h"
+#include "../src/kiloe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int kernels[] = {SCAN_KERNEL_SCALAR, SCAN_KERNEL_SSE2, SCAN_KERNEL_AVX2};
+#define NKERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+/* 素朴な実装で改行位置を求める（比較用） */
+static size_t naive_line_ends(const char *buf, size_t len, size_t *ends, size_t cap) {
+    size_t n = 0;
+    for (size_t i = 0; i < len && n < cap; i++) {
+        if (buf[i] == '\n') ends[n++] = i;
+    }
+    return n;
+}
+
+/* 各カーネルの結果を素朴な実装と比較 */
+static int check_all_kernels(const char *buf, size_t len, size_t cap) {
+    size_t expect[512], got[512];
+    size_t n = naive_line_ends(buf, len, expect, cap);
+    int mismatch = 0;
+
+    for (int k = 0; k < NKERNELS; k++) {
+        if (scanUseKernel(kernels[k]) != 0) continue;  // 未対応のCPU
+        size_t m = scanLineEnds(buf, len, got, cap);
+        if (m != n || memcmp(got, expect, n * sizeof(size_t)) != 0) mismatch++;
+    }
+    scanAutoKernel();
+    return mismatch;
+}
+
+/* 空バッファと改行なし */
+void test_scanLineEnds_empty() {
+    TEST_ASSERT_EQ_INT(0, check_all_kernels("", 0, 16));
+    TEST_ASSERT_EQ_INT(0, check_all_kernels("no newline at all", 17, 16));
+
+    size_t ends[4];
+    TEST_ASSERT_EQ_INT(0, (int)scanLineEnds("abc", 3, ends, 4));
+}
+
+/* ベクトル幅の境界をまたぐ改行 */
+void test_scanLineEnds_boundaries() {
+    char buf[200];
+    int mismatch = 0;
+
+    // 長さと改行位置を変えて全組み合わせを確認
+    for (size_t len = 1; len <= 130; len++) {
+        for (size_t pos = 0; pos < len; pos++) {
+            memset(buf, 'x', len);
+            buf[pos] = '\n';
+            mismatch += check_all_kernels(buf, len, 16);
+        }
+    }
+    TEST_ASSERT_EQ_INT(0, mismatch);
+}
+
+/* 改行だけのバッファと上限個数 */
+void test_scanLineEnds_cap() {
+    char buf[300];
+    memset(buf, '\n', sizeof(buf));
+
+    TEST_ASSERT_EQ_INT(0, check_all_kernels(buf, sizeof(buf), 300));
+    TEST_ASSERT_EQ_INT(0, check_all_kernels(buf, sizeof(buf), 7));
+    TEST_ASSERT_EQ_INT(0, check_all_kernels(buf, sizeof(buf), 1));
+
+    // 上限に達したら最後の改行の次から再開できる
+    size_t ends[7];
+    size_t base = 0, total = 0;
+    for (;;) {
+        size_t n = scanLineEnds(buf + base, sizeof(buf) - base, ends, 7);
+        total += n;
+        if (n < 7) break;
+        base += ends[n - 1] + 1;
+    }
+    TEST_ASSERT_EQ_INT(300, (int)total);
+}
+
+/* ランダムなバイト列（CRや高位バイトを含む） */
+void test_scanLineEnds_random() {
+    char buf[4096];
+    unsigned int seed = 42;
+    int mismatch = 0;
+
+    for (int round = 0; round < 50; round++) {
+        for (size_t i = 0; i < sizeof(buf); i++) {
+            seed = seed * 1103515245 + 12345;
+            unsigned int r = (seed >> 16) & 0xff;
+            buf[i] = (r < 8) ? '\n' : (r < 12) ? '\r' : (char)r;
+        }
+        // 先頭をずらして非整列の読み込みも確認
+        mismatch += check_all_kernels(buf + round, sizeof(buf) - round, 512);
+    }
+    TEST_ASSERT_EQ_INT(0, mismatch);
+}
+
+/* 素朴な実装で部分文字列を探す（比較用） */
+static const char *naive_find(const char *hay, size_t len, const char *needle, size_t nlen) {
+    for (size_t i = 0; i + nlen <= len; i++) {
+        if (memcmp(hay + i, needle, nlen) == 0) return hay + i;
+    }
+    return NULL;
+}
+
+/* 各カーネルの検索結果を素朴な実装と比較 */
+static int check_find_all_kernels(const char *hay, size_t len, const char *needle, size_t nlen) {
+    const char *expect = naive_find(hay, len, needle, nlen);
+    int mismatch = 0;
+
+    for (int k = 0; k < NKERNELS; k++) {
+        if (scanUseKernel(kernels[k]) != 0) continue;  // 未対応のCPU
+        if (scanFind(hay, len, needle, nlen) != expect) mismatch++;
+    }
+    scanAutoKernel();
+    return mismatch;
+}
+
+/* 空の検索語・検索対象より長い検索語 */
+void test_scanFind_edge() {
+    const char *s = "abc";
+    TEST_ASSERT("Empty needle should match at start", scanFind(s, 3, "", 0) == s);
+    TEST_ASSERT("Longer needle should not match", scanFind(s, 3, "abcd", 4) == NULL);
+    TEST_ASSERT("Empty haystack should not match", scanFind(s, 0, "a", 1) == NULL);
+    TEST_ASSERT("Single byte", scanFind(s, 3, "c", 1) == s + 2);
+    // NUL終端に依存しない
+    const char *z = "a\0bc";
+    TEST_ASSERT("Should search past NUL", scanFind(z, 4, "bc", 2) == z + 2);
+}
+
+/* ベクトル幅の境界をまたぐマッチ（長さと位置の全組み合わせ） */
+void test_scanFind_boundaries() {
+    char buf[200];
+    const char *needle = "needle-needle-needle-needle-needle-needle";  /* 41バイト */
+    int mismatch = 0;
+
+    for (size_t nlen = 2; nlen <= 41; nlen += 3) {
+        for (size_t len = nlen; len <= 130; len++) {
+            for (size_t pos = 0; pos + nlen <= len; pos += 5) {
+                memset(buf, 'n', len);
+                memcpy(buf + pos, needle, nlen);
+                mismatch += check_find_all_kernels(buf, len, needle, nlen);
+                // 末尾バイトだけ違う偽の候補
+                buf[pos + nlen - 1] ^= 1;
+                mismatch += check_find_all_kernels(buf, len, needle, nlen);
+            }
+        }
+    }
+    TEST_ASSERT_EQ_INT(0, mismatch);
+}
+
+/* 少ない種類のバイトからなるランダムな列（候補が多い場合） */
+void test_scanFind_random() {
+    char buf[4096];
+    char needle[64];
+    unsigned int seed = 7;
+    int mismatch = 0;
+
+    for (int round = 0; round < 200; round++) {
+        for (size_t i = 0; i < sizeof(buf); i++) {
+            seed = seed * 1103515245 + 12345;
+            buf[i] = "ab\n\xe3"[(seed >> 16) & 3];
+        }
+        // バッファ内の一部を検索語にする（見つかる場合と見つからない場合が混ざる）
+        seed = seed * 1103515245 + 12345;
+        size_t nlen = 2 + (seed >> 16) % 48;
+        memcpy(needle, buf + (seed >> 8) % (sizeof(buf) - nlen), nlen);
+        needle[nlen / 2] = 'a' + round % 3;
+        mismatch += check_find_all_kernels(buf + round, sizeof(buf) - round, needle, nlen);
+    }
+    TEST_ASSERT_EQ_INT(0, mismatch);
+}
+
+/* 先頭・末尾バイトは一致するが照合に失敗する位置ばかりの入力 */
+void test_scanFind_degenerate() {
+    size_t len = 100000;
+    char *buf = malloc(len);
+    char needle[41];
+    memset(buf, 'a', len);
+    memset(needle, 'a', sizeof(needle));
+    needle[39] = 'b';
+    int mismatch = check_find_all_kernels(buf, len, needle, sizeof(needle));
+
+    // 末尾付近に本物のマッチを置く
+    memcpy(buf + len - 50, needle, sizeof(needle));
+    mismatch += check_find_all_kernels(buf, len, needle, sizeof(needle));
+    TEST_ASSERT_EQ_INT(0, mismatch);
+    free(buf);
+}
+
+/* カーネル選択 */
+void test_scanKernel_select() {
+    TEST_ASSERT_EQ_INT(0, scanUseKernel(SCAN_KERNEL_SCALAR));
+    TEST_ASSERT_EQ_INT(-1, scanUseKernel(99));
+    TEST_ASSERT_STR_EQ("scalar", scanKernelName(SCAN_KERNEL_SCALAR));
+
+    int best = scanAutoKernel();
+    TEST_ASSERT_TRUE(best >= SCAN_KERNEL_SCALAR && best <= SCAN_KERNEL_AVX2);
+    printf("  auto kernel: %s\n", scanKernelName(best));
+}
+
+int main() {
+    TEST_GROUP("Byte Scanning");
+
+    RUN_TEST(test_scanLineEnds_empty);
+    RUN_TEST(test_scanLineEnds_boundaries);
+    RUN_TEST(test_scanLineEnds_cap);
+    RUN_TEST(test_scanLineEnds_random);
+    RUN_TEST(test_scanFind_edge);
+    RUN_TEST(test_scanFind_boundaries);
+    RUN_TEST(test_scanFind_random);
+    RUN_TEST(test_scanFind_degenerate);
+    RUN_TEST(test_scanKernel_select);
+
+    TEST_SUMMARY();
+}
@@ -0,0 +1,401 @@
+/**
+ * test_search.c - 検索関数のテスト
+ */
+
+#define _GNU_SOURCE
+#include "minunit.h"
+#include "../src/kiloe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 外部変数 */
+extern struct editorConfig E;
+extern struct editorSettings Config;
+
+/* テスト用のセットアップ */
+static void setup_editor(const char **lines, int n) {
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    E.screenrows = 10;
+    E.screencols = 40;
+    for (int i = 0; i < n; i++) editorInsertRow(i, (char *)lines[i], strlen(lines[i]));
+    E.dirty = 0;
+}
+
+/* テスト用のクリーンアップ */
+static void cleanup_editor() {
+    editorFindCallback("", ESC);
+    editorFreeRows();
+    free(E.filename);
+    E.filename = NULL;
+}
+
+/* クエリを1文字ずつ入力する */
+static void type_query(const char *query) {
+    char buf[64];
+    int len = strlen(query);
+    for (int i = 1; i <= len; i++) {
+        memcpy(buf, query, i);
+        buf[i] = '\0';
+        editorFindCallback(buf, query[i - 1]);
+    }
+    editorFindWait();
+}
+
+/* クエリを伸ばすとマッチ一覧を絞り込む */
+void test_search_incremental_narrowing() {
+    const char *lines[] = {"apple", "banana", "applesauce", "grape apple"};
+    setup_editor(lines, 4);
+
+    editorFindCallback("a", 'a');
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(8, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(0, E.cy);
+    TEST_ASSERT_EQ_INT(0, E.cx);
+
+    editorFindCallback("ap", 'p');
+    TEST_ASSERT_EQ_INT(4, editorFindMatchCount());
+
+    // 絞り込みは候補の位置だけを確認する（候補にない行の変更は拾わない）
+    editorRowAppendString(editorRowAt(1), " apple", 6);
+    editorFindCallback("app", 'p');
+    TEST_ASSERT_EQ_INT(3, editorFindMatchCount());
+
+    // クエリを変えた場合は全行を走査し直す
+    editorFindCallback("ba", 'b');
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(1, editorFindMatchCount());
+    editorFindCallback("app", 'p');
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(4, editorFindMatchCount());
+
+    cleanup_editor();
+}
+
+/* 次・前のマッチは一覧を順にたどり、端で折り返す */
+void test_search_next_prev() {
+    const char *lines[] = {"x ab ab", "none", "ab"};
+    setup_editor(lines, 3);
+
+    type_query("ab");
+    TEST_ASSERT_EQ_INT(3, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(0, E.cy);
+    TEST_ASSERT_EQ_INT(2, E.cx);
+
+    editorFindCallback("ab", ARROW_DOWN);
+    TEST_ASSERT_EQ_INT(0, E.cy);
+    TEST_ASSERT_EQ_INT(5, E.cx);
+
+    editorFindCallback("ab", ARROW_RIGHT);
+    TEST_ASSERT_EQ_INT(2, E.cy);
+    TEST_ASSERT_EQ_INT(0, E.cx);
+
+    editorFindCallback("ab", ARROW_DOWN);
+    TEST_ASSERT_EQ_INT(0, E.cy);
+    TEST_ASSERT_EQ_INT(2, E.cx);
+
+    editorFindCallback("ab", ARROW_UP);
+    TEST_ASSERT_EQ_INT(2, E.cy);
+    TEST_ASSERT_EQ_INT(0, E.cx);
+
+    // 同じ行の前のマッチへ戻る
+    editorFindCallback("ab", ARROW_UP);
+    TEST_ASSERT_EQ_INT(0, E.cy);
+    TEST_ASSERT_EQ_INT(5, E.cx);
+
+    cleanup_editor();
+}
+
+/* マッチ位置はrender上の位置でハイライトし、行のハイライト自体は書き換えない */
+void test_search_highlight() {
+    const char *lines[] = {"\tfoo", "あfoo foofoo", "bar"};
+    setup_editor(lines, 3);
+
+    type_query("foo");
+    editorSyntaxEnsure(0, 3);
+    erow *row = editorRowAt(0);
+    const unsigned char *hl = editorFindHighlight(0, row);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[8]);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[10]);
+    TEST_ASSERT("Tab should not be highlighted", hl[7] != HL_MATCH);
+    TEST_ASSERT("Row highlight should be untouched", row->hl[8] != HL_MATCH);
+
+    // 現在のマッチ以外も同時にハイライトする
+    row = editorRowAt(1);
+    hl = editorFindHighlight(1, row);
+    TEST_ASSERT("Wide char should not be highlighted", hl[2] != HL_MATCH);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[3]);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[5]);
+    TEST_ASSERT("Space should not be highlighted", hl[6] != HL_MATCH);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[7]);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[12]);
+
+    row = editorRowAt(2);
+    TEST_ASSERT("Row without matches should use its own highlight",
+                editorFindHighlight(2, row) == row->hl);
+
+    // 検索終了でハイライトも消える
+    editorFindCallback("foo", ESC);
+    TEST_ASSERT_EQ_INT(0, editorFindMatchCount());
+    row = editorRowAt(1);
+    TEST_ASSERT("Highlight should be gone on exit", editorFindHighlight(1, row) == row->hl);
+
+    cleanup_editor();
+}
+
+/* ステータスバー用の「N of M」表示 */
+void test_search_status() {
+    const char *lines[] = {"ab ab", "ab"};
+    setup_editor(lines, 2);
+    char buf[32];
+
+    TEST_ASSERT_EQ_INT(0, editorFindStatus(buf, sizeof(buf)));
+    TEST_ASSERT_STR_EQ("", buf);
+
+    type_query("ab");
+    editorFindStatus(buf, sizeof(buf));
+    TEST_ASSERT_STR_EQ("1 of 3", buf);
+
+    editorFindCallback("ab", ARROW_DOWN);
+    editorFindCallback("ab", ARROW_DOWN);
+    editorFindStatus(buf, sizeof(buf));
+    TEST_ASSERT_STR_EQ("3 of 3", buf);
+
+    editorFindCallback("abc", 'c');
+    editorFindStatus(buf, sizeof(buf));
+    TEST_ASSERT_STR_EQ("0 of 0", buf);
+
+    cleanup_editor();
+}
+
+/* 未展開のチャンクは展開せずに元データを走査する */
+void test_search_lazy_chunks() {
+    const char *path = "test_search_tmp.txt";
+    int nlines = ROW_CHUNK_MAX * 4;
+    FILE *fp = fopen(path, "w");
+    for (int i = 0; i < nlines; i++) {
+        if (i == ROW_CHUNK_MAX * 2 + 3) fputs("\tneedle needle\r\n", fp);
+        else if (i == ROW_CHUNK_MAX * 3 + 1) fputs("needle\r\n", fp);
+        else fputs("needl e\r\n", fp);
+    }
+    fclose(fp);
+
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    Config.lazy_load = 1;
+    editorOpen((char *)path);
+    TEST_ASSERT_EQ_INT(nlines, E.numrows);
+
+    editorFindCallback("needle", 'e');
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(3, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(ROW_CHUNK_MAX * 2 + 3, E.cy);
+    TEST_ASSERT_EQ_INT(1, E.cx);
+    TEST_ASSERT("Chunks before the match should stay lazy",
+                ropePeekPrev(editorRowAt(ROW_CHUNK_MAX * 2)) == NULL);
+
+    editorFindCallback("needle", ARROW_DOWN);
+    TEST_ASSERT_EQ_INT(8, E.cx);
+    editorFindCallback("needle", ARROW_DOWN);
+    TEST_ASSERT_EQ_INT(ROW_CHUNK_MAX * 3 + 1, E.cy);
+    TEST_ASSERT_EQ_INT(0, E.cx);
+
+    cleanup_editor();
+    unlink(path);
+}
+
+/* 未展開のチャンクにある候補は展開せずに絞り込む */
+void test_search_narrow_lazy() {
+    const char *path = "test_search_tmp.txt";
+    int nlines = ROW_CHUNK_MAX * 4;
+    FILE *fp = fopen(path, "w");
+    for (int i = 0; i < nlines; i++) fputs(i % 10 == 0 ? "xab b\r\n" : "xa\r\n", fp);
+    fclose(fp);
+
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    Config.lazy_load = 1;
+    editorOpen((char *)path);
+
+    editorFindCallback("a", 'a');
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(nlines, editorFindMatchCount());
+    editorFindCallback("ab", 'b');
+    TEST_ASSERT_EQ_INT((nlines + 9) / 10, editorFindMatchCount());
+    editorFindCallback("ab ", ' ');
+    TEST_ASSERT_EQ_INT((nlines + 9) / 10, editorFindMatchCount());
+
+    int start;
+    for (int i = 1; i < 4; i++) {
+        TEST_ASSERT("Narrowing should not load chunks", ropeChunkAt(ROW_CHUNK_MAX * i, &start)->rows == NULL);
+    }
+
+    cleanup_editor();
+    unlink(path);
+}
+
+/* クエリを変えると走査中の検索は中断され、新しいクエリの結果だけが残る */
+void test_search_cancel() {
+    int n = 20000;
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    E.screenrows = 10;
+    E.screencols = 40;
+    for (int i = 0; i < n; i++) {
+        if (i % 1000 == 999) editorInsertRow(i, "some target here", 16);
+        else editorInsertRow(i, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", 30);
+    }
+
+    // 大量にマッチするクエリの走査を待たずに別のクエリへ変える
+    editorFindCallback("x", 'x');
+    editorFindCallback("t", 't');
+    editorFindCallback("ta", 'a');
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(n / 1000, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(999, E.cy);
+    TEST_ASSERT_EQ_INT(5, E.cx);
+
+    // 走査中に検索を終了しても結果は残らない
+    editorFindCallback("x", 'x');
+    editorFindCallback("x", ESC);
+    TEST_ASSERT_EQ_INT(0, editorFindMatchCount());
+
+    cleanup_editor();
+}
+
+/* 検索中に展開された行も、走査開始時点の内容で検索される */
+void test_search_snapshot() {
+    const char *lines[] = {"alpha", "beta", "alphabet", "", "alpha"};
+    setup_editor(lines, 5);
+
+    char *chars = editorRowAt(0)->chars;
+    editorFindCallback("alpha", 'a');
+    // 展開済みの行は複製せずに参照する
+    TEST_ASSERT("Snapshot should share the row text", editorRowAt(0)->chars == chars);
+    // 走査開始後の変更や削除は今回の走査には含まれない
+    editorRowAppendString(editorRowAt(1), " alpha", 6);
+    editorRowDelRange(editorRowAt(0), 0, 5);
+    editorDelRow(4);
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(3, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(0, E.cy);
+    TEST_ASSERT_STR_EQ("beta alpha", editorRowText(editorRowAt(1)));
+
+    // 展開済みの空行も照合する
+    editorFindCallback("^$", CTRL_KEY('r'));
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(2, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(0, E.cy);
+
+    cleanup_editor();
+}
+
+/* Ctrl-Rで正規表現モードに切り替える */
+void test_search_regex() {
+    const char *lines[] = {"foo1 bar22", "x", "baz333", "\tfoo"};
+    setup_editor(lines, 4);
+    char buf[64];
+
+    editorFindCallback("[0-9]+", '+');
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(0, editorFindMatchCount());
+
+    editorFindCallback("[0-9]+", CTRL_KEY('r'));
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(3, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(0, E.cy);
+    TEST_ASSERT_EQ_INT(3, E.cx);
+    editorFindStatus(buf, sizeof(buf));
+    TEST_ASSERT_STR_EQ("1 of 3 (regex)", buf);
+
+    // マッチの長さ分だけハイライトする
+    editorSyntaxEnsure(0, 4);
+    erow *row = editorRowAt(0);
+    const unsigned char *hl = editorFindHighlight(0, row);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[3]);
+    TEST_ASSERT("Space should not be highlighted", hl[4] != HL_MATCH);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[8]);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[9]);
+    row = editorRowAt(2);
+    hl = editorFindHighlight(2, row);
+    TEST_ASSERT("Letters should not be highlighted", hl[2] != HL_MATCH);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[3]);
+    TEST_ASSERT_EQ_INT(HL_MATCH, hl[5]);
+
+    // 正規表現モードではクエリを伸ばしても走査し直す
+    type_query("^ba");
+    TEST_ASSERT_EQ_INT(1, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(2, E.cy);
+    type_query("fo+$");
+    TEST_ASSERT_EQ_INT(1, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(3, E.cy);
+    TEST_ASSERT_EQ_INT(1, E.cx);
+
+    // 不正なパターンはステータスに理由を出す
+    editorFindCallback("ba(", '(');
+    TEST_ASSERT_EQ_INT(0, editorFindMatchCount());
+    editorFindStatus(buf, sizeof(buf));
+    TEST_ASSERT_STR_EQ("regex: missing )", buf);
+
+    // 通常の検索に戻す
+    editorFindCallback("ba(", CTRL_KEY('r'));
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(0, editorFindMatchCount());
+    editorFindCallback("ba", CTRL_KEY('h'));
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(2, editorFindMatchCount());
+
+    cleanup_editor();
+}
+
+/* 正規表現でも未展開のチャンクを走査し、行末の\rは（続いていても全て）行に含めない */
+void test_search_regex_lazy() {
+    const char *path = "test_search_tmp.txt";
+    int nlines = ROW_CHUNK_MAX * 4;
+    FILE *fp = fopen(path, "w");
+    for (int i = 0; i < nlines; i++) {
+        if (i == ROW_CHUNK_MAX * 2 + 3) fputs("\tneedle needle\r\n", fp);
+        else if (i == ROW_CHUNK_MAX * 3 + 1) fputs("needle\r\r\n", fp);
+        else fputs("needle e\r\n", fp);
+    }
+    fclose(fp);
+
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    Config.lazy_load = 1;
+    editorOpen((char *)path);
+
+    editorFindCallback("needle$", CTRL_KEY('r'));
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(2, editorFindMatchCount());
+    TEST_ASSERT_EQ_INT(ROW_CHUNK_MAX * 2 + 3, E.cy);
+    TEST_ASSERT_EQ_INT(8, E.cx);
+    TEST_ASSERT("Chunks before the match should stay lazy",
+                ropePeekPrev(editorRowAt(ROW_CHUNK_MAX * 2)) == NULL);
+
+    // 先頭に固定文字列がないパターンは全行を照合する
+    editorFindCallback("[ ]e$", '$');
+    editorFindWait();
+    TEST_ASSERT_EQ_INT(nlines - 2, editorFindMatchCount());
+
+    cleanup_editor();
+    unlink(path);
+}
+
+int main() {
+    TEST_GROUP("Search");
+
+    RUN_TEST(test_search_incremental_narrowing);
+    RUN_TEST(test_search_next_prev);
+    RUN_TEST(test_search_highlight);
+    RUN_TEST(test_search_status);
+    RUN_TEST(test_search_lazy_chunks);
+    RUN_TEST(test_search_narrow_lazy);
+    RUN_TEST(test_search_cancel);
+    RUN_TEST(test_search_snapshot);
+    RUN_TEST(test_search_regex);
+    RUN_TEST(test_search_regex_lazy);
+
+    TEST_SUMMARY();
+}
@@ -7,6 +7,7 @@
 #include "../src/kiloe.h"
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 /* 外部変数の宣言 */
 extern struct editorConfig E;
@@ -123,18 +124,238 @@ void test_highlight_flags() {
     TEST_ASSERT_EQ_INT(0, HLDB[5].flags);
 }
 
+/* 行ハイライトテスト用のセットアップ */
+static void setup_rows(const char *filename) {
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    E.filename = strdup(filename);
+    editorSelectSyntaxHighlight();
+}
+
+/* 行ハイライトテスト用のクリーンアップ */
+static void cleanup_rows() {
+    editorFreeRows();
+    free(E.filename);
+    E.filename = NULL;
+    E.syntax = NULL;
+}
+
+/* ハイライトは要求された範囲まで遅延して計算される */
+void test_syntax_lazy_ensure() {
+    setup_rows("lazy.c");
+
+    for (int i = 0; i < 10; i++) editorInsertRow(i, "int x;", 6);
+    TEST_ASSERT_EQ_INT(0, E.hl_frontier);
+    TEST_ASSERT("Rows should start unhighlighted", editorRowAt(0)->hl_dirty);
+
+    editorSyntaxEnsure(0, 3);
+    TEST_ASSERT_EQ_INT(3, E.hl_frontier);
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, editorRowAt(2)->hl[0]);
+    TEST_ASSERT("Rows past the range should stay unhighlighted", editorRowAt(3)->hl_dirty);
+
+    // 編集した行から確定範囲が戻る
+    editorRowInsertChar(editorRowAt(1), 0, ' ');
+    TEST_ASSERT_EQ_INT(1, E.hl_frontier);
+
+    cleanup_rows();
+}
+
+/* 複数行コメントの状態が後続行へ伝播する */
+void test_syntax_multiline_propagation() {
+    setup_rows("comment.c");
+
+    editorInsertRow(0, "int a;", 6);
+    editorInsertRow(1, "int b;", 6);
+    editorInsertRow(2, "int c;", 6);
+    editorSyntaxEnsure(0, 3);
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, editorRowAt(2)->hl[0]);
+
+    // 先頭行でコメントを開くと後続行もコメントになる
+    editorRowAppendString(editorRowAt(0), " /*", 3);
+    editorSyntaxEnsure(0, 3);
+    TEST_ASSERT_EQ_INT(HL_MLCOMMENT, editorRowAt(1)->hl[0]);
+    TEST_ASSERT_EQ_INT(HL_MLCOMMENT, editorRowAt(2)->hl[0]);
+
+    // コメントを閉じると元に戻る
+    editorRowAppendString(editorRowAt(1), "*/", 2);
+    editorSyntaxEnsure(0, 3);
+    TEST_ASSERT_EQ_INT(HL_MLCOMMENT, editorRowAt(1)->hl[0]);
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, editorRowAt(2)->hl[0]);
+
+    cleanup_rows();
+}
+
+/* シンタックス切り替えは全行を走査せず無効化だけを行う */
+void test_syntax_switch_is_deferred() {
+    setup_rows("switch.c");
+
+    for (int i = 0; i < 100; i++) editorInsertRow(i, "int x;", 6);
+    editorSyntaxEnsure(0, 100);
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, editorRowAt(50)->hl[0]);
+
+    free(E.filename);
+    E.filename = strdup("switch.md");
+    editorSelectSyntaxHighlight();
+    TEST_ASSERT_EQ_INT(0, E.hl_frontier);
+    // 再計算前は古いハイライトが残っている
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, editorRowAt(50)->hl[0]);
+
+    editorSyntaxEnsure(50, 51);
+    TEST_ASSERT_EQ_INT(HL_NORMAL, editorRowAt(50)->hl[0]);
+
+    cleanup_rows();
+}
+
+/* 未展開チャンクをまたぐ複数行コメントは展開せずに状態だけを走査する */
+void test_syntax_lazy_chunks() {
+    const char *path = "test_syntax_tmp.c";
+    int nlines = ROW_CHUNK_MAX * 4;
+    FILE *fp = fopen(path, "w");
+    for (int i = 0; i < nlines; i++) {
+        if (i == 5) fputs("/* open\n", fp);
+        else if (i == ROW_CHUNK_MAX * 2 + 5) fputs("close */ int y;\n", fp);
+        else fputs("int x;\n", fp);
+    }
+    fclose(fp);
+
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    Config.lazy_load = 1;
+    editorOpen((char *)path);
+    TEST_ASSERT_EQ_INT(nlines, E.numrows);
+
+    // 3つ目のチャンクだけを表示
+    int first = ROW_CHUNK_MAX * 2;
+    editorSyntaxEnsure(first, first + 10);
+    TEST_ASSERT_EQ_INT(HL_MLCOMMENT, editorRowAt(first)->hl[0]);
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, editorRowAt(first + 5)->hl[9]);
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, editorRowAt(first + 6)->hl[0]);
+    TEST_ASSERT("Chunks before the viewport should stay lazy",
+                ropePeekPrev(editorRowAt(first)) == NULL);
+
+    cleanup_rows();
+    unlink(path);
+}
+
+/* 表示範囲より前の行は状態だけを計算して未計算のまま残す */
+void test_syntax_offscreen_state_only() {
+    setup_rows("offscreen.c");
+
+    int n = 1000;
+    for (int i = 0; i < n; i++) editorInsertRow(i, "int x;", 6);
+    editorSyntaxEnsure(0, n);
+
+    // 先頭でコメントを開き、末尾だけを表示
+    editorRowAppendString(editorRowAt(0), " /*", 3);
+    editorSyntaxEnsure(n - 10, n);
+
+    TEST_ASSERT_EQ_INT(HL_MLCOMMENT, editorRowAt(n - 1)->hl[0]);
+    TEST_ASSERT_EQ_INT(HL_ROW_STALE, editorRowAt(500)->hl_dirty);
+    TEST_ASSERT_EQ_INT(1, editorRowAt(500)->hl_open_comment);
+    // ハイライト配列は表示されるまで古いまま
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, editorRowAt(500)->hl[0]);
+
+    editorSyntaxEnsure(500, 501);
+    TEST_ASSERT_EQ_INT(HL_MLCOMMENT, editorRowAt(500)->hl[0]);
+    TEST_ASSERT_EQ_INT(HL_ROW_CLEAN, editorRowAt(500)->hl_dirty);
+
+    cleanup_rows();
+}
+
+/* 状態が変わらない編集は後続行に伝播しない */
+void test_syntax_propagation_stops() {
+    setup_rows("stops.c");
+
+    int n = 1000;
+    for (int i = 0; i < n; i++) editorInsertRow(i, "int x;", 6);
+    editorSyntaxEnsure(0, n);
+
+    editorRowAppendString(editorRowAt(0), " y", 2);
+    editorSyntaxEnsure(n - 10, n);
+
+    TEST_ASSERT_EQ_INT(n, E.hl_frontier);
+    TEST_ASSERT_EQ_INT(HL_ROW_CLEAN, editorRowAt(1)->hl_dirty);
+    TEST_ASSERT_EQ_INT(HL_ROW_CLEAN, editorRowAt(500)->hl_dirty);
+
+    cleanup_rows();
+}
+
+/* 長い伝播も再帰せずに処理できる */
+void test_syntax_long_propagation() {
+    setup_rows("long.c");
+
+    int n = 200000;
+    for (int i = 0; i < n; i++) editorInsertRow(i, "x", 1);
+    editorSyntaxEnsure(0, 10);
+
+    editorRowAppendString(editorRowAt(0), "/*", 2);
+    editorSyntaxEnsure(n - 1, n);
+    TEST_ASSERT_EQ_INT(HL_MLCOMMENT, editorRowAt(n - 1)->hl[0]);
+
+    editorRowDelChar(editorRowAt(0), 2);
+    editorSyntaxEnsure(n - 1, n);
+    TEST_ASSERT_EQ_INT(HL_NORMAL, editorRowAt(n - 1)->hl[0]);
+
+    cleanup_rows();
+}
+
+/* キーワード照合：単語全体が一致した場合だけキーワードになる */
+void test_syntax_keyword_matcher() {
+    setup_rows("kw.c");
+
+    const char *text = "if (x) return intx int;";
+    editorInsertRow(0, (char *)text, strlen(text));
+    editorSyntaxEnsure(0, 1);
+    erow *row = editorRowAt(0);
+
+    TEST_ASSERT_EQ_INT(HL_KEYWORD1, row->hl[0]);       // if
+    TEST_ASSERT_EQ_INT(HL_KEYWORD1, row->hl[1]);
+    TEST_ASSERT_EQ_INT(HL_NORMAL, row->hl[2]);
+    TEST_ASSERT_EQ_INT(HL_KEYWORD1, row->hl[7]);       // return
+    TEST_ASSERT_EQ_INT(HL_KEYWORD1, row->hl[12]);
+    TEST_ASSERT_EQ_INT(HL_NORMAL, row->hl[14]);        // intx
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, row->hl[19]);      // int
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, row->hl[21]);
+    TEST_ASSERT_EQ_INT(HL_NORMAL, row->hl[22]);
+
+    // シンタックスを切り替えるとキーワード表も切り替わる
+    free(E.filename);
+    E.filename = strdup("kw.py");
+    editorSelectSyntaxHighlight();
+    editorSyntaxEnsure(0, 1);
+    TEST_ASSERT_EQ_INT(HL_KEYWORD1, row->hl[0]);       // if
+    TEST_ASSERT_EQ_INT(HL_KEYWORD1, row->hl[7]);       // return
+    TEST_ASSERT_EQ_INT(HL_KEYWORD2, row->hl[19]);      // int
+
+    free(E.filename);
+    E.filename = strdup("kw.rb");
+    editorSelectSyntaxHighlight();
+    editorSyntaxEnsure(0, 1);
+    TEST_ASSERT_EQ_INT(HL_NORMAL, row->hl[19]);        // Rubyではintはキーワードでない
+
+    cleanup_rows();
+}
+
 int main() {
     TEST_GROUP("Syntax Highlighting");
     
     // E構造体の初期化
     memset(&E, 0, sizeof(E));
     E.numrows = 0;
-    E.row = NULL;
+    E.rowroot = NULL;
     
     RUN_TEST(test_getHLDBEntries);
     RUN_TEST(test_file_extension_matching);
     RUN_TEST(test_comment_settings);
     RUN_TEST(test_highlight_flags);
+    RUN_TEST(test_syntax_lazy_ensure);
+    RUN_TEST(test_syntax_multiline_propagation);
+    RUN_TEST(test_syntax_switch_is_deferred);
+    RUN_TEST(test_syntax_lazy_chunks);
+    RUN_TEST(test_syntax_offscreen_state_only);
+    RUN_TEST(test_syntax_propagation_stops);
+    RUN_TEST(test_syntax_long_propagation);
+    RUN_TEST(test_syntax_keyword_matcher);
     
     TEST_SUMMARY();
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+/**
+ * test_terminal.c - キー入力関数のテスト
+ */
+
+#define _GNU_SOURCE
+#include "minunit.h"
+#include "../src/kiloe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 標準入力をパイプに差し替えて入力を用意する */
+static void feed_input(const char *s, int len) {
+    int fds[2];
+    if (pipe(fds) == -1) return;
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+    write(fds[1], s, len);
+    close(fds[1]);
+}
+
+/* まとめて届いたキーを順に変換する */
+void test_read_key_batch() {
+    const char *in = "a\x1b[A\x1b[3~\x1b[Fb";
+    feed_input(in, strlen(in));
+
+    TEST_ASSERT_EQ_INT('a', editorReadKey());
+    TEST_ASSERT("Keys should be pending", editorKeysPending());
+    TEST_ASSERT_EQ_INT(ARROW_UP, editorReadKey());
+    TEST_ASSERT_EQ_INT(DELETE, editorReadKey());
+    TEST_ASSERT_EQ_INT(END, editorReadKey());
+    TEST_ASSERT_EQ_INT('b', editorReadKey());
+    TEST_ASSERT("No keys should be pending", !editorKeysPending());
+}
+
+/* 入力末尾のESCは単独のESCとして扱う */
+void test_read_key_lone_escape() {
+    feed_input("x\x1b", 2);
+
+    TEST_ASSERT_EQ_INT('x', editorReadKey());
+    TEST_ASSERT_EQ_INT(ESC, editorReadKey());
+    TEST_ASSERT("No keys should be pending", !editorKeysPending());
+}
+
+/* バッファより大きな入力も順序を保って読み込む */
+void test_read_key_large_paste() {
+    int len = 20000;
+    char *in = malloc(len);
+    for (int i = 0; i < len; i++) in[i] = 'a' + i % 26;
+    feed_input(in, len);
+
+    int ok = 1;
+    int count = 0;
+    while (editorKeysPending()) {
+        if (editorReadKey() != in[count]) ok = 0;
+        count++;
+    }
+    TEST_ASSERT_EQ_INT(len, count);
+    TEST_ASSERT("Keys should keep their order", ok);
+    free(in);
+}
+
+/* 貼り付けの内容を終了シーケンスまでまとめて読み取る */
+void test_read_paste() {
+    const char *in = "\x1b[200~a\x1b[Bb\rc\x1b[201~x";
+    feed_input(in, strlen(in));
+
+    TEST_ASSERT_EQ_INT(PASTE_START, editorReadKey());
+    int len;
+    char *text = editorReadPaste(&len);
+    TEST_ASSERT_EQ_INT(7, len);
+    TEST_ASSERT("Paste should keep escapes and newlines", memcmp(text, "a\x1b[Bb\rc", 7) == 0);
+    free(text);
+    TEST_ASSERT_EQ_INT('x', editorReadKey());
+}
+
+/* 入力待ちは別スレッドからの起床通知でWAKEUPを返す */
+void test_read_key_wakeup() {
+    int fds[2];
+    if (pipe(fds) == -1) return;
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+
+    TEST_ASSERT_EQ_INT(0, editorWakeupInit());
+    editorWakeup();
+    editorWakeup();
+    TEST_ASSERT_EQ_INT(WAKEUP, editorReadKey());
+
+    // 溜まった通知はまとめて捨てられ、キー入力が優先される
+    write(fds[1], "a", 1);
+    editorWakeup();
+    TEST_ASSERT_EQ_INT('a', editorReadKey());
+    TEST_ASSERT_EQ_INT(WAKEUP, editorReadKey());
+    close(fds[1]);
+}
+
+int main() {
+    TEST_GROUP("Terminal Input");
+
+    RUN_TEST(test_read_key_batch);
+    RUN_TEST(test_read_key_lone_escape);
+    RUN_TEST(test_read_key_large_paste);
+    RUN_TEST(test_read_paste);
+    RUN_TEST(test_read_key_wakeup);
+
+    TEST_SUMMARY();
+}
@@ -0,0 +1,278 @@
+/**
+ * test_undo.c - 元に戻す・やり直し機能のテスト
+ */
+
+#define _GNU_SOURCE
+#include "minunit.h"
+#include "../src/kiloe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* 外部変数 */
+extern struct editorConfig E;
+extern struct editorSettings Config;
+
+/* テスト用のセットアップ */
+static void setup_editor(const char **lines, int n) {
+    memset(&E, 0, sizeof(E));
+    initDefaultConfig();
+    editorUndoReset();
+    for (int i = 0; i < n; i++) editorInsertRow(i, (char *)lines[i], strlen(lines[i]));
+    editorUndoReset();
+    E.dirty = 0;
+}
+
+/* テスト用のクリーンアップ */
+static void cleanup_editor() {
+    editorFreeRows();
+}
+
+/* 全行を保存と同じ経路で書き出し、改行区切りの文字列として読み戻す（呼び出し側で解放） */
+static char *buffer_text() {
+    const char *path = "test_undo_text_tmp.txt";
+    size_t len = 0;
+    editorWriteFile(path, &len);
+    char *buf = malloc(len + 1);
+    FILE *fp = fopen(path, "r");
+    size_t n = fp ? fread(buf, 1, len, fp) : 0;
+    if (fp) fclose(fp);
+    buf[n] = '\0';
+    unlink(path);
+    return buf;
+}
+
+/* 文字列を1文字ずつ入力する */
+static void type(const char *s) {
+    for (; *s; s++) {
+        if (*s == '\n') editorInsertNewLine();
+        else editorInsertChar(*s);
+    }
+}
+
+/* 連続した文字の入力は1回で取り消せる */
+void test_undo_typing() {
+    const char *lines[] = {"abc", "def"};
+    setup_editor(lines, 2);
+
+    E.cy = 0;
+    E.cx = 3;
+    type("xyz");
+    TEST_ASSERT_STR_EQ("abcxyz", editorRowText(editorRowAt(0)));
+
+    TEST_ASSERT_EQ_INT(1, editorUndo());
+    TEST_ASSERT_STR_EQ("abc", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_EQ_INT(0, E.cy);
+    TEST_ASSERT_EQ_INT(3, E.cx);
+    TEST_ASSERT_EQ_INT(0, editorUndo());
+
+    TEST_ASSERT_EQ_INT(1, editorRedo());
+    TEST_ASSERT_STR_EQ("abcxyz", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_EQ_INT(6, E.cx);
+    TEST_ASSERT_EQ_INT(0, editorRedo());
+
+    cleanup_editor();
+}
+
+/* バックスペースとDeleteの連続もそれぞれ1回で取り消せる */
+void test_undo_delete_runs() {
+    const char *lines[] = {"あいう", "def"};
+    setup_editor(lines, 2);
+
+    E.cy = 0;
+    E.cx = 9;
+    editorDelChar();
+    editorDelChar();
+    TEST_ASSERT_STR_EQ("あ", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_EQ_INT(1, editorUndo());
+    TEST_ASSERT_STR_EQ("あいう", editorRowText(editorRowAt(0)));
+    TEST_ASSERT_EQ_INT(9, E.cx);
+
+    // Delete（右に移動してから削除）の連続
+    E.cy = 1;
+    E.cx = 0;
+    for (int i = 0; i < 2; i++) {
+        editorMoveCursor(ARROW_RIGHT);
+        editorDelChar();
+    }
+    TEST_ASSERT_STR_EQ("f", editorRowText(editorRowAt(1)));
+    TEST_ASSERT_EQ_INT(1, editorUndo());
+    TEST_ASSERT_STR_EQ("def", editorRowText(editorRowAt(1)));
+    // バックスペースの記録は取り消し済みなので残っていない
+    TEST_ASSERT_EQ_INT(0, editorUndo());
+    TEST_ASSERT_STR_EQ("あいう", editorRowText(editorRowAt(0)));
+
+    cleanup_editor();
+}
+
+/* 行の分割・結合を取り消す */
+void test_undo_lines() {
+    const char *lines[] = {"hello world", "end"};
+    setup_editor(lines, 2);
+
+    E.cy = 0;
+    E.cx = 5;
+    editorInsertNewLine();
+    TEST_ASSERT_EQ_INT(3, E.numrows);
+    // 行頭でのバックスペースで前の行と結合
+    E.cy = 2;
+    E.cx = 0;
+    editorDelChar();
+    TEST_ASSERT_EQ_INT(2, E.numrows);
+    TEST_ASSERT_STR_EQ(" worldend", editorRowText(editorRowAt(1)));
+
+    editorUndo();
+    TEST_ASSERT_EQ_INT(3, E.numrows);
+    TEST_ASSERT_STR_EQ(" world", editorRowText(editorRowAt(1)));
+    TEST_ASSERT_STR_EQ("end", editorRowText(editorRowAt(2)));
+    editorUndo();
+    TEST_ASSERT_EQ_INT(2, E.numrows);
+    TEST_ASSERT_STR_EQ("hello world", editorRowText(editorRowAt(0)));
+
+    // 取り消した後に編集するとやり直しは捨てられる
+    E.cy = 1;
+    E.cx = 3;
+    editorInsertChar('!');
+    TEST_ASSERT_EQ_INT(0, editorRedo());
+    TEST_ASSERT_STR_EQ("end!", editorRowText(editorRowAt(1)));
+
+    cleanup_editor();
+}
+
+/* 貼り付けは改行の種類によらず1回で取り消せ、末尾への追加も元の行数に戻る */
+void test_undo_paste() {
+    const char *lines[] = {"head", "tail"};
+    setup_editor(lines, 2);
+
+    E.cy = 0;
+    E.cx = 2;
+    const char *paste = "one\r\ntwo\rthree\n";
+    editorInsertText(paste, strlen(paste));
+    char *text = buffer_text();
+    TEST_ASSERT_STR_EQ("heone\ntwo\nthree\nad\ntail\n", text);
+    free(text);
+
+    editorUndo();
+    text = buffer_text();
+    TEST_ASSERT_STR_EQ("head\ntail\n", text);
+    free(text);
+    editorRedo();
+    text = buffer_text();
+    TEST_ASSERT_STR_EQ("heone\ntwo\nthree\nad\ntail\n", text);
+    free(text);
+    editorUndo();
+
+    // ファイル末尾（最終行の次）への入力と貼り付け
+    E.cy = E.numrows;
+    E.cx = 0;
+    editorInsertChar('x');
+    E.cy = E.numrows;
+    E.cx = 0;
+    editorInsertText("p\nq", 3);
+    TEST_ASSERT_EQ_INT(5, E.numrows);
+    editorUndo();
+    TEST_ASSERT_EQ_INT(3, E.numrows);
+    editorUndo();
+    TEST_ASSERT_EQ_INT(2, E.numrows);
+    text = buffer_text();
+    TEST_ASSERT_STR_EQ("head\ntail\n", text);
+    free(text);
+    editorRedo();
+    editorRedo();
+    text = buffer_text();
+    TEST_ASSERT_STR_EQ("head\ntail\nx\np\nq\n", text);
+    free(text);
+
+    cleanup_editor();
+}
+
+/* 上限を超えたら古い記録から捨て、残った分は正しく取り消せる */
+void test_undo_limit() {
+    const char *lines[] = {""};
+    setup_editor(lines, 1);
+    Config.undo_limit = 1;
+
+    char chunk[101];
+    memset(chunk, 'a', 100);
+    chunk[100] = '\0';
+    // 行頭に挿入して直前のレコードにまとめられないようにする
+    for (int i = 0; i < 40; i++) {
+        E.cy = 0;
+        E.cx = 0;
+        chunk[0] = '0' + i % 10;
+        editorInsertText(chunk, 100);
+        TEST_ASSERT("Usage should stay under the limit", editorUndoUsage() <= 1024);
+    }
+
+    int undone = 0;
+    while (editorUndo()) undone++;
+    TEST_ASSERT("Oldest history should be dropped", undone > 0 && undone < 40);
+    TEST_ASSERT_EQ_INT(100 * (40 - undone), editorRowAt(0)->size);
+
+    // 上限0で記録しない
+    Config.undo_limit = 0;
+    editorInsertChar('z');
+    TEST_ASSERT_EQ_INT(0, (int)editorUndoUsage());
+    TEST_ASSERT_EQ_INT(0, editorUndo());
+
+    cleanup_editor();
+}
+
+/* ランダムな編集を全て取り消すと元に戻り、全てやり直すと編集後に戻る */
+void test_undo_random() {
+    const char *lines[] = {"alpha", "beta", "", "gamma delta"};
+    setup_editor(lines, 4);
+
+    char *initial = buffer_text();
+    unsigned int seed = 7;
+    for (int i = 0; i < 2000; i++) {
+        seed = seed * 1103515245 + 12345;
+        int op = (seed >> 16) % 10;
+        if ((seed >> 8) % 8 == 0 || E.cy > E.numrows) {
+            E.cy = (seed >> 4) % (E.numrows + 1);
+            E.cx = 0;
+        }
+        if (E.cy < E.numrows && E.cx > editorRowAt(E.cy)->size) E.cx = editorRowAt(E.cy)->size;
+        if (op < 4) {
+            editorInsertChar('a' + (seed >> 20) % 26);
+        } else if (op < 5) {
+            editorInsertNewLine();
+        } else if (op < 8) {
+            editorDelChar();
+        } else if (op < 9) {
+            editorInsertText("x\r\ny\nz", 6);
+        } else {
+            editorMoveCursor(ARROW_RIGHT);
+            editorDelChar();
+        }
+    }
+    char *final = buffer_text();
+
+    while (editorUndo());
+    char *text = buffer_text();
+    TEST_ASSERT_STR_EQ(initial, text);
+    free(text);
+
+    while (editorRedo());
+    text = buffer_text();
+    TEST_ASSERT_STR_EQ(final, text);
+    free(text);
+
+    free(initial);
+    free(final);
+    cleanup_editor();
+}
+
+int main() {
+    TEST_GROUP("Undo");
+
+    RUN_TEST(test_undo_typing);
+    RUN_TEST(test_undo_delete_runs);
+    RUN_TEST(test_undo_lines);
+    RUN_TEST(test_undo_paste);
+    RUN_TEST(test_undo_limit);
+    RUN_TEST(test_undo_random);
+
+    TEST_SUMMARY();
+}